@@ -0,0 +1,423 @@
+// Copyright (c) 2024 Lily Lyons
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+//! Replays captured Studio sessions (`.cmdlog` files, see [`fmod::studio::System::start_command_capture`]) as fast as possible
+//! against the no sound (non realtime) output, and reports how expensive every frame was to mix.
+//!
+//! ```sh
+//! FMOD_REPLAY_DIR=captures/ FMOD_REPLAY_BANKS=build/Desktop cargo bench -p fmod-oxide --bench command_replay [filter]
+//! ```
+//!
+//! On every replayed frame the frame callback samples Studio and core CPU usage and [`fmod::memory::memory_get_stats`],
+//! and times the frame. Commands are replayed a frame at a time, so each command of a frame is attributed an equal share of its time.
+//!
+//! Every replay writes `<name>.frames.csv` and `<name>.commands.csv` to `target/replay-bench/<version>/`, and one row of `latest.csv`.
+//! The summary is compared against `FMOD_REPLAY_BASELINE` (a `summary.csv`) if it is set, or otherwise against the last saved `summary.csv`,
+//! and the run fails if any replay is more than 10% worse. This makes it usable as a gate for bank and engine upgrades.
+//! `latest.csv` only replaces `summary.csv` when nothing regressed, so rerunning a regressed build keeps failing.
+
+use fmod::Utf8CString;
+use std::{
+    collections::HashMap,
+    ffi::{c_float, c_int},
+    fmt::Write as _,
+    path::{Path, PathBuf},
+    sync::Mutex,
+    time::Instant,
+};
+
+const REGRESSION_THRESHOLD: f64 = 1.10;
+// the metrics a replay is gated on, and higher is worse for all of them
+const GATED: &[&str] = &[
+    "frame_mean_us",
+    "frame_p95_us",
+    "dsp_cpu_mean",
+    "memory_peak",
+];
+
+#[derive(Clone, Copy)]
+struct Frame {
+    command: c_int,
+    time: c_float,
+    ns: u64,
+    studio_cpu: c_float,
+    dsp_cpu: c_float,
+    memory: c_int,
+}
+
+struct Recorder {
+    frames: Vec<Frame>,
+    last: Option<Instant>,
+}
+
+// the frame callback can't borrow anything, and replays run one at a time
+static RECORDER: Mutex<Recorder> = Mutex::new(Recorder {
+    frames: Vec::new(),
+    last: None,
+});
+
+#[cfg(feature = "userdata-abstraction")]
+type CallbackUserdata = Option<fmod::Userdata>;
+#[cfg(not(feature = "userdata-abstraction"))]
+type CallbackUserdata = *mut std::ffi::c_void;
+
+struct FrameSampler;
+
+impl fmod::studio::FrameCallback for FrameSampler {
+    fn frame_callback(
+        replay: fmod::studio::CommandReplay,
+        command_index: c_int,
+        current_time: c_float,
+        _: CallbackUserdata,
+    ) -> fmod::Result<()> {
+        let now = Instant::now();
+        let (studio_cpu, core_cpu) = replay.get_system()?.get_cpu_usage()?;
+        let (memory, _) = fmod::memory::memory_get_stats(false)?;
+
+        let mut recorder = RECORDER.lock().unwrap();
+        let ns = recorder
+            .last
+            .map_or(0, |last| now.duration_since(last).as_nanos() as u64);
+        recorder.frames.push(Frame {
+            command: command_index,
+            time: current_time,
+            ns,
+            studio_cpu: studio_cpu.update,
+            dsp_cpu: core_cpu.dsp,
+            memory,
+        });
+        // sampling isn't part of the next frame
+        recorder.last = Some(Instant::now());
+        Ok(())
+    }
+}
+
+struct Summary {
+    name: String,
+    values: Vec<(&'static str, f64)>,
+}
+
+fn mean(values: impl ExactSizeIterator<Item = f64>) -> f64 {
+    let count = values.len().max(1) as f64;
+    values.sum::<f64>() / count
+}
+
+fn replay_file(
+    studio: fmod::studio::System,
+    path: &Path,
+    name: &str,
+    bank_path: Option<&Utf8CString>,
+    dir: &Path,
+) -> Result<Summary, Box<dyn std::error::Error>> {
+    let filename = Utf8CString::new(path.to_string_lossy().into_owned())?;
+    let replay =
+        studio.load_command_replay(&filename, fmod::studio::CommandReplayFlags::FAST_FORWARD)?;
+    if let Some(bank_path) = bank_path {
+        replay.set_bank_path(bank_path)?;
+    }
+    replay.set_frame_callback::<FrameSampler>()?;
+    let command_count = replay.get_command_count()?;
+
+    {
+        let mut recorder = RECORDER.lock().unwrap();
+        recorder.frames.clear();
+        recorder.last = Some(Instant::now());
+    }
+    let start = Instant::now();
+    replay.start()?;
+    while replay.get_playback_state()? != fmod::studio::PlaybackState::Stopped {
+        studio.update()?;
+    }
+    let wall = start.elapsed();
+    let frames = std::mem::take(&mut RECORDER.lock().unwrap().frames);
+
+    // command names are looked up after the replay, so the lookups aren't timed
+    let mut commands: HashMap<String, (u64, f64)> = HashMap::new();
+    let mut first = 0;
+    for frame in &frames {
+        let last = frame.command.min(command_count - 1);
+        let share = frame.ns as f64 / f64::from((last - first + 1).max(1));
+        for index in first..=last {
+            let info = replay.get_command_info(index)?;
+            let entry = commands
+                .entry(info.command_name.as_str().to_string())
+                .or_default();
+            entry.0 += 1;
+            entry.1 += share;
+        }
+        first = last + 1;
+    }
+    replay.release()?;
+
+    let mut csv = String::from("command,time,frame_us,studio_cpu,dsp_cpu,memory\n");
+    for frame in &frames {
+        let _ = writeln!(
+            csv,
+            "{},{:.4},{:.3},{:.3},{:.3},{}",
+            frame.command,
+            frame.time,
+            frame.ns as f64 / 1e3,
+            frame.studio_cpu,
+            frame.dsp_cpu,
+            frame.memory
+        );
+    }
+    std::fs::write(dir.join(format!("{name}.frames.csv")), csv)?;
+
+    let mut commands: Vec<_> = commands.into_iter().collect();
+    commands.sort_by(|a, b| b.1 .1.total_cmp(&a.1 .1));
+    let mut csv = String::from("command,count,total_us,mean_ns\n");
+    for (command, (count, ns)) in &commands {
+        let _ = writeln!(
+            csv,
+            "{command},{count},{:.3},{:.1}",
+            ns / 1e3,
+            ns / *count as f64
+        );
+    }
+    std::fs::write(dir.join(format!("{name}.commands.csv")), csv)?;
+
+    let mut frame_us: Vec<f64> = frames.iter().map(|f| f.ns as f64 / 1e3).collect();
+    frame_us.sort_by(f64::total_cmp);
+    let percentile = |p: f64| {
+        frame_us
+            .get(((frame_us.len() as f64 * p) as usize).min(frame_us.len().saturating_sub(1)))
+            .copied()
+            .unwrap_or(0.0)
+    };
+    // the high water mark of memory_get_stats covers every earlier replay too, so the peak is taken from the frames
+    let memory_peak = frames.iter().map(|f| f.memory).max().unwrap_or(0);
+    Ok(Summary {
+        name: name.to_string(),
+        values: vec![
+            ("frames", frames.len() as f64),
+            ("commands", f64::from(command_count)),
+            ("wall_ms", wall.as_secs_f64() * 1e3),
+            ("frame_mean_us", mean(frame_us.iter().copied())),
+            ("frame_p95_us", percentile(0.95)),
+            ("frame_max_us", frame_us.last().copied().unwrap_or(0.0)),
+            (
+                "studio_cpu_mean",
+                mean(frames.iter().map(|f| f64::from(f.studio_cpu))),
+            ),
+            (
+                "dsp_cpu_mean",
+                mean(frames.iter().map(|f| f64::from(f.dsp_cpu))),
+            ),
+            (
+                "dsp_cpu_max",
+                frames
+                    .iter()
+                    .map(|f| f64::from(f.dsp_cpu))
+                    .fold(0.0, f64::max),
+            ),
+            ("memory_peak", f64::from(memory_peak)),
+        ],
+    })
+}
+
+fn results_dir() -> PathBuf {
+    std::env::var_os("CARGO_TARGET_DIR")
+        .map_or_else(
+            || PathBuf::from(env!("CARGO_MANIFEST_DIR")).join("../target"),
+            PathBuf::from,
+        )
+        .join("replay-bench")
+        .join(env!("CARGO_PKG_VERSION"))
+}
+
+fn read_summary(path: &Path) -> HashMap<String, HashMap<String, f64>> {
+    let Ok(contents) = std::fs::read_to_string(path) else {
+        return HashMap::new();
+    };
+    let mut lines = contents.lines();
+    let Some(header) = lines.next() else {
+        return HashMap::new();
+    };
+    let columns: Vec<_> = header.split(',').skip(1).collect();
+    lines
+        .filter_map(|line| {
+            let mut fields = line.split(',');
+            let name = fields.next()?.to_string();
+            let values = columns
+                .iter()
+                .zip(fields)
+                .filter_map(|(column, value)| Some((column.to_string(), value.parse().ok()?)))
+                .collect();
+            Some((name, values))
+        })
+        .collect()
+}
+
+// returns how many metrics regressed
+fn save_and_compare(dir: &Path, summaries: &[Summary]) -> std::io::Result<usize> {
+    let path = dir.join("summary.csv");
+    let previous = read_summary(&path);
+    let (baseline_path, baseline) = match std::env::var_os("FMOD_REPLAY_BASELINE") {
+        Some(baseline_path) => {
+            let baseline_path = PathBuf::from(baseline_path);
+            let baseline = read_summary(&baseline_path);
+            (baseline_path, baseline)
+        }
+        None => (path.clone(), previous.clone()),
+    };
+
+    let mut regressions = 0;
+    if !baseline.is_empty() {
+        println!("\ncompared to {}:", baseline_path.display());
+        for summary in summaries {
+            let Some(old) = baseline.get(&summary.name) else {
+                continue;
+            };
+            for (metric, value) in &summary.values {
+                let Some(&old) = old.get(*metric).filter(|old| **old > 0.0) else {
+                    continue;
+                };
+                if !GATED.contains(metric) {
+                    continue;
+                }
+                let ratio = value / old;
+                let flag = if ratio > REGRESSION_THRESHOLD {
+                    regressions += 1;
+                    "  REGRESSED"
+                } else {
+                    ""
+                };
+                println!(
+                    "{:<24} {metric:<16} {:>+9.1}%{flag}",
+                    summary.name,
+                    (ratio - 1.0) * 100.0
+                );
+            }
+        }
+    }
+
+    // filtered runs only replace the replays they ran
+    let Some(columns) = summaries.first().map(|summary| &summary.values) else {
+        return Ok(regressions);
+    };
+    // a regressed run is kept apart, so it doesn't become the baseline of the next run
+    let latest = dir.join("latest.csv");
+    let mut rows: Vec<(String, Vec<f64>)> = previous
+        .into_iter()
+        .filter(|(name, _)| !summaries.iter().any(|s| s.name == *name))
+        .map(|(name, values)| {
+            let values = columns
+                .iter()
+                .map(|(metric, _)| values.get(*metric).copied().unwrap_or(0.0))
+                .collect();
+            (name, values)
+        })
+        .collect();
+    rows.extend(
+        summaries
+            .iter()
+            .map(|s| (s.name.clone(), s.values.iter().map(|(_, v)| *v).collect())),
+    );
+    rows.sort_by(|a, b| a.0.cmp(&b.0));
+
+    let mut csv = String::from("name");
+    for (metric, _) in columns {
+        let _ = write!(csv, ",{metric}");
+    }
+    csv.push('\n');
+    for (name, values) in rows {
+        csv.push_str(&name);
+        for value in values {
+            let _ = write!(csv, ",{value:.3}");
+        }
+        csv.push('\n');
+    }
+    std::fs::write(&latest, &csv)?;
+    if regressions == 0 {
+        std::fs::write(&path, csv)?;
+        println!("\nsaved to {}", dir.display());
+    } else {
+        println!(
+            "\nsaved to {}, {} was kept as the baseline",
+            latest.display(),
+            path.display()
+        );
+    }
+    Ok(regressions)
+}
+
+fn main() -> Result<(), Box<dyn std::error::Error>> {
+    // cargo passes --bench to harness = false targets
+    let filter = std::env::args().skip(1).find(|arg| !arg.starts_with('-'));
+    let Some(replays) = std::env::var_os("FMOD_REPLAY_DIR").map(PathBuf::from) else {
+        println!("no captures to replay, set FMOD_REPLAY_DIR to a directory of .cmdlog files");
+        return Ok(());
+    };
+    let bank_path = std::env::var("FMOD_REPLAY_BANKS")
+        .ok()
+        .map(Utf8CString::new)
+        .transpose()?;
+
+    let mut paths: Vec<_> = std::fs::read_dir(&replays)?
+        .filter_map(|entry| Some(entry.ok()?.path()))
+        .filter(|path| path.extension().is_some_and(|e| e == "cmdlog"))
+        .collect();
+    paths.sort();
+
+    let mut builder = unsafe {
+        // Safety: we call this before calling any other functions and only in main, so this is safe
+        fmod::studio::SystemBuilder::new()?
+    };
+    builder
+        .core_builder()
+        .output(fmod::OutputType::NoSoundNRT)?;
+    // every update mixes on this thread, so the replay runs as fast as the cpu allows
+    let studio = builder.build(
+        1024,
+        fmod::studio::InitFlags::SYNCHRONOUS_UPDATE,
+        fmod::InitFlags::NORMAL,
+    )?;
+
+    let dir = results_dir();
+    std::fs::create_dir_all(&dir)?;
+    let mut summaries = Vec::new();
+    for path in paths {
+        // the name is the first column of the summary
+        let name = path
+            .file_stem()
+            .map_or_else(String::new, |stem| stem.to_string_lossy().replace(',', "_"));
+        if filter
+            .as_ref()
+            .is_some_and(|filter| !name.contains(filter.as_str()))
+        {
+            continue;
+        }
+        let summary = replay_file(studio, &path, &name, bank_path.as_ref(), &dir)?;
+        let value = |metric| {
+            summary
+                .values
+                .iter()
+                .find(|(m, _)| *m == metric)
+                .map_or(0.0, |(_, v)| *v)
+        };
+        println!(
+            "{name:<24} {:>8} frames {:>10.1} ms {:>9.1} us/frame (p95 {:>9.1}) {:>6.2}% dsp",
+            value("frames"),
+            value("wall_ms"),
+            value("frame_mean_us"),
+            value("frame_p95_us"),
+            value("dsp_cpu_mean"),
+        );
+        summaries.push(summary);
+    }
+
+    unsafe {
+        // Safety: nothing uses the system after this
+        studio.release()?;
+    }
+
+    let regressions = save_and_compare(&dir, &summaries)?;
+    if regressions > 0 {
+        return Err(format!("{regressions} metrics regressed by more than 10%").into());
+    }
+    Ok(())
+}
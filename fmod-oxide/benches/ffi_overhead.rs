@@ -0,0 +1,398 @@
+// Copyright (c) 2024 Lily Lyons
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+//! Measures what the layers between gameplay code and FMOD cost per call:
+//! the native `FMOD_Channel_*` C API, the `FMOD_ChannelControl_*` C++ shim in fmod-sys, and the safe wrappers on top of them.
+//! `wrapper` calls go through [`fmod::ControlKind`] straight to the native API, `dynamic` calls go through a `ChannelControl` and the shim.
+//!
+//! Runs against the no sound (non realtime) output, so no audio device is needed.
+//! Studio lookups are measured when the example banks are found, see `FMOD_BENCH_MEDIA`.
+//!
+//! ```sh
+//! cargo bench -p fmod-oxide --bench ffi_overhead [filter]
+//! ```
+//!
+//! Results are written to `target/ffi-bench/<version>.latest.csv`.
+//! They are compared against `FMOD_BENCH_BASELINE` if it is set, or otherwise against `target/ffi-bench/<version>.csv`,
+//! and anything more than 10% slower is flagged. The results only replace `<version>.csv` when nothing was flagged.
+
+use fmod::ffi::*;
+use fmod::Utf8CString;
+use std::{
+    ffi::{c_char, c_float, c_int, c_void},
+    fmt::Write as _,
+    hint::black_box,
+    path::PathBuf,
+    time::{Duration, Instant},
+};
+
+// how long a sample should run for, so timer resolution doesn't matter
+const SAMPLE_TIME: Duration = Duration::from_millis(10);
+const SAMPLES: usize = 15;
+const REGRESSION_THRESHOLD: f64 = 1.10;
+
+struct Measurement {
+    name: String,
+    ns_per_call: f64,
+}
+
+struct Harness {
+    filter: Option<String>,
+    results: Vec<Measurement>,
+}
+
+impl Harness {
+    fn bench(&mut self, name: &str, mut f: impl FnMut()) {
+        if self
+            .filter
+            .as_ref()
+            .is_some_and(|filter| !name.contains(filter.as_str()))
+        {
+            return;
+        }
+
+        // find how many calls fill a sample, which also warms up caches
+        let mut iterations = 1u64;
+        loop {
+            let start = Instant::now();
+            for _ in 0..iterations {
+                f();
+            }
+            if start.elapsed() >= SAMPLE_TIME {
+                break;
+            }
+            iterations *= 2;
+        }
+
+        let mut samples: Vec<f64> = (0..SAMPLES)
+            .map(|_| {
+                let start = Instant::now();
+                for _ in 0..iterations {
+                    f();
+                }
+                start.elapsed().as_nanos() as f64 / iterations as f64
+            })
+            .collect();
+        samples.sort_by(f64::total_cmp);
+        let ns_per_call = samples[SAMPLES / 2];
+
+        println!(
+            "{name:<40} {ns_per_call:>10.1} ns/call {:>14.0} calls/s",
+            1e9 / ns_per_call
+        );
+        self.results.push(Measurement {
+            name: name.to_string(),
+            ns_per_call,
+        });
+    }
+}
+
+fn results_dir() -> PathBuf {
+    std::env::var_os("CARGO_TARGET_DIR")
+        .map_or_else(
+            || PathBuf::from(env!("CARGO_MANIFEST_DIR")).join("../target"),
+            PathBuf::from,
+        )
+        .join("ffi-bench")
+}
+
+fn read_results(path: &std::path::Path) -> Vec<(String, f64)> {
+    let Ok(contents) = std::fs::read_to_string(path) else {
+        return Vec::new();
+    };
+    contents
+        .lines()
+        .skip(1)
+        .filter_map(|line| {
+            let (name, ns) = line.split_once(',')?;
+            Some((name.to_string(), ns.parse().ok()?))
+        })
+        .collect()
+}
+
+fn save_and_compare(results: &[Measurement]) -> std::io::Result<()> {
+    let dir = results_dir();
+    std::fs::create_dir_all(&dir)?;
+    let path = dir.join(format!("{}.csv", env!("CARGO_PKG_VERSION")));
+    // a flagged run is kept apart, so it doesn't become the baseline of the next run
+    let latest = dir.join(format!("{}.latest.csv", env!("CARGO_PKG_VERSION")));
+
+    let previous = read_results(&path);
+    let (baseline_path, baseline) = match std::env::var_os("FMOD_BENCH_BASELINE") {
+        Some(baseline_path) => {
+            let baseline_path = PathBuf::from(baseline_path);
+            let baseline = read_results(&baseline_path);
+            (baseline_path, baseline)
+        }
+        None => (path.clone(), previous.clone()),
+    };
+    let mut regressions = 0;
+    if !baseline.is_empty() {
+        println!("\ncompared to {}:", baseline_path.display());
+        for result in results {
+            let Some((_, old)) = baseline.iter().find(|(name, _)| *name == result.name) else {
+                continue;
+            };
+            let ratio = result.ns_per_call / old;
+            let flag = if ratio > REGRESSION_THRESHOLD {
+                regressions += 1;
+                "  REGRESSED"
+            } else {
+                ""
+            };
+            println!("{:<40} {:>+9.1}%{flag}", result.name, (ratio - 1.0) * 100.0);
+        }
+    }
+
+    // filtered runs only replace the benchmarks they ran
+    let mut merged: Vec<_> = previous
+        .into_iter()
+        .filter(|(name, _)| !results.iter().any(|r| r.name == *name))
+        .collect();
+    merged.extend(results.iter().map(|r| (r.name.clone(), r.ns_per_call)));
+    merged.sort_by(|a, b| a.0.cmp(&b.0));
+
+    let mut csv = String::from("name,ns_per_call\n");
+    for (name, ns) in merged {
+        let _ = writeln!(csv, "{name},{ns:.2}");
+    }
+    std::fs::write(&latest, &csv)?;
+    if regressions == 0 {
+        std::fs::write(&path, csv)?;
+        println!("\nsaved to {}", path.display());
+    } else {
+        println!(
+            "\nsaved to {}, {} was kept as the baseline",
+            latest.display(),
+            path.display()
+        );
+    }
+    Ok(())
+}
+
+fn bench_channel_control(harness: &mut Harness, core: fmod::System) -> fmod::Result<()> {
+    // an oscillator plays forever without needing a sound file
+    let dsp = core.create_dsp_by_type(fmod::DspType::Oscillator)?;
+    let channel = core.play_dsp(dsp, None, true)?;
+    let raw: *mut FMOD_CHANNEL = channel.into();
+    let control = unsafe { FMOD_Channel_CastToControl(raw) };
+    let dynamic: fmod::ChannelControl = *channel;
+
+    harness.bench("cast/channel_to_control", || unsafe {
+        black_box(FMOD_Channel_CastToControl(black_box(raw)));
+    });
+    harness.bench("result/to_result", || {
+        let _ = black_box(black_box(FMOD_RESULT::FMOD_OK).to_result());
+    });
+
+    harness.bench("set_volume/native", || unsafe {
+        let _ = black_box(FMOD_Channel_SetVolume(raw, black_box(0.5)));
+    });
+    harness.bench("set_volume/shim", || unsafe {
+        let _ = black_box(FMOD_ChannelControl_SetVolume(control, black_box(0.5)));
+    });
+    harness.bench("set_volume/wrapper", || {
+        let _ = black_box(channel.set_volume(black_box(0.5)));
+    });
+    harness.bench("set_volume/dynamic", || {
+        let _ = black_box(dynamic.set_volume(black_box(0.5)));
+    });
+
+    harness.bench("get_volume/native", || unsafe {
+        let mut volume: c_float = 0.0;
+        let _ = black_box(FMOD_Channel_GetVolume(raw, &mut volume));
+        black_box(volume);
+    });
+    harness.bench("get_volume/shim", || unsafe {
+        let mut volume: c_float = 0.0;
+        let _ = black_box(FMOD_ChannelControl_GetVolume(control, &mut volume));
+        black_box(volume);
+    });
+    harness.bench("get_volume/wrapper", || {
+        let _ = black_box(channel.get_volume());
+    });
+    harness.bench("get_volume/dynamic", || {
+        let _ = black_box(dynamic.get_volume());
+    });
+
+    harness.bench("set_pitch/native", || unsafe {
+        let _ = black_box(FMOD_Channel_SetPitch(raw, black_box(1.0)));
+    });
+    harness.bench("set_pitch/shim", || unsafe {
+        let _ = black_box(FMOD_ChannelControl_SetPitch(control, black_box(1.0)));
+    });
+    harness.bench("set_pitch/wrapper", || {
+        let _ = black_box(channel.set_pitch(black_box(1.0)));
+    });
+    harness.bench("set_pitch/dynamic", || {
+        let _ = black_box(dynamic.set_pitch(black_box(1.0)));
+    });
+
+    harness.bench("get_paused/native", || unsafe {
+        let mut paused = FMOD_BOOL::FALSE;
+        let _ = black_box(FMOD_Channel_GetPaused(raw, &mut paused));
+        black_box(paused);
+    });
+    harness.bench("get_paused/shim", || unsafe {
+        let mut paused = false;
+        let _ = black_box(FMOD_ChannelControl_GetPaused(control, &mut paused));
+        black_box(paused);
+    });
+    harness.bench("get_paused/wrapper", || {
+        let _ = black_box(channel.get_paused());
+    });
+    harness.bench("get_paused/dynamic", || {
+        let _ = black_box(dynamic.get_paused());
+    });
+
+    harness.bench("userdata/raw_native", || unsafe {
+        let mut userdata: *mut c_void = std::ptr::null_mut();
+        let _ = black_box(FMOD_Channel_GetUserData(raw, &mut userdata));
+        black_box(userdata);
+    });
+    harness.bench("userdata/raw_wrapper", || {
+        let _ = black_box(channel.get_raw_userdata());
+    });
+    #[cfg(feature = "userdata-abstraction")]
+    {
+        channel.set_userdata(std::sync::Arc::new(42u32))?;
+        harness.bench("userdata/get_userdata", || {
+            let _ = black_box(channel.get_userdata());
+        });
+        harness.bench("userdata/with_userdata", || {
+            let _ = black_box(channel.with_userdata(|u| u.downcast_ref::<u32>().copied()));
+        });
+    }
+
+    let master = core.get_master_channel_group()?;
+    let raw_master: *mut FMOD_CHANNELGROUP = master.into();
+    harness.bench("get_string/native", || unsafe {
+        let mut buffer = [0 as c_char; 64];
+        let _ = black_box(FMOD_ChannelGroup_GetName(
+            raw_master,
+            buffer.as_mut_ptr(),
+            buffer.len() as c_int,
+        ));
+        black_box(buffer);
+    });
+    harness.bench("get_string/owned", || {
+        let _ = black_box(master.get_name());
+    });
+    let mut name = String::new();
+    harness.bench("get_string/into", || {
+        let _ = black_box(master.get_name_into(&mut name));
+    });
+
+    channel.stop()?;
+    dsp.release()?;
+    Ok(())
+}
+
+fn bench_studio_lookups(harness: &mut Harness, studio: fmod::studio::System) -> fmod::Result<()> {
+    let media = std::env::var_os("FMOD_BENCH_MEDIA").map_or_else(
+        || PathBuf::from(env!("CARGO_MANIFEST_DIR")).join("../fmod/api/studio/examples/media"),
+        PathBuf::from,
+    );
+    if !media.join("Master.bank").exists() {
+        println!(
+            "skipping studio lookups, no banks in {} (set FMOD_BENCH_MEDIA)",
+            media.display()
+        );
+        return Ok(());
+    }
+    let mut banks = Vec::new();
+    for bank in ["Master.bank", "Master.strings.bank", "SFX.bank"] {
+        let path = Utf8CString::new(media.join(bank).to_string_lossy().into_owned()).unwrap();
+        banks.push(studio.load_bank_file(&path, fmod::studio::LoadBankFlags::NORMAL)?);
+    }
+
+    let path = fmod::c!("event:/Ambience/Country");
+    let raw_studio: *mut FMOD_STUDIO_SYSTEM = studio.into();
+    let event = studio.get_event(path)?;
+    let id = event.get_id()?;
+
+    harness.bench("get_event/native", || unsafe {
+        let mut event = std::ptr::null_mut();
+        let _ = black_box(FMOD_Studio_System_GetEvent(
+            raw_studio,
+            path.as_ptr(),
+            &mut event,
+        ));
+        black_box(event);
+    });
+    harness.bench("get_event/wrapper", || {
+        let _ = black_box(studio.get_event(black_box(path)));
+    });
+    harness.bench("get_event/by_id", || {
+        let _ = black_box(studio.get_event_by_id(black_box(id)));
+    });
+    harness.bench("get_bank/wrapper", || {
+        let _ = black_box(studio.get_bank(black_box(fmod::c!("bank:/SFX"))));
+    });
+
+    let mut cache = fmod::studio::StudioPathCache::new();
+    for bank in &banks {
+        cache.add_bank(*bank)?;
+    }
+    let cached = cache.id(path.as_str()).unwrap();
+    harness.bench("get_event/path_cache_by_path", || {
+        black_box(
+            cache
+                .id(black_box(path.as_str()))
+                .and_then(|id| cache.event(id)),
+        );
+    });
+    harness.bench("get_event/path_cache_by_id", || {
+        black_box(cache.event(black_box(cached)));
+    });
+
+    harness.bench("get_path/owned", || {
+        let _ = black_box(event.get_path());
+    });
+    let mut buffer = String::new();
+    harness.bench("get_path/into", || {
+        let _ = black_box(event.get_path_into(&mut buffer));
+    });
+
+    for bank in banks {
+        bank.unload()?;
+    }
+    Ok(())
+}
+
+fn main() -> Result<(), Box<dyn std::error::Error>> {
+    // cargo passes --bench to harness = false targets
+    let filter = std::env::args().skip(1).find(|arg| !arg.starts_with('-'));
+    let mut harness = Harness {
+        filter,
+        results: Vec::new(),
+    };
+
+    let mut builder = unsafe {
+        // Safety: we call this before calling any other functions and only in main, so this is safe
+        fmod::studio::SystemBuilder::new()?
+    };
+    builder
+        .core_builder()
+        .output(fmod::OutputType::NoSoundNRT)?;
+    let studio = builder.build(
+        256,
+        fmod::studio::InitFlags::NORMAL,
+        fmod::InitFlags::NORMAL,
+    )?;
+    let core = studio.get_core_system()?;
+
+    bench_channel_control(&mut harness, core)?;
+    bench_studio_lookups(&mut harness, studio)?;
+
+    unsafe {
+        // Safety: nothing uses the system after this
+        studio.release()?;
+    }
+
+    save_and_compare(&harness.results)?;
+    Ok(())
+}
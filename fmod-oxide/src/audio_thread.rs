@@ -0,0 +1,441 @@
+// Copyright (c) 2024 Lily Lyons
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+use fmod_sys::*;
+use std::{
+    ffi::{c_float, c_int},
+    sync::{
+        atomic::{AtomicBool, AtomicU64, Ordering},
+        Arc, Mutex,
+    },
+    thread::JoinHandle,
+    time::{Duration, Instant},
+};
+
+use crate::{
+    bounded_queue::BoundedQueue,
+    studio::{EventDescription, EventInstance, ParameterID, StopMode, System},
+    Attributes3D, ThreadAffinity, Vector,
+};
+
+/// A Studio API call sent to an [`AudioThread`] with an [`AudioSender`].
+///
+/// Commands only hold handles and plain values, so sending one never allocates.
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub enum AudioCommand {
+    /// Creates an instance of `event`, places it at `attributes` if given, starts it and releases it,
+    /// so it cleans itself up once it stops.
+    Play {
+        event: EventDescription,
+        attributes: Option<Attributes3D>,
+    },
+    /// See [`EventInstance::start`].
+    Start(EventInstance),
+    /// See [`EventInstance::stop`].
+    Stop {
+        instance: EventInstance,
+        mode: StopMode,
+    },
+    /// See [`EventInstance::release`].
+    Release(EventInstance),
+    /// See [`EventInstance::set_parameter_by_id`].
+    SetParameter {
+        instance: EventInstance,
+        id: ParameterID,
+        value: c_float,
+        ignore_seek_speed: bool,
+    },
+    /// See [`System::set_parameter_by_id`].
+    SetGlobalParameter {
+        id: ParameterID,
+        value: c_float,
+        ignore_seek_speed: bool,
+    },
+    /// See [`EventInstance::set_3d_attributes`].
+    Set3DAttributes {
+        instance: EventInstance,
+        attributes: Attributes3D,
+    },
+    /// See [`System::set_listener_attributes`].
+    SetListenerAttributes {
+        listener: c_int,
+        attributes: Attributes3D,
+        attenuation_position: Option<Vector>,
+    },
+}
+
+impl AudioCommand {
+    fn execute(self, system: System) -> Result<()> {
+        match self {
+            AudioCommand::Play { event, attributes } => {
+                let instance = event.create_instance()?;
+                // release even if starting fails, nothing else has the handle
+                let started = attributes
+                    .map_or(Ok(()), |attributes| instance.set_3d_attributes(attributes))
+                    .and_then(|()| instance.start());
+                instance.release()?;
+                started
+            }
+            AudioCommand::Start(instance) => instance.start(),
+            AudioCommand::Stop { instance, mode } => instance.stop(mode),
+            AudioCommand::Release(instance) => instance.release(),
+            AudioCommand::SetParameter {
+                instance,
+                id,
+                value,
+                ignore_seek_speed,
+            } => instance.set_parameter_by_id(id, value, ignore_seek_speed),
+            AudioCommand::SetGlobalParameter {
+                id,
+                value,
+                ignore_seek_speed,
+            } => system.set_parameter_by_id(id, value, ignore_seek_speed),
+            AudioCommand::Set3DAttributes {
+                instance,
+                attributes,
+            } => instance.set_3d_attributes(attributes),
+            AudioCommand::SetListenerAttributes {
+                listener,
+                attributes,
+                attenuation_position,
+            } => system.set_listener_attributes(listener, attributes, attenuation_position),
+        }
+    }
+}
+
+/// What an [`AudioThread`] has done since it was spawned, see [`AudioThread::stats`].
+#[derive(Debug, Clone, Default, PartialEq)]
+pub struct AudioThreadStats {
+    /// Number of times [`System::update`] was called.
+    pub updates: u64,
+    /// Commands executed.
+    pub commands: u64,
+    /// Executed commands that returned an error.
+    pub failed_commands: u64,
+    /// Commands that could not be sent because the queue was full.
+    pub rejected_commands: u64,
+    /// Ticks that took longer than the update interval. The next tick starts right away instead of catching up.
+    pub overruns: u64,
+    /// How long the last tick (executing commands and updating) took.
+    pub last_tick: Duration,
+    /// How long the longest tick took.
+    pub max_tick: Duration,
+    /// The last error returned by a command or [`System::update`].
+    pub last_error: Option<Error>,
+    /// Whether the thread was pinned to the cores given to [`AudioThreadBuilder::affinity`].
+    pub pinned: bool,
+}
+
+struct Shared {
+    commands: BoundedQueue<AudioCommand>,
+    running: AtomicBool,
+    rejected: AtomicU64,
+    stats: Mutex<AudioThreadStats>,
+}
+
+/// Sends [`AudioCommand`]s to an [`AudioThread`] from any thread.
+///
+/// Sending is lock-free and never blocks, the command is executed on the next tick of the audio thread.
+/// Commands from one sender are executed in the order they were sent.
+#[derive(Clone)]
+pub struct AudioSender {
+    shared: Arc<Shared>,
+}
+
+impl AudioSender {
+    /// Queues `command`, giving it back if the queue is full.
+    pub fn send(&self, command: AudioCommand) -> std::result::Result<(), AudioCommand> {
+        self.shared.commands.push(command).map_err(|command| {
+            self.shared.rejected.fetch_add(1, Ordering::Relaxed);
+            command
+        })
+    }
+
+    /// Queues every command in `commands` in order, stopping at the first one that doesn't fit.
+    ///
+    /// Returns how many commands were queued.
+    pub fn send_batch(&self, commands: &[AudioCommand]) -> usize {
+        commands
+            .iter()
+            .take_while(|command| self.send(**command).is_ok())
+            .count()
+    }
+
+    /// How many commands fit in the queue.
+    pub fn capacity(&self) -> usize {
+        self.shared.commands.capacity()
+    }
+}
+
+impl std::fmt::Debug for AudioSender {
+    fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+        f.debug_struct("AudioSender")
+            .field("capacity", &self.capacity())
+            .finish_non_exhaustive()
+    }
+}
+
+/// Configures and spawns an [`AudioThread`].
+#[derive(Debug, Clone)]
+pub struct AudioThreadBuilder {
+    interval: Duration,
+    queue_capacity: usize,
+    affinity: Option<ThreadAffinity>,
+    name: String,
+}
+
+impl Default for AudioThreadBuilder {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+impl AudioThreadBuilder {
+    /// Updates every 20ms (the default Studio update period) with room for 4096 queued commands.
+    pub fn new() -> Self {
+        Self {
+            interval: Duration::from_millis(20),
+            queue_capacity: 4096,
+            affinity: None,
+            name: "fmod-audio".to_string(),
+        }
+    }
+
+    /// How often the thread executes queued commands and calls [`System::update`].
+    pub fn interval(mut self, interval: Duration) -> Self {
+        self.interval = interval;
+        self
+    }
+
+    /// How many commands can be queued between two ticks. Rounded up to a power of two.
+    pub fn queue_capacity(mut self, capacity: usize) -> Self {
+        self.queue_capacity = capacity;
+        self
+    }
+
+    /// Pins the thread to the cores in `affinity`, given as [`ThreadAffinity::CORE_0`] and friends.
+    ///
+    /// Group affinities like [`ThreadAffinity::GROUP_A`] are resolved by FMOD per platform and don't name cores, so they are ignored.
+    /// Pinning is only supported on Linux, check [`AudioThreadStats::pinned`].
+    /// Use [`crate::thread::set_attributes`] to place FMOD's own threads (like [`crate::ThreadType::StudioUpdate`]) before creating the system.
+    pub fn affinity(mut self, affinity: ThreadAffinity) -> Self {
+        self.affinity = Some(affinity);
+        self
+    }
+
+    pub fn name(mut self, name: impl Into<String>) -> Self {
+        self.name = name.into();
+        self
+    }
+
+    /// Spawns the thread, which takes over updating `system`.
+    pub fn spawn(self, system: System) -> Result<AudioThread> {
+        let Self {
+            interval,
+            queue_capacity,
+            affinity,
+            name,
+        } = self;
+        let shared = Arc::new(Shared {
+            commands: BoundedQueue::with_capacity(queue_capacity),
+            running: AtomicBool::new(true),
+            rejected: AtomicU64::new(0),
+            stats: Mutex::new(AudioThreadStats::default()),
+        });
+
+        let thread_shared = shared.clone();
+        let handle = std::thread::Builder::new()
+            .name(name)
+            .spawn(move || run(&thread_shared, system, interval, affinity))
+            // spawning only fails when the os is out of threads or memory
+            .map_err(|_| Error::Fmod(FMOD_RESULT::FMOD_ERR_MEMORY))?;
+
+        Ok(AudioThread {
+            system,
+            shared,
+            handle: Some(handle),
+        })
+    }
+}
+
+/// A thread that owns the updating of a Studio [`System`], so the game's threads never pay for FMOD API calls.
+///
+/// Game threads send [`AudioCommand`]s through [`AudioSender`]s, which push them onto a lock-free queue.
+/// Every tick the audio thread executes every queued command and then calls [`System::update`],
+/// at a fixed interval that doesn't depend on the game's frame rate or frame hitches.
+/// With [`crate::studio::InitFlags::SYNCHRONOUS_UPDATE`] all of Studio's processing happens on this thread.
+///
+/// Once spawned, nothing else should call [`System::update`] on the system.
+/// Other thread safe Studio calls (like creating instances) can still be made from anywhere with [`AudioThread::system`].
+///
+/// ```rust,ignore
+/// let audio = AudioThreadBuilder::new()
+///     .affinity(ThreadAffinity::CORE_2)
+///     .spawn(system)?;
+/// let sender = audio.sender();
+/// // on any game thread
+/// let _ = sender.send(AudioCommand::Play { event: footstep, attributes: Some(attributes) });
+/// ```
+///
+/// Dropping the thread stops it, see [`AudioThread::shutdown`].
+#[derive(Debug)]
+pub struct AudioThread {
+    system: System,
+    shared: Arc<Shared>,
+    handle: Option<JoinHandle<()>>,
+}
+
+impl AudioThread {
+    /// Spawns an audio thread with the default settings, see [`AudioThreadBuilder::new`].
+    pub fn spawn(system: System) -> Result<Self> {
+        AudioThreadBuilder::new().spawn(system)
+    }
+
+    pub fn system(&self) -> System {
+        self.system
+    }
+
+    pub fn sender(&self) -> AudioSender {
+        AudioSender {
+            shared: self.shared.clone(),
+        }
+    }
+
+    pub fn stats(&self) -> AudioThreadStats {
+        let mut stats = self.shared.stats.lock().unwrap().clone();
+        stats.rejected_commands = self.shared.rejected.load(Ordering::Relaxed);
+        stats
+    }
+
+    /// Stops the thread after a final tick, so every command sent before this call is executed.
+    ///
+    /// Returns the system, which can be updated from elsewhere again.
+    pub fn shutdown(mut self) -> System {
+        self.stop();
+        self.system
+    }
+
+    /// Stops the thread after a final tick and releases the system, see [`System::release`].
+    ///
+    /// # Safety
+    ///
+    /// See [`System::release`]. [`AudioSender`]s outlive the system, commands sent after this call are never executed.
+    pub unsafe fn release(self) -> Result<()> {
+        let system = self.shutdown();
+        unsafe { system.release() }
+    }
+
+    fn stop(&mut self) {
+        if let Some(handle) = self.handle.take() {
+            self.shared.running.store(false, Ordering::Release);
+            handle.thread().unpark();
+            let _ = handle.join();
+        }
+    }
+}
+
+impl Drop for AudioThread {
+    fn drop(&mut self) {
+        self.stop();
+    }
+}
+
+impl std::fmt::Debug for Shared {
+    fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+        f.debug_struct("Shared")
+            .field("running", &self.running)
+            .finish_non_exhaustive()
+    }
+}
+
+fn run(shared: &Shared, system: System, interval: Duration, affinity: Option<ThreadAffinity>) {
+    let pinned = affinity.is_some_and(pin_current_thread);
+    shared.stats.lock().unwrap().pinned = pinned;
+
+    let mut next_tick = Instant::now();
+    loop {
+        let running = shared.running.load(Ordering::Acquire);
+        tick(shared, system);
+        if !running {
+            // the final tick has executed everything sent before shutdown
+            return;
+        }
+
+        next_tick += interval;
+        let now = Instant::now();
+        if next_tick <= now {
+            shared.stats.lock().unwrap().overruns += 1;
+            next_tick = now;
+        }
+        // parking can wake up early, and is woken by shutdown
+        while shared.running.load(Ordering::Acquire) {
+            let now = Instant::now();
+            if now >= next_tick {
+                break;
+            }
+            std::thread::park_timeout(next_tick - now);
+        }
+    }
+}
+
+fn tick(shared: &Shared, system: System) {
+    let start = Instant::now();
+    let mut commands = 0;
+    let mut failed = 0;
+    let mut last_error = None;
+    // only what was queued so far, so a flood of commands can't hold up the update
+    for _ in 0..shared.commands.capacity() {
+        let Some(command) = shared.commands.pop() else {
+            break;
+        };
+        commands += 1;
+        if let Err(error) = command.execute(system) {
+            failed += 1;
+            last_error = Some(error);
+        }
+    }
+    if let Err(error) = system.update() {
+        last_error = Some(error);
+    }
+    let elapsed = start.elapsed();
+
+    let mut stats = shared.stats.lock().unwrap();
+    stats.updates += 1;
+    stats.commands += commands;
+    stats.failed_commands += failed;
+    stats.last_tick = elapsed;
+    stats.max_tick = stats.max_tick.max(elapsed);
+    if last_error.is_some() {
+        stats.last_error = last_error;
+    }
+}
+
+// group affinities and CORE_ALL are placeholders FMOD resolves per platform, only explicit core masks can be pinned
+fn core_mask(affinity: ThreadAffinity) -> Option<u64> {
+    let bits = affinity.bits() as u64;
+    let group = ThreadAffinity::GROUP_DEFAULT.bits() as u64;
+    (bits != 0 && bits & group == 0).then_some(bits)
+}
+
+#[cfg(target_os = "linux")]
+fn pin_current_thread(affinity: ThreadAffinity) -> bool {
+    let Some(mask) = core_mask(affinity) else {
+        return false;
+    };
+    unsafe {
+        let mut set: libc::cpu_set_t = std::mem::zeroed();
+        for core in (0..64).filter(|core| mask & (1 << core) != 0) {
+            libc::CPU_SET(core, &mut set);
+        }
+        libc::sched_setaffinity(0, std::mem::size_of::<libc::cpu_set_t>(), &set) == 0
+    }
+}
+
+#[cfg(not(target_os = "linux"))]
+fn pin_current_thread(affinity: ThreadAffinity) -> bool {
+    let _ = core_mask(affinity);
+    false
+}
@@ -0,0 +1,114 @@
+// Copyright (c) 2024 Lily Lyons
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+use std::{
+    cell::UnsafeCell,
+    mem::MaybeUninit,
+    sync::atomic::{AtomicUsize, Ordering},
+};
+
+// A bounded lock-free queue with any number of producers and consumers.
+// It is a ring where every slot has a sequence number:
+// a slot can be written once its sequence equals the write position, and read once it equals the write position + 1.
+// Pushing and popping only ever take a few atomic operations and never allocate or block.
+pub(crate) struct BoundedQueue<T> {
+    slots: Box<[Slot<T>]>,
+    write: AtomicUsize,
+    read: AtomicUsize,
+}
+
+struct Slot<T> {
+    sequence: AtomicUsize,
+    value: UnsafeCell<MaybeUninit<T>>,
+}
+
+// slots are only accessed by whoever claimed them through the sequence number
+unsafe impl<T: Send> Sync for BoundedQueue<T> {}
+
+impl<T> BoundedQueue<T> {
+    /// Creates a queue holding at least `capacity` values. The capacity is rounded up to a power of two.
+    pub(crate) fn with_capacity(capacity: usize) -> Self {
+        let capacity = capacity.max(2).next_power_of_two();
+        let slots = (0..capacity)
+            .map(|i| Slot {
+                sequence: AtomicUsize::new(i),
+                value: UnsafeCell::new(MaybeUninit::uninit()),
+            })
+            .collect();
+        Self {
+            slots,
+            write: AtomicUsize::new(0),
+            read: AtomicUsize::new(0),
+        }
+    }
+
+    pub(crate) fn capacity(&self) -> usize {
+        self.slots.len()
+    }
+
+    /// Pushes `value`, or gives it back if the queue is full.
+    pub(crate) fn push(&self, value: T) -> Result<(), T> {
+        let mask = self.slots.len() - 1;
+        let mut position = self.write.load(Ordering::Relaxed);
+        loop {
+            let slot = &self.slots[position & mask];
+            let sequence = slot.sequence.load(Ordering::Acquire);
+            match sequence.wrapping_sub(position) as isize {
+                0 => match self.write.compare_exchange_weak(
+                    position,
+                    position.wrapping_add(1),
+                    Ordering::Relaxed,
+                    Ordering::Relaxed,
+                ) {
+                    Ok(_) => {
+                        unsafe { (*slot.value.get()).write(value) };
+                        slot.sequence
+                            .store(position.wrapping_add(1), Ordering::Release);
+                        return Ok(());
+                    }
+                    Err(current) => position = current,
+                },
+                // the slot still holds a value from the last time around the ring
+                diff if diff < 0 => return Err(value),
+                _ => position = self.write.load(Ordering::Relaxed),
+            }
+        }
+    }
+
+    pub(crate) fn pop(&self) -> Option<T> {
+        let mask = self.slots.len() - 1;
+        let mut position = self.read.load(Ordering::Relaxed);
+        loop {
+            let slot = &self.slots[position & mask];
+            let sequence = slot.sequence.load(Ordering::Acquire);
+            match sequence.wrapping_sub(position.wrapping_add(1)) as isize {
+                0 => match self.read.compare_exchange_weak(
+                    position,
+                    position.wrapping_add(1),
+                    Ordering::Relaxed,
+                    Ordering::Relaxed,
+                ) {
+                    Ok(_) => {
+                        let value = unsafe { (*slot.value.get()).assume_init_read() };
+                        slot.sequence
+                            .store(position.wrapping_add(mask + 1), Ordering::Release);
+                        return Some(value);
+                    }
+                    Err(current) => position = current,
+                },
+                // nothing has been written here yet
+                diff if diff < 0 => return None,
+                _ => position = self.read.load(Ordering::Relaxed),
+            }
+        }
+    }
+}
+
+impl<T> Drop for BoundedQueue<T> {
+    fn drop(&mut self) {
+        while self.pop().is_some() {}
+    }
+}
@@ -0,0 +1,254 @@
+// Copyright (c) 2024 Lily Lyons
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+use fmod_sys::*;
+use std::{
+    ffi::{c_int, c_void},
+    sync::{
+        atomic::{AtomicUsize, Ordering},
+        OnceLock,
+    },
+};
+
+#[cfg(feature = "userdata-abstraction")]
+use crate::userdata::{HasUserdata, UserdataKey};
+use crate::{
+    bounded_queue::BoundedQueue,
+    studio::{EventCallbackMask, EventDescription, EventInstance},
+    Channel, ChannelControl, ChannelControlType, ChannelGroup,
+};
+
+/// A callback recorded by a deferred callback, see [`ChannelControl::set_deferred_callback`] and [`EventInstance::set_deferred_callback`].
+///
+/// Only the handle and the data that fits in the record are kept,
+/// pointers FMOD passes to the callback (like programmer sound properties) are only valid during the callback and are not recorded.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum CallbackEvent {
+    /// See [`crate::ChannelControlCallback::end`].
+    End(ChannelControlType),
+    /// See [`crate::ChannelControlCallback::virtual_voice`].
+    VirtualVoice {
+        channel_control: ChannelControlType,
+        is_virtual: bool,
+    },
+    /// See [`crate::ChannelControlCallback::sync_point`].
+    SyncPoint {
+        channel_control: ChannelControlType,
+        sync_point: c_int,
+    },
+    /// An event instance callback. `kind` has exactly one flag set.
+    ///
+    /// For [`EventCallbackMask::START_EVENT_COMMAND`] `new_event` is the event that was started.
+    Event {
+        event: EventInstance,
+        kind: EventCallbackMask,
+        new_event: Option<EventInstance>,
+    },
+}
+
+// Callbacks fire on several FMOD threads (the mixer, the studio update thread, the file thread), so the queue has multiple producers.
+// Pushing only ever takes a few atomic operations and never allocates or blocks. When the queue is full pushed events are dropped.
+struct CallbackQueue {
+    events: BoundedQueue<CallbackEvent>,
+    dropped: AtomicUsize,
+    // userdata of objects destroyed since the last drain.
+    // dropping it takes the userdata lock and runs user code, so it's done when draining rather than in the callback.
+    // if this is full the next userdata sweep picks it up instead
+    #[cfg(feature = "userdata-abstraction")]
+    releases: BoundedQueue<(UserdataKey, HasUserdata)>,
+}
+
+const CALLBACK_QUEUE_CAPACITY: usize = 4096;
+
+static QUEUE: OnceLock<CallbackQueue> = OnceLock::new();
+
+impl CallbackQueue {
+    fn new() -> Self {
+        Self {
+            events: BoundedQueue::with_capacity(CALLBACK_QUEUE_CAPACITY),
+            dropped: AtomicUsize::new(0),
+            #[cfg(feature = "userdata-abstraction")]
+            releases: BoundedQueue::with_capacity(CALLBACK_QUEUE_CAPACITY),
+        }
+    }
+
+    fn push(&self, event: CallbackEvent) {
+        if self.events.push(event).is_err() {
+            self.dropped.fetch_add(1, Ordering::Relaxed);
+        }
+    }
+
+    fn pop(&self) -> Option<CallbackEvent> {
+        self.events.pop()
+    }
+}
+
+// the queue is allocated when a deferred callback is set, so callbacks never allocate it
+fn init_queue() {
+    QUEUE.get_or_init(CallbackQueue::new);
+}
+
+fn push_event(event: CallbackEvent) {
+    if let Some(queue) = QUEUE.get() {
+        queue.push(event);
+    }
+}
+
+// the object is invalid after this callback, like the immediate callbacks its userdata is dropped without waiting for a sweep
+#[cfg(feature = "userdata-abstraction")]
+fn push_release(pointer: fmod_sys::Result<*mut c_void>, owner: impl Into<HasUserdata>) {
+    let Ok(pointer) = pointer else {
+        return;
+    };
+    if pointer.is_null() {
+        return;
+    }
+    if let Some(queue) = QUEUE.get() {
+        let _ = queue.releases.push((pointer.into(), owner.into()));
+    }
+}
+
+/// Moves every queued callback event into `events` and drops the userdata of destroyed objects, returning how many events were dropped since the last call because the queue was full.
+pub(crate) fn drain_callback_events(events: &mut Vec<CallbackEvent>) -> usize {
+    let Some(queue) = QUEUE.get() else {
+        return 0;
+    };
+    while let Some(event) = queue.pop() {
+        events.push(event);
+    }
+    #[cfg(feature = "userdata-abstraction")]
+    while let Some((key, owner)) = queue.releases.pop() {
+        crate::userdata::release_userdata(key, owner);
+    }
+    queue.dropped.swap(0, Ordering::Relaxed)
+}
+
+unsafe extern "C" fn deferred_channel_callback_impl(
+    channel_control: *mut FMOD_CHANNELCONTROL,
+    control_type: FMOD_CHANNELCONTROL_TYPE,
+    callback_type: FMOD_CHANNELCONTROL_CALLBACK_TYPE,
+    commanddata1: *mut c_void,
+    _commanddata2: *mut c_void,
+) -> FMOD_RESULT {
+    let channel_control = match control_type {
+        FMOD_CHANNELCONTROL_CHANNEL => {
+            ChannelControlType::Channel(Channel::from(channel_control.cast::<FMOD_CHANNEL>()))
+        }
+        FMOD_CHANNELCONTROL_CHANNELGROUP => ChannelControlType::ChannelGroup(ChannelGroup::from(
+            channel_control.cast::<FMOD_CHANNELGROUP>(),
+        )),
+        _ => return FMOD_RESULT::FMOD_ERR_INVALID_PARAM, // this should never happen
+    };
+
+    let event = match callback_type {
+        FMOD_CHANNELCONTROL_CALLBACK_END => {
+            #[cfg(feature = "userdata-abstraction")]
+            push_release(channel_control.get_raw_userdata(), *channel_control);
+            CallbackEvent::End(channel_control)
+        }
+        FMOD_CHANNELCONTROL_CALLBACK_VIRTUALVOICE => CallbackEvent::VirtualVoice {
+            channel_control,
+            is_virtual: unsafe { *commanddata1.cast::<i32>() } != 0,
+        },
+        FMOD_CHANNELCONTROL_CALLBACK_SYNCPOINT => CallbackEvent::SyncPoint {
+            channel_control,
+            sync_point: unsafe { *commanddata1.cast::<c_int>() },
+        },
+        // occlusion has to be answered immediately, so it can't be deferred. leave the values untouched
+        _ => return FMOD_RESULT::FMOD_OK,
+    };
+    push_event(event);
+    FMOD_RESULT::FMOD_OK
+}
+
+unsafe extern "C" fn deferred_event_callback_impl(
+    kind: FMOD_STUDIO_EVENT_CALLBACK_TYPE,
+    event: *mut FMOD_STUDIO_EVENTINSTANCE,
+    parameters: *mut c_void,
+) -> FMOD_RESULT {
+    let event = EventInstance::from(event);
+    let new_event = (kind == FMOD_STUDIO_EVENT_CALLBACK_START_EVENT_COMMAND)
+        .then(|| EventInstance::from(parameters.cast::<FMOD_STUDIO_EVENTINSTANCE>()));
+    push_event(CallbackEvent::Event {
+        event,
+        kind: kind.into(),
+        new_event,
+    });
+    #[cfg(feature = "userdata-abstraction")]
+    if kind == FMOD_STUDIO_EVENT_CALLBACK_DESTROYED {
+        push_release(event.get_raw_userdata(), event);
+    }
+    FMOD_RESULT::FMOD_OK
+}
+
+impl ChannelControl {
+    /// Sets a callback that records [`CallbackEvent`]s into a preallocated queue instead of running user code on FMOD's threads.
+    ///
+    /// Recording an event never allocates, locks or blocks, so the mixer can't be stalled by the callback.
+    /// Drain the events from the game thread with [`crate::System::drain_callback_events`].
+    ///
+    /// Occlusion callbacks can't be deferred, and are ignored.
+    pub fn set_deferred_callback(&self) -> Result<()> {
+        init_queue();
+        unsafe {
+            FMOD_ChannelControl_SetCallback(self.inner, Some(deferred_channel_callback_impl))
+                .to_result()
+        }
+    }
+}
+
+impl EventInstance {
+    /// Sets a callback that records [`CallbackEvent`]s into a preallocated queue instead of running user code on FMOD's threads.
+    ///
+    /// See [`ChannelControl::set_deferred_callback`].
+    pub fn set_deferred_callback(&self, mask: EventCallbackMask) -> Result<()> {
+        init_queue();
+        unsafe {
+            FMOD_Studio_EventInstance_SetCallback(
+                self.inner,
+                Some(deferred_event_callback_impl),
+                mask.into(),
+            )
+            .to_result()
+        }
+    }
+}
+
+impl EventDescription {
+    /// Sets a deferred callback for every instance of this event, see [`EventInstance::set_deferred_callback`].
+    pub fn set_deferred_callback(&self, mask: EventCallbackMask) -> Result<()> {
+        init_queue();
+        unsafe {
+            FMOD_Studio_EventDescription_SetCallback(
+                self.inner,
+                Some(deferred_event_callback_impl),
+                mask.into(),
+            )
+            .to_result()
+        }
+    }
+}
+
+impl crate::System {
+    /// Moves every [`CallbackEvent`] recorded by deferred callbacks into `events`, in the order they were recorded.
+    ///
+    /// The queue is shared between every system. It holds 4096 events, and events recorded while it is full are dropped.
+    /// Returns how many events were dropped since the last call, which should normally be 0.
+    #[cfg_attr(
+        feature = "userdata-abstraction",
+        doc = "\n#### Note: This function also drops the userdata of objects whose end or destroyed callback was recorded."
+    )]
+    pub fn drain_callback_events(&self, events: &mut Vec<CallbackEvent>) -> usize {
+        drain_callback_events(events)
+    }
+}
+
+impl crate::studio::System {
+    /// See [`crate::System::drain_callback_events`].
+    pub fn drain_callback_events(&self, events: &mut Vec<CallbackEvent>) -> usize {
+        drain_callback_events(events)
+    }
+}
@@ -0,0 +1,392 @@
+// Copyright (c) 2024 Lily Lyons
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+use fmod_sys::*;
+use std::ffi::{c_float, c_int, c_ulonglong};
+
+use crate::{ChannelControl, Mode, Vector};
+
+/// A reusable list of [`ChannelControl`] setter calls that are applied with a single FFI call.
+///
+/// Every setter takes the target [`ChannelControl`] and records the command without calling into FMOD.
+/// [`ChannelControlBatch::apply`] then runs all of them in order on the C++ side.
+///
+/// The batch keeps its buffers between frames, so clearing and refilling it does not allocate once it has grown large enough.
+///
+/// ```ignore
+/// let mut batch = ChannelControl::batch();
+/// for (channel, volume) in voices {
+///     batch.set_volume(&channel, volume).set_pitch(&channel, 1.0);
+/// }
+/// batch.apply()?;
+/// batch.clear();
+/// ```
+#[derive(Default)]
+pub struct ChannelControlBatch {
+    commands: Vec<FMOD_CHANNELCONTROL_CMD>,
+    results: Vec<FMOD_RESULT>,
+}
+
+unsafe impl Send for ChannelControlBatch {}
+unsafe impl Sync for ChannelControlBatch {}
+
+impl ChannelControl {
+    /// Creates an empty [`ChannelControlBatch`].
+    pub fn batch() -> ChannelControlBatch {
+        ChannelControlBatch::new()
+    }
+}
+
+impl ChannelControlBatch {
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    pub fn with_capacity(capacity: usize) -> Self {
+        Self {
+            commands: Vec::with_capacity(capacity),
+            results: Vec::with_capacity(capacity),
+        }
+    }
+
+    /// Returns the number of recorded commands.
+    pub fn len(&self) -> usize {
+        self.commands.len()
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.commands.is_empty()
+    }
+
+    /// Removes all recorded commands and results, keeping the allocated buffers.
+    pub fn clear(&mut self) {
+        self.commands.clear();
+        self.results.clear();
+    }
+
+    /// Applies every recorded command in order.
+    ///
+    /// All commands are applied even if an earlier one fails (for example because a [`crate::Channel`] was stolen).
+    /// The first error encountered is returned, the result of each individual command can be retrieved with [`ChannelControlBatch::results`].
+    ///
+    /// The commands are not cleared, use [`ChannelControlBatch::clear`] before recording the next batch.
+    pub fn apply(&mut self) -> Result<()> {
+        self.results.clear();
+        self.results
+            .resize(self.commands.len(), FMOD_RESULT::FMOD_OK);
+        unsafe {
+            FMOD_ChannelControl_ApplyBatch(
+                self.commands.as_ptr(),
+                self.commands.len() as c_int,
+                self.results.as_mut_ptr(),
+            )
+            .to_result()
+        }
+    }
+
+    /// Retrieves the result of each command from the last call to [`ChannelControlBatch::apply`], in the order they were recorded.
+    pub fn results(&self) -> impl ExactSizeIterator<Item = Result<()>> + '_ {
+        self.results.iter().map(|r| r.to_result())
+    }
+
+    fn push(
+        &mut self,
+        target: &ChannelControl,
+        kind: FMOD_CHANNELCONTROL_CMD_TYPE,
+        data: FMOD_CHANNELCONTROL_CMD_DATA,
+    ) -> &mut Self {
+        self.commands.push(FMOD_CHANNELCONTROL_CMD {
+            channelcontrol: target.inner,
+            type_: kind,
+            data,
+        });
+        self
+    }
+
+    /// Records [`ChannelControl::stop`].
+    pub fn stop(&mut self, target: &ChannelControl) -> &mut Self {
+        self.push(
+            target,
+            FMOD_CHANNELCONTROL_CMD_STOP,
+            FMOD_CHANNELCONTROL_CMD_DATA::default(),
+        )
+    }
+
+    /// Records [`ChannelControl::set_paused`].
+    pub fn set_paused(&mut self, target: &ChannelControl, paused: bool) -> &mut Self {
+        self.push(
+            target,
+            FMOD_CHANNELCONTROL_CMD_SETPAUSED,
+            FMOD_CHANNELCONTROL_CMD_DATA { boolean: paused },
+        )
+    }
+
+    /// Records [`ChannelControl::set_volume`].
+    pub fn set_volume(&mut self, target: &ChannelControl, volume: c_float) -> &mut Self {
+        self.push(
+            target,
+            FMOD_CHANNELCONTROL_CMD_SETVOLUME,
+            FMOD_CHANNELCONTROL_CMD_DATA { value: volume },
+        )
+    }
+
+    /// Records a [`ChannelControl::set_volume`] to the current volume multiplied by `scale`.
+    ///
+    /// The current volume is read when the batch is applied, so this composes with any other volume changes in the batch.
+    pub fn scale_volume(&mut self, target: &ChannelControl, scale: c_float) -> &mut Self {
+        self.push(
+            target,
+            FMOD_CHANNELCONTROL_CMD_SCALEVOLUME,
+            FMOD_CHANNELCONTROL_CMD_DATA { value: scale },
+        )
+    }
+
+    /// Records [`ChannelControl::set_volume_ramp`].
+    pub fn set_volume_ramp(&mut self, target: &ChannelControl, ramp: bool) -> &mut Self {
+        self.push(
+            target,
+            FMOD_CHANNELCONTROL_CMD_SETVOLUMERAMP,
+            FMOD_CHANNELCONTROL_CMD_DATA { boolean: ramp },
+        )
+    }
+
+    /// Records [`ChannelControl::set_pitch`].
+    pub fn set_pitch(&mut self, target: &ChannelControl, pitch: c_float) -> &mut Self {
+        self.push(
+            target,
+            FMOD_CHANNELCONTROL_CMD_SETPITCH,
+            FMOD_CHANNELCONTROL_CMD_DATA { value: pitch },
+        )
+    }
+
+    /// Records [`ChannelControl::set_mute`].
+    pub fn set_mute(&mut self, target: &ChannelControl, mute: bool) -> &mut Self {
+        self.push(
+            target,
+            FMOD_CHANNELCONTROL_CMD_SETMUTE,
+            FMOD_CHANNELCONTROL_CMD_DATA { boolean: mute },
+        )
+    }
+
+    /// Records [`ChannelControl::set_reverb_properties`].
+    pub fn set_reverb_properties(
+        &mut self,
+        target: &ChannelControl,
+        instance: c_int,
+        wet: c_float,
+    ) -> &mut Self {
+        self.push(
+            target,
+            FMOD_CHANNELCONTROL_CMD_SETREVERBPROPERTIES,
+            FMOD_CHANNELCONTROL_CMD_DATA {
+                reverb: FMOD_CHANNELCONTROL_CMD_REVERB { instance, wet },
+            },
+        )
+    }
+
+    /// Records [`ChannelControl::set_low_pass_gain`].
+    pub fn set_low_pass_gain(&mut self, target: &ChannelControl, gain: c_float) -> &mut Self {
+        self.push(
+            target,
+            FMOD_CHANNELCONTROL_CMD_SETLOWPASSGAIN,
+            FMOD_CHANNELCONTROL_CMD_DATA { value: gain },
+        )
+    }
+
+    /// Records [`ChannelControl::set_mode`].
+    pub fn set_mode(&mut self, target: &ChannelControl, mode: Mode) -> &mut Self {
+        self.push(
+            target,
+            FMOD_CHANNELCONTROL_CMD_SETMODE,
+            FMOD_CHANNELCONTROL_CMD_DATA { mode: mode.into() },
+        )
+    }
+
+    /// Records [`ChannelControl::set_pan`].
+    pub fn set_pan(&mut self, target: &ChannelControl, pan: c_float) -> &mut Self {
+        self.push(
+            target,
+            FMOD_CHANNELCONTROL_CMD_SETPAN,
+            FMOD_CHANNELCONTROL_CMD_DATA { value: pan },
+        )
+    }
+
+    /// Records [`ChannelControl::set_delay`].
+    pub fn set_delay(
+        &mut self,
+        target: &ChannelControl,
+        start: c_ulonglong,
+        end: c_ulonglong,
+        stop_channels: bool,
+    ) -> &mut Self {
+        self.push(
+            target,
+            FMOD_CHANNELCONTROL_CMD_SETDELAY,
+            FMOD_CHANNELCONTROL_CMD_DATA {
+                delay: FMOD_CHANNELCONTROL_CMD_DELAY {
+                    dspclock_start: start,
+                    dspclock_end: end,
+                    stopchannels: stop_channels,
+                },
+            },
+        )
+    }
+
+    /// Records [`ChannelControl::add_fade_point`].
+    pub fn add_fade_point(
+        &mut self,
+        target: &ChannelControl,
+        dsp_clock: c_ulonglong,
+        volume: c_float,
+    ) -> &mut Self {
+        self.push(
+            target,
+            FMOD_CHANNELCONTROL_CMD_ADDFADEPOINT,
+            FMOD_CHANNELCONTROL_CMD_DATA {
+                fadepoint: FMOD_CHANNELCONTROL_CMD_FADEPOINT {
+                    dspclock: dsp_clock,
+                    volume,
+                },
+            },
+        )
+    }
+
+    /// Records [`ChannelControl::set_fade_point_ramp`].
+    pub fn set_fade_point_ramp(
+        &mut self,
+        target: &ChannelControl,
+        dsp_clock: c_ulonglong,
+        volume: c_float,
+    ) -> &mut Self {
+        self.push(
+            target,
+            FMOD_CHANNELCONTROL_CMD_SETFADEPOINTRAMP,
+            FMOD_CHANNELCONTROL_CMD_DATA {
+                fadepoint: FMOD_CHANNELCONTROL_CMD_FADEPOINT {
+                    dspclock: dsp_clock,
+                    volume,
+                },
+            },
+        )
+    }
+
+    /// Records [`ChannelControl::remove_fade_points`].
+    pub fn remove_fade_points(
+        &mut self,
+        target: &ChannelControl,
+        dsp_clock_start: c_ulonglong,
+        dsp_clock_end: c_ulonglong,
+    ) -> &mut Self {
+        self.push(
+            target,
+            FMOD_CHANNELCONTROL_CMD_REMOVEFADEPOINTS,
+            FMOD_CHANNELCONTROL_CMD_DATA {
+                delay: FMOD_CHANNELCONTROL_CMD_DELAY {
+                    dspclock_start: dsp_clock_start,
+                    dspclock_end: dsp_clock_end,
+                    stopchannels: false,
+                },
+            },
+        )
+    }
+
+    /// Records [`ChannelControl::set_3d_attributes`].
+    pub fn set_3d_attributes(
+        &mut self,
+        target: &ChannelControl,
+        position: Option<Vector>,
+        velocity: Option<Vector>,
+    ) -> &mut Self {
+        self.push(
+            target,
+            FMOD_CHANNELCONTROL_CMD_SET3DATTRIBUTES,
+            FMOD_CHANNELCONTROL_CMD_DATA {
+                attributes: FMOD_CHANNELCONTROL_CMD_3DATTRIBUTES {
+                    pos: position.unwrap_or_default().into(),
+                    vel: velocity.unwrap_or_default().into(),
+                    setpos: position.is_some(),
+                    setvel: velocity.is_some(),
+                },
+            },
+        )
+    }
+
+    /// Records [`ChannelControl::set_3d_min_max_distance`].
+    pub fn set_3d_min_max_distance(
+        &mut self,
+        target: &ChannelControl,
+        min: c_float,
+        max: c_float,
+    ) -> &mut Self {
+        self.push(
+            target,
+            FMOD_CHANNELCONTROL_CMD_SET3DMINMAXDISTANCE,
+            FMOD_CHANNELCONTROL_CMD_DATA {
+                values: [min, max, 0.0],
+            },
+        )
+    }
+
+    /// Records [`ChannelControl::set_3d_cone_settings`].
+    pub fn set_3d_cone_settings(
+        &mut self,
+        target: &ChannelControl,
+        inside_angle: c_float,
+        outside_angle: c_float,
+        outside_volume: c_float,
+    ) -> &mut Self {
+        self.push(
+            target,
+            FMOD_CHANNELCONTROL_CMD_SET3DCONESETTINGS,
+            FMOD_CHANNELCONTROL_CMD_DATA {
+                values: [inside_angle, outside_angle, outside_volume],
+            },
+        )
+    }
+
+    /// Records [`ChannelControl::set_3d_occlusion`].
+    pub fn set_3d_occlusion(
+        &mut self,
+        target: &ChannelControl,
+        direct: c_float,
+        reverb: c_float,
+    ) -> &mut Self {
+        self.push(
+            target,
+            FMOD_CHANNELCONTROL_CMD_SET3DOCCLUSION,
+            FMOD_CHANNELCONTROL_CMD_DATA {
+                values: [direct, reverb, 0.0],
+            },
+        )
+    }
+
+    /// Records [`ChannelControl::set_3d_spread`].
+    pub fn set_3d_spread(&mut self, target: &ChannelControl, angle: c_float) -> &mut Self {
+        self.push(
+            target,
+            FMOD_CHANNELCONTROL_CMD_SET3DSPREAD,
+            FMOD_CHANNELCONTROL_CMD_DATA { value: angle },
+        )
+    }
+
+    /// Records [`ChannelControl::set_3d_level`].
+    pub fn set_3d_level(&mut self, target: &ChannelControl, level: c_float) -> &mut Self {
+        self.push(
+            target,
+            FMOD_CHANNELCONTROL_CMD_SET3DLEVEL,
+            FMOD_CHANNELCONTROL_CMD_DATA { value: level },
+        )
+    }
+
+    /// Records [`ChannelControl::set_3d_doppler_level`].
+    pub fn set_3d_doppler_level(&mut self, target: &ChannelControl, level: c_float) -> &mut Self {
+        self.push(
+            target,
+            FMOD_CHANNELCONTROL_CMD_SET3DDOPPLERLEVEL,
+            FMOD_CHANNELCONTROL_CMD_DATA { value: level },
+        )
+    }
+}
@@ -13,6 +13,7 @@ use std::{
 
 use crate::{Channel, ChannelControl, ChannelGroup};
 
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Hash)]
 pub enum ChannelControlType {
     Channel(Channel),
     ChannelGroup(ChannelGroup),
@@ -73,7 +74,19 @@ unsafe extern "C" fn callback_impl<C: ChannelControlCallback>(
     };
 
     match callback_type {
-        FMOD_CHANNELCONTROL_CALLBACK_END => C::end(channel_control).into(),
+        FMOD_CHANNELCONTROL_CALLBACK_END => {
+            #[cfg(feature = "userdata-abstraction")]
+            let control = *channel_control;
+            let result = C::end(channel_control);
+            // the channel is invalid after this callback, so there's no need to wait for a sweep to drop its userdata
+            #[cfg(feature = "userdata-abstraction")]
+            if let Ok(pointer) = control.get_raw_userdata() {
+                if !pointer.is_null() {
+                    crate::userdata::release_userdata(pointer.into(), control);
+                }
+            }
+            result.into()
+        }
         FMOD_CHANNELCONTROL_CALLBACK_VIRTUALVOICE => {
             let is_virtual = unsafe { *commanddata1.cast::<i32>() } != 0;
             C::virtual_voice(channel_control, is_virtual).into()
@@ -0,0 +1,333 @@
+// Copyright (c) 2024 Lily Lyons
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+use fmod_sys::*;
+use std::{
+    collections::HashMap,
+    ffi::{c_float, c_int, c_ulonglong},
+    time::{Duration, Instant},
+};
+
+use crate::{ChannelControl, ChannelControlBatch, ChannelGroup};
+
+/// Something a [`ClockScheduler`] does at a DSP clock time.
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub enum ScheduledAction {
+    /// Starts the target with [`ChannelControl::set_delay`] and unpauses it.
+    ///
+    /// The target should be created paused, so nothing plays before the start time.
+    Start,
+    /// Stops the target with [`ChannelControl::set_delay`], keeping the start time scheduled by an earlier [`ScheduledAction::Start`].
+    Stop { stop_channels: bool },
+    /// Fades linearly from `from` to `to` over `length` samples with two [`ChannelControl::add_fade_point`]s.
+    Fade {
+        from: c_float,
+        to: c_float,
+        length: c_ulonglong,
+    },
+    /// Ramps from the current volume to `volume` with [`ChannelControl::set_fade_point_ramp`].
+    Ramp { volume: c_float },
+}
+
+/// Identifies an action scheduled with [`ClockScheduler::schedule`], to cancel it before it is committed.
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Hash, PartialOrd, Ord)]
+pub struct ScheduleId(u64);
+
+/// What one [`ClockScheduler::update`] did.
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Default)]
+pub struct SchedulerUpdate {
+    /// The DSP clock read at the start of the update.
+    pub clock: c_ulonglong,
+    /// Actions handed to FMOD.
+    pub committed: usize,
+    /// Committed actions whose time had already passed. FMOD runs these as soon as possible,
+    /// so these are the transitions that were not sample accurate.
+    pub late: usize,
+    /// How far in the past the latest of the late actions was, in samples.
+    pub max_late: c_ulonglong,
+    /// Commands FMOD rejected because their target was released or stolen. The rest of the batch is still applied.
+    pub dropped: usize,
+    /// How many samples the clock moved more (or less) than the wall clock time since the last update predicts.
+    ///
+    /// This stays close to 0 while the mixer keeps up, and is 0 on the first update.
+    /// A steadily negative drift means the mixer is starving, a large positive one after a stall means the mixer caught up with a backlog.
+    pub drift: i64,
+}
+
+#[derive(Debug, Clone, Copy)]
+struct Pending {
+    id: ScheduleId,
+    time: c_ulonglong,
+    target: ChannelControl,
+    action: ScheduledAction,
+}
+
+/// Schedules starts, stops and fades on a shared DSP clock ahead of time, and hands them to FMOD in one batch when they come close.
+///
+/// Setting delays and fade points by hand from the game loop means reading the clock, and making every call, on a frame that may run late.
+/// The scheduler instead keeps a sorted queue of future actions, reads the clock once per [`ClockScheduler::update`],
+/// and commits every action inside the lookahead window with a single [`ChannelControlBatch`]. Once committed FMOD runs the action on the exact sample,
+/// so transitions stay sample accurate as long as updates are never further apart than the lookahead.
+///
+/// All times are in samples of the clock of `clock`, at the software mixer rate (see [`crate::System::get_software_format`]).
+/// Delays and fade points are relative to a target's parent clock, so every target must be a direct child of `clock`
+/// (either a [`ChannelGroup`] added to it, or a [`crate::Channel`] played on it).
+///
+/// ```ignore
+/// let mut scheduler = ClockScheduler::new(music_bus, sample_rate, sample_rate as u64 / 10);
+/// let bar = scheduler.samples(Duration::from_secs_f64(60.0 / bpm * 4.0));
+/// let at = scheduler.next_boundary(song_start, bar);
+/// scheduler.crossfade(&verse, &chorus, at, bar / 4);
+/// // every frame
+/// scheduler.update()?;
+/// ```
+pub struct ClockScheduler {
+    clock: ChannelGroup,
+    sample_rate: c_int,
+    lookahead: c_ulonglong,
+    // sorted by time, and by scheduling order for equal times
+    pending: Vec<Pending>,
+    starts: HashMap<ChannelControl, c_ulonglong>,
+    batch: ChannelControlBatch,
+    targets: Vec<ChannelControl>,
+    last_update: Option<(Instant, c_ulonglong)>,
+    next_id: u64,
+}
+
+impl ClockScheduler {
+    /// Creates a scheduler on the clock of `clock`, which runs at `sample_rate`, committing actions `lookahead` samples ahead.
+    ///
+    /// The lookahead should be longer than the longest frame the game expects, a few frames is a good start.
+    pub fn new(clock: ChannelGroup, sample_rate: c_int, lookahead: c_ulonglong) -> Self {
+        Self {
+            clock,
+            sample_rate,
+            lookahead,
+            pending: Vec::new(),
+            starts: HashMap::new(),
+            batch: ChannelControlBatch::new(),
+            targets: Vec::new(),
+            last_update: None,
+            next_id: 0,
+        }
+    }
+
+    pub fn clock_group(&self) -> ChannelGroup {
+        self.clock
+    }
+
+    pub fn sample_rate(&self) -> c_int {
+        self.sample_rate
+    }
+
+    pub fn lookahead(&self) -> c_ulonglong {
+        self.lookahead
+    }
+
+    pub fn set_lookahead(&mut self, lookahead: c_ulonglong) {
+        self.lookahead = lookahead;
+    }
+
+    /// Converts a duration to samples at the clock rate.
+    pub fn samples(&self, duration: Duration) -> c_ulonglong {
+        (duration.as_secs_f64() * f64::from(self.sample_rate)).round() as c_ulonglong
+    }
+
+    /// Number of actions waiting to be committed.
+    pub fn pending(&self) -> usize {
+        self.pending.len()
+    }
+
+    /// The clock read by the last [`ClockScheduler::update`], or 0 before the first one.
+    pub fn last_clock(&self) -> c_ulonglong {
+        self.last_update.map_or(0, |(_, clock)| clock)
+    }
+
+    /// The first time after the lookahead window of the last update that is a whole number of `interval`s after `origin`.
+    ///
+    /// Scheduling on this time is safe as long as updates are no further apart than the lookahead, which makes it the natural point for
+    /// beat or bar locked transitions: pass the start time of the song as `origin` and the length of a beat or bar as `interval`.
+    pub fn next_boundary(&self, origin: c_ulonglong, interval: c_ulonglong) -> c_ulonglong {
+        let earliest = self.last_clock().saturating_add(self.lookahead);
+        if interval == 0 || earliest < origin {
+            return origin.max(earliest);
+        }
+        let intervals = (earliest - origin) / interval + 1;
+        origin.saturating_add(intervals.saturating_mul(interval))
+    }
+
+    /// Schedules `action` on `target` at `time`.
+    ///
+    /// Actions at the same time are committed in the order they were scheduled.
+    pub fn schedule(
+        &mut self,
+        target: &ChannelControl,
+        time: c_ulonglong,
+        action: ScheduledAction,
+    ) -> ScheduleId {
+        let id = ScheduleId(self.next_id);
+        self.next_id += 1;
+        let index = self.pending.partition_point(|pending| pending.time <= time);
+        self.pending.insert(
+            index,
+            Pending {
+                id,
+                time,
+                target: *target,
+                action,
+            },
+        );
+        id
+    }
+
+    /// Schedules a start of `target` at `time`, see [`ScheduledAction::Start`].
+    pub fn start(&mut self, target: &ChannelControl, time: c_ulonglong) -> ScheduleId {
+        self.schedule(target, time, ScheduledAction::Start)
+    }
+
+    /// Schedules a stop of `target` at `time`, see [`ScheduledAction::Stop`].
+    pub fn stop(
+        &mut self,
+        target: &ChannelControl,
+        time: c_ulonglong,
+        stop_channels: bool,
+    ) -> ScheduleId {
+        self.schedule(target, time, ScheduledAction::Stop { stop_channels })
+    }
+
+    /// Schedules a linear fade of `target` at `time`, see [`ScheduledAction::Fade`].
+    pub fn fade(
+        &mut self,
+        target: &ChannelControl,
+        time: c_ulonglong,
+        from: c_float,
+        to: c_float,
+        length: c_ulonglong,
+    ) -> ScheduleId {
+        self.schedule(target, time, ScheduledAction::Fade { from, to, length })
+    }
+
+    /// Schedules an equal length crossfade at `time`: `to` starts and fades in while `from` fades out and stops at the end.
+    pub fn crossfade(
+        &mut self,
+        from: &ChannelControl,
+        to: &ChannelControl,
+        time: c_ulonglong,
+        length: c_ulonglong,
+    ) -> [ScheduleId; 4] {
+        [
+            self.start(to, time),
+            self.fade(to, time, 0.0, 1.0, length),
+            self.fade(from, time, 1.0, 0.0, length),
+            self.stop(from, time.saturating_add(length), false),
+        ]
+    }
+
+    /// Cancels an action that has not been committed yet, returning whether it was still pending.
+    pub fn cancel(&mut self, id: ScheduleId) -> bool {
+        let Some(index) = self.pending.iter().position(|pending| pending.id == id) else {
+            return false;
+        };
+        self.pending.remove(index);
+        true
+    }
+
+    /// Cancels every pending action on `target`, returning how many were cancelled.
+    ///
+    /// Actions that were already committed are owned by FMOD, see [`ChannelControl::remove_fade_points`] and [`ChannelControl::set_delay`].
+    pub fn cancel_target(&mut self, target: &ChannelControl) -> usize {
+        let before = self.pending.len();
+        self.pending.retain(|pending| pending.target != *target);
+        self.starts.remove(target);
+        before - self.pending.len()
+    }
+
+    /// Reads the clock and commits every action inside the lookahead window.
+    ///
+    /// Every due action is attempted even if some fail. Actions on released or stolen targets are dropped, and the first other error is returned.
+    pub fn update(&mut self) -> Result<SchedulerUpdate> {
+        let (clock, _) = self.clock.get_dsp_clock()?;
+        let now = Instant::now();
+
+        let mut update = SchedulerUpdate {
+            clock,
+            ..Default::default()
+        };
+        if let Some((instant, last_clock)) = self.last_update {
+            let expected = now.duration_since(instant).as_secs_f64() * f64::from(self.sample_rate);
+            update.drift = (clock.saturating_sub(last_clock) as f64 - expected).round() as i64;
+        }
+        self.last_update = Some((now, clock));
+
+        let window = clock.saturating_add(self.lookahead);
+        let due = self
+            .pending
+            .partition_point(|pending| pending.time <= window);
+        if due == 0 {
+            return Ok(update);
+        }
+
+        self.batch.clear();
+        self.targets.clear();
+        for pending in self.pending.drain(..due) {
+            if pending.time < clock {
+                update.late += 1;
+                update.max_late = update.max_late.max(clock - pending.time);
+            }
+            let target = &pending.target;
+            let commands = match pending.action {
+                ScheduledAction::Start => {
+                    self.starts.insert(pending.target, pending.time);
+                    self.batch
+                        .set_delay(target, pending.time, 0, false)
+                        .set_paused(target, false);
+                    2
+                }
+                ScheduledAction::Stop { stop_channels } => {
+                    let start = self.starts.remove(target).unwrap_or(0);
+                    self.batch
+                        .set_delay(target, start, pending.time, stop_channels);
+                    1
+                }
+                ScheduledAction::Fade { from, to, length } => {
+                    self.batch
+                        .add_fade_point(target, pending.time, from)
+                        .add_fade_point(target, pending.time.saturating_add(length), to);
+                    2
+                }
+                ScheduledAction::Ramp { volume } => {
+                    self.batch.set_fade_point_ramp(target, pending.time, volume);
+                    1
+                }
+            };
+            self.targets
+                .extend(std::iter::repeat(pending.target).take(commands));
+            update.committed += 1;
+        }
+
+        // the batch reports the first error itself, but released targets should not fail the whole update
+        let _ = self.batch.apply();
+        let mut first_error = FMOD_RESULT::FMOD_OK;
+        for (result, target) in self.batch.results().zip(&self.targets) {
+            match result {
+                Ok(()) => {}
+                Err(Error::Fmod(
+                    FMOD_RESULT::FMOD_ERR_INVALID_HANDLE | FMOD_RESULT::FMOD_ERR_CHANNEL_STOLEN,
+                )) => {
+                    update.dropped += 1;
+                    self.starts.remove(target);
+                }
+                Err(Error::Fmod(error)) => {
+                    if first_error == FMOD_RESULT::FMOD_OK {
+                        first_error = error;
+                    }
+                }
+                Err(_) => {}
+            }
+        }
+        first_error.to_result().map(|()| update)
+    }
+}
@@ -54,4 +54,17 @@ impl ChannelControl {
         let pointer = self.get_raw_userdata()?;
         Ok(get_userdata(pointer.into()))
     }
+
+    /// Runs `f` with a borrow of the userdata, without cloning the [`std::sync::Arc`].
+    ///
+    /// This never blocks, even while another thread is setting or removing userdata.
+    pub fn with_userdata<R>(
+        &self,
+        f: impl FnOnce(&crate::userdata::Userdata) -> R,
+    ) -> Result<Option<R>> {
+        use crate::userdata::with_userdata;
+
+        let pointer = self.get_raw_userdata()?;
+        Ok(with_userdata(pointer.into(), f))
+    }
 }
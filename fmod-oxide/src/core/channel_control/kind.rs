@@ -0,0 +1,274 @@
+// Copyright (c) 2024 Lily Lyons
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+use fmod_sys::*;
+use std::ffi::{c_float, c_int, c_ulonglong};
+
+use crate::{Channel, ChannelGroup, Vector};
+
+mod private {
+    pub trait Sealed {}
+    impl Sealed for crate::Channel {}
+    impl Sealed for crate::ChannelGroup {}
+}
+
+// Every entry is a ChannelControl function, and the native C function for Channels and ChannelGroups it maps to.
+// The C API uses FMOD_BOOL where the C++ shim uses bool.
+macro_rules! control_kind_table {
+    ($callback:ident!($($extra:tt)*)) => {
+        $callback! { $($extra)*
+            raw_is_playing(playing: *mut FMOD_BOOL) => FMOD_Channel_IsPlaying, FMOD_ChannelGroup_IsPlaying;
+            raw_stop() => FMOD_Channel_Stop, FMOD_ChannelGroup_Stop;
+            raw_set_paused(paused: FMOD_BOOL) => FMOD_Channel_SetPaused, FMOD_ChannelGroup_SetPaused;
+            raw_get_paused(paused: *mut FMOD_BOOL) => FMOD_Channel_GetPaused, FMOD_ChannelGroup_GetPaused;
+            raw_set_volume(volume: c_float) => FMOD_Channel_SetVolume, FMOD_ChannelGroup_SetVolume;
+            raw_get_volume(volume: *mut c_float) => FMOD_Channel_GetVolume, FMOD_ChannelGroup_GetVolume;
+            raw_set_volume_ramp(ramp: FMOD_BOOL) => FMOD_Channel_SetVolumeRamp, FMOD_ChannelGroup_SetVolumeRamp;
+            raw_get_audibility(audibility: *mut c_float) => FMOD_Channel_GetAudibility, FMOD_ChannelGroup_GetAudibility;
+            raw_set_mute(mute: FMOD_BOOL) => FMOD_Channel_SetMute, FMOD_ChannelGroup_SetMute;
+            raw_get_mute(mute: *mut FMOD_BOOL) => FMOD_Channel_GetMute, FMOD_ChannelGroup_GetMute;
+            raw_set_pitch(pitch: c_float) => FMOD_Channel_SetPitch, FMOD_ChannelGroup_SetPitch;
+            raw_get_pitch(pitch: *mut c_float) => FMOD_Channel_GetPitch, FMOD_ChannelGroup_GetPitch;
+            raw_set_pan(pan: c_float) => FMOD_Channel_SetPan, FMOD_ChannelGroup_SetPan;
+            raw_set_reverb_properties(instance: c_int, wet: c_float) => FMOD_Channel_SetReverbProperties, FMOD_ChannelGroup_SetReverbProperties;
+            raw_set_low_pass_gain(gain: c_float) => FMOD_Channel_SetLowPassGain, FMOD_ChannelGroup_SetLowPassGain;
+            raw_set_3d_attributes(position: *const FMOD_VECTOR, velocity: *const FMOD_VECTOR) => FMOD_Channel_Set3DAttributes, FMOD_ChannelGroup_Set3DAttributes;
+            raw_get_3d_attributes(position: *mut FMOD_VECTOR, velocity: *mut FMOD_VECTOR) => FMOD_Channel_Get3DAttributes, FMOD_ChannelGroup_Get3DAttributes;
+            raw_set_3d_min_max_distance(min: c_float, max: c_float) => FMOD_Channel_Set3DMinMaxDistance, FMOD_ChannelGroup_Set3DMinMaxDistance;
+            raw_set_3d_occlusion(direct: c_float, reverb: c_float) => FMOD_Channel_Set3DOcclusion, FMOD_ChannelGroup_Set3DOcclusion;
+            raw_set_3d_level(level: c_float) => FMOD_Channel_Set3DLevel, FMOD_ChannelGroup_Set3DLevel;
+            raw_set_3d_doppler_level(level: c_float) => FMOD_Channel_Set3DDopplerLevel, FMOD_ChannelGroup_Set3DDopplerLevel;
+            raw_get_dsp_clock(dsp_clock: *mut c_ulonglong, parent_clock: *mut c_ulonglong) => FMOD_Channel_GetDSPClock, FMOD_ChannelGroup_GetDSPClock;
+        }
+    };
+}
+
+macro_rules! control_kind_fns {
+    (@declare $($name:ident($($arg:ident: $ty:ty),*) => $channel:ident, $group:ident;)*) => {
+        $(
+            #[doc(hidden)]
+            /// # Safety
+            ///
+            /// `raw` must have been returned by FMOD, and every pointer must be valid for FMOD to read or write.
+            unsafe fn $name(raw: *mut Self::Raw, $($arg: $ty),*) -> FMOD_RESULT;
+        )*
+    };
+    (@channel $($name:ident($($arg:ident: $ty:ty),*) => $channel:ident, $group:ident;)*) => {
+        $(
+            #[inline]
+            unsafe fn $name(raw: *mut Self::Raw, $($arg: $ty),*) -> FMOD_RESULT {
+                unsafe { $channel(raw, $($arg),*) }
+            }
+        )*
+    };
+    (@group $($name:ident($($arg:ident: $ty:ty),*) => $channel:ident, $group:ident;)*) => {
+        $(
+            #[inline]
+            unsafe fn $name(raw: *mut Self::Raw, $($arg: $ty),*) -> FMOD_RESULT {
+                unsafe { $group(raw, $($arg),*) }
+            }
+        )*
+    };
+}
+
+/// Whether a [`crate::ChannelControl`] is statically known to be a [`Channel`] or a [`ChannelGroup`].
+///
+/// [`Channel`] and [`ChannelGroup`] have their own versions of the [`crate::ChannelControl`] functions that are called every frame
+/// (playback state, volume, pitch, panning, 3D attributes, etc).
+/// These are picked over the [`crate::ChannelControl`] versions by method resolution, and call `FMOD_Channel_*` and `FMOD_ChannelGroup_*` directly
+/// instead of going through the C++ `ChannelControl` shim in fmod-sys, so they skip a cross-language call and a virtual call.
+///
+/// The shim is still used when the kind is only known at runtime, like through [`crate::ChannelControlType`] or a `&ChannelControl`.
+///
+/// This trait is sealed, and only implemented by [`Channel`] and [`ChannelGroup`].
+pub trait ControlKind: private::Sealed + Copy {
+    #[doc(hidden)]
+    type Raw;
+
+    #[doc(hidden)]
+    fn raw(self) -> *mut Self::Raw;
+
+    control_kind_table!(control_kind_fns!(@declare));
+}
+
+impl ControlKind for Channel {
+    type Raw = FMOD_CHANNEL;
+
+    #[inline]
+    fn raw(self) -> *mut FMOD_CHANNEL {
+        self.inner
+    }
+
+    control_kind_table!(control_kind_fns!(@channel));
+}
+
+impl ControlKind for ChannelGroup {
+    type Raw = FMOD_CHANNELGROUP;
+
+    #[inline]
+    fn raw(self) -> *mut FMOD_CHANNELGROUP {
+        self.inner
+    }
+
+    control_kind_table!(control_kind_fns!(@group));
+}
+
+// The same signatures as the ChannelControl versions, so switching between them never changes calling code.
+macro_rules! direct_control_methods {
+    ($kind:ident) => {
+        impl $kind {
+            /// See [`crate::ChannelControl::is_playing`]. Calls FMOD directly, see [`ControlKind`].
+            pub fn is_playing(&self) -> Result<bool> {
+                let mut playing = FMOD_BOOL::FALSE;
+                unsafe { Self::raw_is_playing(self.raw(), &mut playing).to_result()? };
+                Ok(playing.into())
+            }
+
+            /// See [`crate::ChannelControl::stop`]. Calls FMOD directly, see [`ControlKind`].
+            pub fn stop(&self) -> Result<()> {
+                unsafe { Self::raw_stop(self.raw()).to_result() }
+            }
+
+            /// See [`crate::ChannelControl::set_paused`]. Calls FMOD directly, see [`ControlKind`].
+            pub fn set_paused(&self, paused: bool) -> Result<()> {
+                unsafe { Self::raw_set_paused(self.raw(), paused.into()).to_result() }
+            }
+
+            /// See [`crate::ChannelControl::get_paused`]. Calls FMOD directly, see [`ControlKind`].
+            pub fn get_paused(&self) -> Result<bool> {
+                let mut paused = FMOD_BOOL::FALSE;
+                unsafe { Self::raw_get_paused(self.raw(), &mut paused).to_result()? };
+                Ok(paused.into())
+            }
+
+            /// See [`crate::ChannelControl::set_volume`]. Calls FMOD directly, see [`ControlKind`].
+            pub fn set_volume(&self, volume: c_float) -> Result<()> {
+                unsafe { Self::raw_set_volume(self.raw(), volume).to_result() }
+            }
+
+            /// See [`crate::ChannelControl::get_volume`]. Calls FMOD directly, see [`ControlKind`].
+            pub fn get_volume(&self) -> Result<c_float> {
+                let mut volume = 0.0;
+                unsafe { Self::raw_get_volume(self.raw(), &mut volume).to_result()? };
+                Ok(volume)
+            }
+
+            /// See [`crate::ChannelControl::set_volume_ramp`]. Calls FMOD directly, see [`ControlKind`].
+            pub fn set_volume_ramp(&self, ramp: bool) -> Result<()> {
+                unsafe { Self::raw_set_volume_ramp(self.raw(), ramp.into()).to_result() }
+            }
+
+            /// See [`crate::ChannelControl::get_audibility`]. Calls FMOD directly, see [`ControlKind`].
+            pub fn get_audibility(&self) -> Result<c_float> {
+                let mut audibility = 0.0;
+                unsafe { Self::raw_get_audibility(self.raw(), &mut audibility).to_result()? };
+                Ok(audibility)
+            }
+
+            /// See [`crate::ChannelControl::set_mute`]. Calls FMOD directly, see [`ControlKind`].
+            pub fn set_mute(&self, mute: bool) -> Result<()> {
+                unsafe { Self::raw_set_mute(self.raw(), mute.into()).to_result() }
+            }
+
+            /// See [`crate::ChannelControl::get_mute`]. Calls FMOD directly, see [`ControlKind`].
+            pub fn get_mute(&self) -> Result<bool> {
+                let mut mute = FMOD_BOOL::FALSE;
+                unsafe { Self::raw_get_mute(self.raw(), &mut mute).to_result()? };
+                Ok(mute.into())
+            }
+
+            /// See [`crate::ChannelControl::set_pitch`]. Calls FMOD directly, see [`ControlKind`].
+            pub fn set_pitch(&self, pitch: c_float) -> Result<()> {
+                unsafe { Self::raw_set_pitch(self.raw(), pitch).to_result() }
+            }
+
+            /// See [`crate::ChannelControl::get_pitch`]. Calls FMOD directly, see [`ControlKind`].
+            pub fn get_pitch(&self) -> Result<c_float> {
+                let mut pitch = 0.0;
+                unsafe { Self::raw_get_pitch(self.raw(), &mut pitch).to_result()? };
+                Ok(pitch)
+            }
+
+            /// See [`crate::ChannelControl::set_pan`]. Calls FMOD directly, see [`ControlKind`].
+            pub fn set_pan(&self, pan: c_float) -> Result<()> {
+                unsafe { Self::raw_set_pan(self.raw(), pan).to_result() }
+            }
+
+            /// See [`crate::ChannelControl::set_reverb_properties`]. Calls FMOD directly, see [`ControlKind`].
+            pub fn set_reverb_properties(&self, instance: c_int, wet: c_float) -> Result<()> {
+                unsafe { Self::raw_set_reverb_properties(self.raw(), instance, wet).to_result() }
+            }
+
+            /// See [`crate::ChannelControl::set_low_pass_gain`]. Calls FMOD directly, see [`ControlKind`].
+            pub fn set_low_pass_gain(&self, gain: c_float) -> Result<()> {
+                unsafe { Self::raw_set_low_pass_gain(self.raw(), gain).to_result() }
+            }
+
+            /// See [`crate::ChannelControl::set_3d_attributes`]. Calls FMOD directly, see [`ControlKind`].
+            pub fn set_3d_attributes(
+                &self,
+                position: Option<Vector>,
+                velocity: Option<Vector>,
+            ) -> Result<()> {
+                // vector is layout compatible with FMOD_VECTOR
+                let position = position
+                    .as_ref()
+                    .map_or(std::ptr::null(), std::ptr::from_ref)
+                    .cast();
+                let velocity = velocity
+                    .as_ref()
+                    .map_or(std::ptr::null(), std::ptr::from_ref)
+                    .cast();
+                unsafe { Self::raw_set_3d_attributes(self.raw(), position, velocity).to_result() }
+            }
+
+            /// See [`crate::ChannelControl::get_3d_attributes`]. Calls FMOD directly, see [`ControlKind`].
+            pub fn get_3d_attributes(&self) -> Result<(Vector, Vector)> {
+                let mut position = FMOD_VECTOR::default();
+                let mut velocity = FMOD_VECTOR::default();
+                unsafe {
+                    Self::raw_get_3d_attributes(self.raw(), &mut position, &mut velocity)
+                        .to_result()?;
+                }
+                Ok((position.into(), velocity.into()))
+            }
+
+            /// See [`crate::ChannelControl::set_3d_min_max_distance`]. Calls FMOD directly, see [`ControlKind`].
+            pub fn set_3d_min_max_distance(&self, min: c_float, max: c_float) -> Result<()> {
+                unsafe { Self::raw_set_3d_min_max_distance(self.raw(), min, max).to_result() }
+            }
+
+            /// See [`crate::ChannelControl::set_3d_occlusion`]. Calls FMOD directly, see [`ControlKind`].
+            pub fn set_3d_occlusion(&self, direct: c_float, reverb: c_float) -> Result<()> {
+                unsafe { Self::raw_set_3d_occlusion(self.raw(), direct, reverb).to_result() }
+            }
+
+            /// See [`crate::ChannelControl::set_3d_level`]. Calls FMOD directly, see [`ControlKind`].
+            pub fn set_3d_level(&self, level: c_float) -> Result<()> {
+                unsafe { Self::raw_set_3d_level(self.raw(), level).to_result() }
+            }
+
+            /// See [`crate::ChannelControl::set_3d_doppler_level`]. Calls FMOD directly, see [`ControlKind`].
+            pub fn set_3d_doppler_level(&self, level: c_float) -> Result<()> {
+                unsafe { Self::raw_set_3d_doppler_level(self.raw(), level).to_result() }
+            }
+
+            /// See [`crate::ChannelControl::get_dsp_clock`]. Calls FMOD directly, see [`ControlKind`].
+            pub fn get_dsp_clock(&self) -> Result<(c_ulonglong, c_ulonglong)> {
+                let mut dsp_clock = 0;
+                let mut parent_clock = 0;
+                unsafe {
+                    Self::raw_get_dsp_clock(self.raw(), &mut dsp_clock, &mut parent_clock)
+                        .to_result()?;
+                }
+                Ok((dsp_clock, parent_clock))
+            }
+        }
+    };
+}
+
+direct_control_methods!(Channel);
+direct_control_methods!(ChannelGroup);
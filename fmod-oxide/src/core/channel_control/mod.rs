@@ -6,20 +6,29 @@
 
 use fmod_sys::*;
 
+mod batch;
 mod callback;
+mod clock_scheduler;
 mod dsp;
 mod filtering;
 mod general;
+mod kind;
 mod panning;
 mod playback;
 mod scheduling;
+mod snapshot;
 mod spatialization;
 mod volume;
+pub use batch::ChannelControlBatch;
 pub use callback::{ChannelControlCallback, ChannelControlType};
+pub use clock_scheduler::{ClockScheduler, ScheduleId, ScheduledAction, SchedulerUpdate};
+pub use kind::ControlKind;
+pub use snapshot::ChannelSnapshot;
 
 // FMOD's C API provides two versions of functions for channels: one that takes a `*mut FMOD_CHANNEL` and one that takes a `*mut FMOD_CHANNELGROUP`.
 // The C++ API provides a base class `ChannelControl` that `Channel` and `ChannelGroup` inherits from.
 // Seeing as we can cast from FMOD_CHANNELCONTROL to Channel* (in c++) we should be able to cast from FMOD_CHANNEL(GROUP) to FMOD_CHANNELCONTROL.
+// Hot functions on Channel and ChannelGroup skip this and call the C API directly, see ControlKind.
 #[derive(Debug, Clone, Copy, PartialEq, Eq, Hash)]
 #[repr(transparent)] // so we can transmute between types
 pub struct ChannelControl {
@@ -0,0 +1,170 @@
+// Copyright (c) 2024 Lily Lyons
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+use fmod_sys::*;
+use std::ffi::{c_float, c_int, c_ulonglong};
+
+use crate::ChannelControl;
+
+/// Struct-of-arrays state for a list of [`ChannelControl`]s, filled by [`ChannelControl::snapshot_many`].
+///
+/// Entry `i` of every array corresponds to the `i`th [`ChannelControl`] passed to [`ChannelControl::snapshot_many`].
+/// The buffers are reused between calls, so polling the same number of handles every frame does not allocate.
+#[derive(Debug, Default, Clone)]
+pub struct ChannelSnapshot {
+    volume: Vec<c_float>,
+    pitch: Vec<c_float>,
+    audibility: Vec<c_float>,
+    dsp_clock: Vec<c_ulonglong>,
+    parent_clock: Vec<c_ulonglong>,
+    playing: Vec<u64>,
+    paused: Vec<u64>,
+    muted: Vec<u64>,
+    results: Vec<FMOD_RESULT>,
+}
+
+impl ChannelSnapshot {
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    pub fn with_capacity(capacity: usize) -> Self {
+        let words = capacity.div_ceil(64);
+        Self {
+            volume: Vec::with_capacity(capacity),
+            pitch: Vec::with_capacity(capacity),
+            audibility: Vec::with_capacity(capacity),
+            dsp_clock: Vec::with_capacity(capacity),
+            parent_clock: Vec::with_capacity(capacity),
+            playing: Vec::with_capacity(words),
+            paused: Vec::with_capacity(words),
+            muted: Vec::with_capacity(words),
+            results: Vec::with_capacity(capacity),
+        }
+    }
+
+    /// Returns the number of entries from the last snapshot.
+    pub fn len(&self) -> usize {
+        self.results.len()
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.results.is_empty()
+    }
+
+    fn resize(&mut self, len: usize) {
+        let words = len.div_ceil(64);
+        self.volume.resize(len, 0.0);
+        self.pitch.resize(len, 0.0);
+        self.audibility.resize(len, 0.0);
+        self.dsp_clock.resize(len, 0);
+        self.parent_clock.resize(len, 0);
+        self.playing.resize(words, 0);
+        self.paused.resize(words, 0);
+        self.muted.resize(words, 0);
+        self.results.resize(len, FMOD_RESULT::FMOD_OK);
+    }
+
+    /// See [`ChannelControl::get_volume`].
+    pub fn volume(&self) -> &[c_float] {
+        &self.volume
+    }
+
+    /// See [`ChannelControl::get_pitch`].
+    pub fn pitch(&self) -> &[c_float] {
+        &self.pitch
+    }
+
+    /// See [`ChannelControl::get_audibility`].
+    pub fn audibility(&self) -> &[c_float] {
+        &self.audibility
+    }
+
+    /// The DSP clock of each entry, see [`ChannelControl::get_dsp_clock`].
+    pub fn dsp_clock(&self) -> &[c_ulonglong] {
+        &self.dsp_clock
+    }
+
+    /// The parent DSP clock of each entry, see [`ChannelControl::get_dsp_clock`].
+    pub fn parent_clock(&self) -> &[c_ulonglong] {
+        &self.parent_clock
+    }
+
+    /// The playing state as a bitset, where bit `i % 64` of word `i / 64` is entry `i`.
+    pub fn playing_bits(&self) -> &[u64] {
+        &self.playing
+    }
+
+    /// The paused state as a bitset, where bit `i % 64` of word `i / 64` is entry `i`.
+    pub fn paused_bits(&self) -> &[u64] {
+        &self.paused
+    }
+
+    /// The mute state as a bitset, where bit `i % 64` of word `i / 64` is entry `i`.
+    pub fn muted_bits(&self) -> &[u64] {
+        &self.muted
+    }
+
+    /// See [`ChannelControl::is_playing`].
+    pub fn is_playing(&self, index: usize) -> bool {
+        get_bit(&self.playing, index)
+    }
+
+    /// See [`ChannelControl::get_paused`].
+    pub fn is_paused(&self, index: usize) -> bool {
+        get_bit(&self.paused, index)
+    }
+
+    /// See [`ChannelControl::get_mute`].
+    pub fn is_muted(&self, index: usize) -> bool {
+        get_bit(&self.muted, index)
+    }
+
+    /// Retrieves whether the queries for an entry succeeded.
+    ///
+    /// If they did not, every value for that entry is zeroed.
+    pub fn result(&self, index: usize) -> Result<()> {
+        self.results[index].to_result()
+    }
+}
+
+fn get_bit(bits: &[u64], index: usize) -> bool {
+    bits[index / 64] & (1 << (index % 64)) != 0
+}
+
+impl ChannelControl {
+    /// Queries the volume, pitch, audibility, DSP clocks, and playing/paused/mute state of many [`ChannelControl`]s with a single FFI call.
+    ///
+    /// Entries that could not be queried (for example because the [`crate::Channel`] was stolen) are zeroed,
+    /// and their error can be retrieved with [`ChannelSnapshot::result`].
+    /// The first such error is also returned from this function, after every entry has been queried.
+    pub fn snapshot_many(
+        controls: &[ChannelControl],
+        snapshot: &mut ChannelSnapshot,
+    ) -> Result<()> {
+        snapshot.resize(controls.len());
+        let buffers = FMOD_CHANNELCONTROL_SNAPSHOT {
+            volume: snapshot.volume.as_mut_ptr(),
+            pitch: snapshot.pitch.as_mut_ptr(),
+            audibility: snapshot.audibility.as_mut_ptr(),
+            dspclock: snapshot.dsp_clock.as_mut_ptr(),
+            parentclock: snapshot.parent_clock.as_mut_ptr(),
+            playing: snapshot.playing.as_mut_ptr(),
+            paused: snapshot.paused.as_mut_ptr(),
+            muted: snapshot.muted.as_mut_ptr(),
+            results: snapshot.results.as_mut_ptr(),
+        };
+        unsafe {
+            FMOD_ChannelControl_SnapshotMany(
+                // ChannelControl is repr transparent and has the same layout as *mut FMOD_CHANNELCONTROL, so this cast is ok
+                controls.as_ptr().cast(),
+                controls.len() as c_int,
+                &buffers,
+            )
+            .to_result()
+        }
+    }
+}
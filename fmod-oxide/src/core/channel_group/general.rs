@@ -8,7 +8,7 @@ use fmod_sys::*;
 use lanyard::Utf8CString;
 use std::ffi::c_int;
 
-use crate::{get_string, ChannelGroup};
+use crate::{get_string, get_string_into, ChannelGroup};
 
 impl ChannelGroup {
     /// Retrieves the name set when the group was created.
@@ -20,6 +20,17 @@ impl ChannelGroup {
         }
     }
 
+    /// Like [`ChannelGroup::get_name`], but writes the name into `name`, reusing its allocation.
+    pub fn get_name_into(&self, name: &mut String) -> Result<()> {
+        get_string_into(name, |buffer| unsafe {
+            FMOD_ChannelGroup_GetName(
+                self.inner,
+                buffer.as_mut_ptr().cast(),
+                buffer.len() as c_int,
+            )
+        })
+    }
+
     /// Frees the memory for the group.
     ///
     /// Any [`Channel`]s or [`ChannelGroup`]s feeding into this group are moved to the master [`ChannelGroup`].
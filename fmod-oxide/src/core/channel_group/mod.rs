@@ -12,6 +12,8 @@ use crate::ChannelControl;
 mod channel_management;
 mod general;
 mod group_management;
+mod subtree;
+pub use subtree::SubtreeOp;
 
 #[derive(Debug, Clone, Copy, PartialEq, Eq, Hash)]
 #[repr(transparent)] // so we can transmute between types
@@ -0,0 +1,137 @@
+// Copyright (c) 2024 Lily Lyons
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+use fmod_sys::*;
+use std::ffi::{c_float, c_int};
+
+use crate::{ChannelControl, ChannelGroup, SubtreeTargets};
+
+/// An operation [`ChannelGroup::for_each_descendant_batch`] applies to every node it visits.
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub enum SubtreeOp {
+    /// [`ChannelControl::stop`].
+    Stop,
+    /// [`ChannelControl::set_paused`].
+    SetPaused(bool),
+    /// [`ChannelControl::set_mute`].
+    SetMute(bool),
+    /// [`ChannelControl::set_volume`].
+    SetVolume(c_float),
+    /// [`ChannelControl::set_volume`] to the current volume multiplied by this.
+    ScaleVolume(c_float),
+}
+
+impl SubtreeOp {
+    fn command(self) -> FMOD_CHANNELCONTROL_CMD {
+        let (kind, data) = match self {
+            SubtreeOp::Stop => (
+                FMOD_CHANNELCONTROL_CMD_STOP,
+                FMOD_CHANNELCONTROL_CMD_DATA::default(),
+            ),
+            SubtreeOp::SetPaused(paused) => (
+                FMOD_CHANNELCONTROL_CMD_SETPAUSED,
+                FMOD_CHANNELCONTROL_CMD_DATA { boolean: paused },
+            ),
+            SubtreeOp::SetMute(mute) => (
+                FMOD_CHANNELCONTROL_CMD_SETMUTE,
+                FMOD_CHANNELCONTROL_CMD_DATA { boolean: mute },
+            ),
+            SubtreeOp::SetVolume(volume) => (
+                FMOD_CHANNELCONTROL_CMD_SETVOLUME,
+                FMOD_CHANNELCONTROL_CMD_DATA { value: volume },
+            ),
+            SubtreeOp::ScaleVolume(scale) => (
+                FMOD_CHANNELCONTROL_CMD_SCALEVOLUME,
+                FMOD_CHANNELCONTROL_CMD_DATA { value: scale },
+            ),
+        };
+        // the shim fills in the target for every node it visits
+        FMOD_CHANNELCONTROL_CMD {
+            channelcontrol: std::ptr::null_mut(),
+            type_: kind,
+            data,
+        }
+    }
+}
+
+impl ChannelGroup {
+    /// Applies `op` to every node of this group's hierarchy selected by `targets`, walking it on the C++ side with a single FFI call.
+    ///
+    /// A group is visited before the groups and Channels below it.
+    /// Every visited node gets `op` even if it failed on an earlier one, and the first error encountered is returned.
+    /// Channels stopped by [`SubtreeOp::Stop`] on their group are gone by the time the walk reaches them, so they are not visited.
+    ///
+    /// Volumes multiply down the hierarchy, so [`SubtreeOp::ScaleVolume`] on several levels compounds: a Channel is scaled once for every
+    /// visited node on its path, e.g. `scale.powi(4)` for a Channel two groups below the root with every level targeted.
+    /// Target one level to scale everything once.
+    ///
+    /// Returns the number of nodes visited.
+    ///
+    /// ```ignore
+    /// // pause everything on the sfx bus
+    /// sfx.for_each_descendant_batch(SubtreeTargets::all(), SubtreeOp::SetPaused(true))?;
+    /// // halve the volume of every voice on it, without touching the mix of the groups in between
+    /// sfx.for_each_descendant_batch(SubtreeTargets::CHANNELS, SubtreeOp::ScaleVolume(0.5))?;
+    /// ```
+    pub fn for_each_descendant_batch(
+        &self,
+        targets: SubtreeTargets,
+        op: SubtreeOp,
+    ) -> Result<c_int> {
+        let command = op.command();
+        let mut count = 0;
+        unsafe {
+            FMOD_ChannelGroup_ApplySubtree(
+                self.inner,
+                targets.into(),
+                &command,
+                std::ptr::null_mut(),
+                std::ptr::null_mut(),
+                0,
+                &mut count,
+                std::ptr::null_mut(),
+            )
+            .to_result()?;
+        }
+        Ok(count)
+    }
+
+    /// Collects the nodes of this group's hierarchy selected by `targets` into `handles`, in the order
+    /// [`ChannelGroup::for_each_descendant_batch`] visits them.
+    ///
+    /// `handles` is cleared first. The walk writes straight into its spare capacity, so reusing the same `Vec` every frame doesn't allocate
+    /// once it has grown large enough. If the hierarchy doesn't fit, `handles` grows and the walk runs again.
+    pub fn collect_descendants(
+        &self,
+        targets: SubtreeTargets,
+        handles: &mut Vec<ChannelControl>,
+    ) -> Result<()> {
+        handles.clear();
+        loop {
+            let capacity = handles.capacity().min(c_int::MAX as usize) as c_int;
+            let mut count = 0;
+            unsafe {
+                // ChannelControl is repr(transparent), so the shim can write the raw handles directly
+                FMOD_ChannelGroup_ApplySubtree(
+                    self.inner,
+                    targets.into(),
+                    std::ptr::null(),
+                    handles.as_mut_ptr().cast(),
+                    std::ptr::null_mut(),
+                    capacity,
+                    &mut count,
+                    std::ptr::null_mut(),
+                )
+                .to_result()?;
+                if count <= capacity {
+                    handles.set_len(count as usize);
+                    return Ok(());
+                }
+            }
+            handles.reserve(count as usize);
+        }
+    }
+}
@@ -0,0 +1,245 @@
+// Copyright (c) 2024 Lily Lyons
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+use fmod_sys::*;
+use std::ffi::{c_float, c_int, c_short};
+
+use crate::{dsp_kernels, Dsp};
+
+/// Which side of a [`Dsp`] a [`MeterCollector`] meters.
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Hash)]
+pub enum MeterSide {
+    /// Pre processing.
+    Input,
+    /// Post processing.
+    Output,
+}
+
+/// Reads the metering info of many [`Dsp`]s in one pass, into struct-of-arrays buffers.
+///
+/// Every DSP gets `stride` channels worth of entries in [`MeterCollector::peaks`] and [`MeterCollector::rms_levels`],
+/// so entry `i * stride + channel` belongs to channel `channel` of the `i`th DSP.
+/// Channels past a DSP's channel count (and those of DSPs that failed to be read) are zero, so whole-buffer reductions need no masking.
+///
+/// [`MeterCollector::collect`] reads straight into these buffers without converting to [`crate::DspMeteringInfo`], and never allocates.
+#[derive(Debug, Clone)]
+pub struct MeterCollector {
+    side: MeterSide,
+    stride: usize,
+    dsps: Vec<Dsp>,
+    peak: Vec<c_float>,
+    rms: Vec<c_float>,
+    channel_counts: Vec<c_short>,
+    sample_counts: Vec<c_int>,
+    results: Vec<FMOD_RESULT>,
+}
+
+impl MeterCollector {
+    /// Creates a collector storing up to `stride` channels per DSP, up to [`crate::MAX_CHANNEL_WIDTH`].
+    pub fn new(side: MeterSide, stride: usize) -> Self {
+        Self {
+            side,
+            stride: stride.clamp(1, crate::MAX_CHANNEL_WIDTH as usize),
+            dsps: Vec::new(),
+            peak: Vec::new(),
+            rms: Vec::new(),
+            channel_counts: Vec::new(),
+            sample_counts: Vec::new(),
+            results: Vec::new(),
+        }
+    }
+
+    pub fn side(&self) -> MeterSide {
+        self.side
+    }
+
+    pub fn stride(&self) -> usize {
+        self.stride
+    }
+
+    pub fn len(&self) -> usize {
+        self.dsps.len()
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.dsps.is_empty()
+    }
+
+    pub fn dsps(&self) -> &[Dsp] {
+        &self.dsps
+    }
+
+    /// Enables metering on `dsp` for the collector's [`MeterSide`], and adds it to the collector.
+    ///
+    /// Metering on the other side is left as it was. Returns the index of the DSP.
+    pub fn add(&mut self, dsp: Dsp) -> Result<usize> {
+        if let Some(index) = self.dsps.iter().position(|d| *d == dsp) {
+            return Ok(index);
+        }
+        let (input, output) = dsp.get_metering_enabled()?;
+        match self.side {
+            MeterSide::Input if !input => dsp.set_metering_enabled(true, output)?,
+            MeterSide::Output if !output => dsp.set_metering_enabled(input, true)?,
+            _ => {}
+        }
+        self.dsps.push(dsp);
+        self.resize();
+        Ok(self.dsps.len() - 1)
+    }
+
+    /// Adds `root` and every DSP feeding into it, see [`MeterCollector::add`].
+    ///
+    /// Walking the graph flushes the DSP queue, so do this once when the graph changes rather than every frame.
+    pub fn add_graph(&mut self, root: Dsp) -> Result<()> {
+        let mut pending = vec![root];
+        while let Some(dsp) = pending.pop() {
+            if self.dsps.contains(&dsp) {
+                continue;
+            }
+            self.add(dsp)?;
+            for index in 0..dsp.get_input_count()? {
+                pending.push(dsp.get_input(index)?.0);
+            }
+        }
+        Ok(())
+    }
+
+    /// Removes `dsp` from the collector, and disables metering for the collector's [`MeterSide`] if `disable_metering` is true.
+    ///
+    /// The last DSP takes the index of the removed one.
+    pub fn remove(&mut self, dsp: Dsp, disable_metering: bool) -> Result<()> {
+        let Some(index) = self.dsps.iter().position(|d| *d == dsp) else {
+            return Ok(());
+        };
+        // the meters of the last DSP move along with it
+        let last = self.dsps.len() - 1;
+        let (from, to) = (last * self.stride, index * self.stride);
+        self.peak.copy_within(from..from + self.stride, to);
+        self.rms.copy_within(from..from + self.stride, to);
+        self.dsps.swap_remove(index);
+        self.channel_counts.swap_remove(index);
+        self.sample_counts.swap_remove(index);
+        self.results.swap_remove(index);
+        self.resize();
+        if disable_metering {
+            let (input, output) = dsp.get_metering_enabled()?;
+            match self.side {
+                MeterSide::Input => dsp.set_metering_enabled(false, output)?,
+                MeterSide::Output => dsp.set_metering_enabled(input, false)?,
+            }
+        }
+        Ok(())
+    }
+
+    pub fn clear(&mut self) {
+        self.dsps.clear();
+        self.resize();
+    }
+
+    fn resize(&mut self) {
+        let len = self.dsps.len();
+        self.peak.resize(len * self.stride, 0.0);
+        self.rms.resize(len * self.stride, 0.0);
+        self.channel_counts.resize(len, 0);
+        self.sample_counts.resize(len, 0);
+        self.results.resize(len, FMOD_RESULT::FMOD_OK);
+    }
+
+    /// Reads the metering info of every DSP.
+    ///
+    /// DSPs that could not be read are zeroed, and their error can be retrieved with [`MeterCollector::result`].
+    /// The first such error is also returned from this function, after every DSP has been read.
+    pub fn collect(&mut self) -> Result<()> {
+        let mut info = FMOD_DSP_METERING_INFO::default();
+        let mut first_error = FMOD_RESULT::FMOD_OK;
+        for (i, dsp) in self.dsps.iter().enumerate() {
+            let (input, output) = match self.side {
+                MeterSide::Input => (std::ptr::from_mut(&mut info), std::ptr::null_mut()),
+                MeterSide::Output => (std::ptr::null_mut(), std::ptr::from_mut(&mut info)),
+            };
+            let result = unsafe { FMOD_DSP_GetMeteringInfo(dsp.inner, input, output) };
+
+            let peak = &mut self.peak[i * self.stride..(i + 1) * self.stride];
+            let rms = &mut self.rms[i * self.stride..(i + 1) * self.stride];
+            if result == FMOD_RESULT::FMOD_OK {
+                let channels = (info.numchannels.max(0) as usize).min(self.stride);
+                peak[..channels].copy_from_slice(&info.peaklevel[..channels]);
+                peak[channels..].fill(0.0);
+                rms[..channels].copy_from_slice(&info.rmslevel[..channels]);
+                rms[channels..].fill(0.0);
+                self.channel_counts[i] = channels as c_short;
+                self.sample_counts[i] = info.numsamples;
+            } else {
+                peak.fill(0.0);
+                rms.fill(0.0);
+                self.channel_counts[i] = 0;
+                self.sample_counts[i] = 0;
+                if first_error == FMOD_RESULT::FMOD_OK {
+                    first_error = result;
+                }
+            }
+            self.results[i] = result;
+        }
+        first_error.to_result()
+    }
+
+    /// Peak levels of every DSP, `stride` entries per DSP.
+    pub fn peaks(&self) -> &[c_float] {
+        &self.peak
+    }
+
+    /// RMS levels of every DSP, `stride` entries per DSP.
+    pub fn rms_levels(&self) -> &[c_float] {
+        &self.rms
+    }
+
+    /// Peak level of each channel of the `index`th DSP.
+    pub fn peak(&self, index: usize) -> &[c_float] {
+        let start = index * self.stride;
+        &self.peak[start..start + self.channel_counts[index] as usize]
+    }
+
+    /// RMS level of each channel of the `index`th DSP.
+    pub fn rms(&self, index: usize) -> &[c_float] {
+        let start = index * self.stride;
+        &self.rms[start..start + self.channel_counts[index] as usize]
+    }
+
+    pub fn channel_count(&self, index: usize) -> c_short {
+        self.channel_counts[index]
+    }
+
+    /// Number of samples the `index`th DSP's levels were measured over.
+    pub fn sample_count(&self, index: usize) -> c_int {
+        self.sample_counts[index]
+    }
+
+    /// Retrieves whether reading the `index`th DSP succeeded.
+    pub fn result(&self, index: usize) -> Result<()> {
+        self.results[index].to_result()
+    }
+
+    /// The highest peak level of any channel of any DSP in `range`, using [`dsp_kernels::peak`].
+    pub fn combined_peak(&self, range: std::ops::Range<usize>) -> c_float {
+        dsp_kernels::peak(&self.peak[range.start * self.stride..range.end * self.stride])
+    }
+
+    /// The combined RMS level of every channel of every DSP in `range`, using [`dsp_kernels::sum_squares`].
+    ///
+    /// This is the RMS of the power of all channels, which is how loudness adds up on a bus.
+    pub fn combined_rms(&self, range: std::ops::Range<usize>) -> c_float {
+        let channels: usize = self.channel_counts[range.clone()]
+            .iter()
+            .map(|c| *c as usize)
+            .sum();
+        if channels == 0 {
+            return 0.0;
+        }
+        let power =
+            dsp_kernels::sum_squares(&self.rms[range.start * self.stride..range.end * self.stride]);
+        (power / channels as c_float).sqrt()
+    }
+}
@@ -15,6 +15,8 @@ impl Dsp {
     /// Requesting metering information when it hasn't been enabled will result in [`FMOD_RESULT::FMOD_ERR_BADCOMMAND`].
     ///
     /// FMOD_INIT_PROFILE_METER_ALL with System::init will automatically enable metering for all [`Dsp`] units.
+    ///
+    /// To read many [`Dsp`]s every frame, see [`crate::MeterCollector`].
     pub fn get_metering_info(&self) -> Result<(DspMeteringInfo, DspMeteringInfo)> {
         let mut input = MaybeUninit::zeroed();
         let mut output = MaybeUninit::zeroed();
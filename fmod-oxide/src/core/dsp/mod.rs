@@ -9,9 +9,11 @@ use fmod_sys::*;
 mod channel_format;
 mod connections;
 mod general;
+mod meter_collector;
 mod metering;
 mod parameters;
 mod processing;
+pub use meter_collector::{MeterCollector, MeterSide};
 
 #[derive(Debug, Clone, Copy, PartialEq, Eq, Hash)]
 #[repr(transparent)] // so we can transmute between types
@@ -0,0 +1,724 @@
+// Copyright (c) 2024 Lily Lyons
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+//! Vectorized building blocks for [`crate::DspPlugin::process`].
+//!
+//! Every kernel picks the widest instruction set the CPU supports the first time it is called:
+//! AVX2 or SSE2 on x86_64, NEON on aarch64, and a scalar loop everywhere else.
+//! Results are identical up to floating point rounding between instruction sets.
+
+use std::sync::atomic::{AtomicU8, Ordering};
+
+/// The instruction set used by the kernels in this module.
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Hash)]
+pub enum SimdLevel {
+    Scalar,
+    Sse2,
+    Avx2,
+    Neon,
+}
+
+static SIMD_LEVEL: AtomicU8 = AtomicU8::new(u8::MAX);
+
+/// Retrieves the instruction set the kernels use on this CPU.
+pub fn simd_level() -> SimdLevel {
+    match SIMD_LEVEL.load(Ordering::Relaxed) {
+        0 => SimdLevel::Scalar,
+        1 => SimdLevel::Sse2,
+        2 => SimdLevel::Avx2,
+        3 => SimdLevel::Neon,
+        _ => {
+            let level = detect_simd_level();
+            SIMD_LEVEL.store(level as u8, Ordering::Relaxed);
+            level
+        }
+    }
+}
+
+fn detect_simd_level() -> SimdLevel {
+    #[cfg(target_arch = "x86_64")]
+    {
+        if std::arch::is_x86_feature_detected!("avx2") {
+            SimdLevel::Avx2
+        } else {
+            SimdLevel::Sse2
+        }
+    }
+    #[cfg(target_arch = "aarch64")]
+    {
+        SimdLevel::Neon
+    }
+    #[cfg(not(any(target_arch = "x86_64", target_arch = "aarch64")))]
+    {
+        SimdLevel::Scalar
+    }
+}
+
+/// Writes `input * gain` to `output`.
+///
+/// # Panics
+///
+/// Panics if `input` and `output` have different lengths.
+pub fn gain(input: &[f32], output: &mut [f32], gain: f32) {
+    assert_eq!(input.len(), output.len(), "buffers must be the same length");
+    let done = match simd_level() {
+        #[cfg(target_arch = "x86_64")]
+        SimdLevel::Avx2 => unsafe { x86::gain_avx2(input, output, gain) },
+        #[cfg(target_arch = "x86_64")]
+        SimdLevel::Sse2 => unsafe { x86::gain_sse2(input, output, gain) },
+        #[cfg(target_arch = "aarch64")]
+        SimdLevel::Neon => unsafe { neon::gain(input, output, gain) },
+        _ => 0,
+    };
+    for (out, sample) in output[done..].iter_mut().zip(&input[done..]) {
+        *out = sample * gain;
+    }
+}
+
+/// Multiplies every sample in `buffer` by `gain`.
+pub fn gain_in_place(buffer: &mut [f32], gain: f32) {
+    let done = match simd_level() {
+        #[cfg(target_arch = "x86_64")]
+        SimdLevel::Avx2 => unsafe { x86::gain_in_place_avx2(buffer, gain) },
+        #[cfg(target_arch = "x86_64")]
+        SimdLevel::Sse2 => unsafe { x86::gain_in_place_sse2(buffer, gain) },
+        #[cfg(target_arch = "aarch64")]
+        SimdLevel::Neon => unsafe { neon::gain_in_place(buffer, gain) },
+        _ => 0,
+    };
+    for sample in &mut buffer[done..] {
+        *sample *= gain;
+    }
+}
+
+/// Adds `input * gain` to `output`.
+///
+/// # Panics
+///
+/// Panics if `input` and `output` have different lengths.
+pub fn mix(input: &[f32], output: &mut [f32], gain: f32) {
+    assert_eq!(input.len(), output.len(), "buffers must be the same length");
+    let done = match simd_level() {
+        #[cfg(target_arch = "x86_64")]
+        SimdLevel::Avx2 => unsafe { x86::mix_avx2(input, output, gain) },
+        #[cfg(target_arch = "x86_64")]
+        SimdLevel::Sse2 => unsafe { x86::mix_sse2(input, output, gain) },
+        #[cfg(target_arch = "aarch64")]
+        SimdLevel::Neon => unsafe { neon::mix(input, output, gain) },
+        _ => 0,
+    };
+    for (out, sample) in output[done..].iter_mut().zip(&input[done..]) {
+        *out += sample * gain;
+    }
+}
+
+/// Returns the largest absolute value in `buffer`, or 0 if it is empty.
+pub fn peak(buffer: &[f32]) -> f32 {
+    let (done, peak) = match simd_level() {
+        #[cfg(target_arch = "x86_64")]
+        SimdLevel::Avx2 => unsafe { x86::peak_avx2(buffer) },
+        #[cfg(target_arch = "x86_64")]
+        SimdLevel::Sse2 => unsafe { x86::peak_sse2(buffer) },
+        #[cfg(target_arch = "aarch64")]
+        SimdLevel::Neon => unsafe { neon::peak(buffer) },
+        _ => (0, 0.0),
+    };
+    buffer[done..]
+        .iter()
+        .fold(peak, |peak, sample| peak.max(sample.abs()))
+}
+
+/// Returns the sum of the squares of every sample in `buffer`.
+pub fn sum_squares(buffer: &[f32]) -> f32 {
+    let (done, sum) = match simd_level() {
+        #[cfg(target_arch = "x86_64")]
+        SimdLevel::Avx2 => unsafe { x86::sum_squares_avx2(buffer) },
+        #[cfg(target_arch = "x86_64")]
+        SimdLevel::Sse2 => unsafe { x86::sum_squares_sse2(buffer) },
+        #[cfg(target_arch = "aarch64")]
+        SimdLevel::Neon => unsafe { neon::sum_squares(buffer) },
+        _ => (0, 0.0),
+    };
+    buffer[done..]
+        .iter()
+        .fold(sum, |sum, sample| sum + sample * sample)
+}
+
+/// Splits an interleaved buffer into one buffer per channel.
+///
+/// `input` holds `outputs.len()` channels, and every output must be `input.len() / outputs.len()` samples long.
+/// Stereo buffers use a vectorized path.
+///
+/// # Panics
+///
+/// Panics if the buffer lengths don't match.
+pub fn deinterleave(input: &[f32], outputs: &mut [&mut [f32]]) {
+    let channels = outputs.len();
+    if channels == 0 {
+        return;
+    }
+    let frames = input.len() / channels;
+    assert_eq!(
+        frames * channels,
+        input.len(),
+        "input must hold whole frames"
+    );
+    assert!(
+        outputs.iter().all(|o| o.len() == frames),
+        "outputs must be one frame long per sample"
+    );
+
+    let mut done = 0;
+    if let [left, right] = outputs {
+        done = match simd_level() {
+            #[cfg(target_arch = "x86_64")]
+            SimdLevel::Avx2 | SimdLevel::Sse2 => unsafe {
+                x86::deinterleave_stereo(input, left, right)
+            },
+            #[cfg(target_arch = "aarch64")]
+            SimdLevel::Neon => unsafe { neon::deinterleave_stereo(input, left, right) },
+            _ => 0,
+        };
+    }
+    for frame in done..frames {
+        for (channel, output) in outputs.iter_mut().enumerate() {
+            output[frame] = input[frame * channels + channel];
+        }
+    }
+}
+
+/// Combines one buffer per channel into an interleaved buffer, the inverse of [`deinterleave`].
+///
+/// # Panics
+///
+/// Panics if the buffer lengths don't match.
+pub fn interleave(inputs: &[&[f32]], output: &mut [f32]) {
+    let channels = inputs.len();
+    if channels == 0 {
+        return;
+    }
+    let frames = output.len() / channels;
+    assert_eq!(
+        frames * channels,
+        output.len(),
+        "output must hold whole frames"
+    );
+    assert!(
+        inputs.iter().all(|i| i.len() == frames),
+        "inputs must be one frame long per sample"
+    );
+
+    let mut done = 0;
+    if let [left, right] = inputs {
+        done = match simd_level() {
+            #[cfg(target_arch = "x86_64")]
+            SimdLevel::Avx2 | SimdLevel::Sse2 => unsafe {
+                x86::interleave_stereo(left, right, output)
+            },
+            #[cfg(target_arch = "aarch64")]
+            SimdLevel::Neon => unsafe { neon::interleave_stereo(left, right, output) },
+            _ => 0,
+        };
+    }
+    for frame in done..frames {
+        for (channel, input) in inputs.iter().enumerate() {
+            output[frame * channels + channel] = input[frame];
+        }
+    }
+}
+
+/// Normalized biquad filter coefficients, where `a0` is 1.
+#[derive(Debug, Clone, Copy, PartialEq, Default)]
+pub struct BiquadCoefficients {
+    pub b0: f32,
+    pub b1: f32,
+    pub b2: f32,
+    pub a1: f32,
+    pub a2: f32,
+}
+
+impl BiquadCoefficients {
+    /// A second order lowpass, from the RBJ audio EQ cookbook.
+    pub fn lowpass(sample_rate: f32, cutoff: f32, q: f32) -> Self {
+        let (cos, alpha) = Self::prewarp(sample_rate, cutoff, q);
+        Self::normalize(
+            (1.0 - cos) / 2.0,
+            1.0 - cos,
+            (1.0 - cos) / 2.0,
+            1.0 + alpha,
+            -2.0 * cos,
+            1.0 - alpha,
+        )
+    }
+
+    /// A second order highpass, from the RBJ audio EQ cookbook.
+    pub fn highpass(sample_rate: f32, cutoff: f32, q: f32) -> Self {
+        let (cos, alpha) = Self::prewarp(sample_rate, cutoff, q);
+        Self::normalize(
+            (1.0 + cos) / 2.0,
+            -(1.0 + cos),
+            (1.0 + cos) / 2.0,
+            1.0 + alpha,
+            -2.0 * cos,
+            1.0 - alpha,
+        )
+    }
+
+    /// A constant peak gain bandpass, from the RBJ audio EQ cookbook.
+    pub fn bandpass(sample_rate: f32, center: f32, q: f32) -> Self {
+        let (cos, alpha) = Self::prewarp(sample_rate, center, q);
+        Self::normalize(alpha, 0.0, -alpha, 1.0 + alpha, -2.0 * cos, 1.0 - alpha)
+    }
+
+    fn prewarp(sample_rate: f32, frequency: f32, q: f32) -> (f32, f32) {
+        let omega = std::f32::consts::TAU * frequency / sample_rate;
+        (omega.cos(), omega.sin() / (2.0 * q))
+    }
+
+    fn normalize(b0: f32, b1: f32, b2: f32, a0: f32, a1: f32, a2: f32) -> Self {
+        Self {
+            b0: b0 / a0,
+            b1: b1 / a0,
+            b2: b2 / a0,
+            a1: a1 / a0,
+            a2: a2 / a0,
+        }
+    }
+}
+
+/// A biquad filter over interleaved buffers, keeping separate state for every channel.
+///
+/// Each channel is a recurrence, so the filter vectorizes across channels instead of samples:
+/// 4 and 8 channel buffers (quad, 7.1) are filtered 4 channels at a time.
+#[derive(Debug, Clone)]
+pub struct Biquad {
+    pub coefficients: BiquadCoefficients,
+    // transposed direct form II state, one entry per channel
+    z1: [f32; crate::MAX_CHANNEL_WIDTH as usize],
+    z2: [f32; crate::MAX_CHANNEL_WIDTH as usize],
+}
+
+impl Biquad {
+    pub fn new(coefficients: BiquadCoefficients) -> Self {
+        Self {
+            coefficients,
+            z1: [0.0; crate::MAX_CHANNEL_WIDTH as usize],
+            z2: [0.0; crate::MAX_CHANNEL_WIDTH as usize],
+        }
+    }
+
+    /// Clears the filter state, for example from [`crate::DspPlugin::reset`].
+    pub fn reset(&mut self) {
+        self.z1.fill(0.0);
+        self.z2.fill(0.0);
+    }
+
+    /// Filters `channels` interleaved channels from `input` into `output`.
+    ///
+    /// # Panics
+    ///
+    /// Panics if the buffers have different lengths, `channels` is 0 or more than [`crate::MAX_CHANNEL_WIDTH`],
+    /// or the buffers don't hold a whole number of frames.
+    pub fn process(&mut self, input: &[f32], output: &mut [f32], channels: usize) {
+        assert_eq!(input.len(), output.len(), "buffers must be the same length");
+        assert!(
+            (1..=self.z1.len()).contains(&channels),
+            "unsupported channel count"
+        );
+        // the vectorized paths load and store whole frames
+        assert!(
+            input.len() % channels == 0,
+            "buffers must hold a whole number of frames"
+        );
+
+        if channels % 4 == 0 {
+            match simd_level() {
+                #[cfg(target_arch = "x86_64")]
+                SimdLevel::Avx2 | SimdLevel::Sse2 => {
+                    unsafe { x86::biquad_sse2(self, input, output, channels) };
+                    return;
+                }
+                #[cfg(target_arch = "aarch64")]
+                SimdLevel::Neon => {
+                    unsafe { neon::biquad(self, input, output, channels) };
+                    return;
+                }
+                _ => {}
+            }
+        }
+
+        let BiquadCoefficients { b0, b1, b2, a1, a2 } = self.coefficients;
+        for (in_frame, out_frame) in input
+            .chunks_exact(channels)
+            .zip(output.chunks_exact_mut(channels))
+        {
+            for channel in 0..channels {
+                let x = in_frame[channel];
+                let y = b0 * x + self.z1[channel];
+                self.z1[channel] = b1 * x - a1 * y + self.z2[channel];
+                self.z2[channel] = b2 * x - a2 * y;
+                out_frame[channel] = y;
+            }
+        }
+    }
+}
+
+// the vectorized loops below process as many samples as fit their vector width, and return how many samples they processed.
+// the callers finish the remaining samples with a scalar loop.
+
+#[cfg(target_arch = "x86_64")]
+mod x86 {
+    use super::{Biquad, BiquadCoefficients};
+    use std::arch::x86_64::*;
+
+    #[target_feature(enable = "avx2")]
+    pub(super) unsafe fn gain_avx2(input: &[f32], output: &mut [f32], gain: f32) -> usize {
+        unsafe {
+            let len = input.len() & !7;
+            let gain = _mm256_set1_ps(gain);
+            for i in (0..len).step_by(8) {
+                let x = _mm256_loadu_ps(input.as_ptr().add(i));
+                _mm256_storeu_ps(output.as_mut_ptr().add(i), _mm256_mul_ps(x, gain));
+            }
+            len
+        }
+    }
+
+    #[target_feature(enable = "avx2")]
+    pub(super) unsafe fn gain_in_place_avx2(buffer: &mut [f32], gain: f32) -> usize {
+        unsafe {
+            let len = buffer.len() & !7;
+            let gain = _mm256_set1_ps(gain);
+            for i in (0..len).step_by(8) {
+                let ptr = buffer.as_mut_ptr().add(i);
+                _mm256_storeu_ps(ptr, _mm256_mul_ps(_mm256_loadu_ps(ptr), gain));
+            }
+            len
+        }
+    }
+
+    #[target_feature(enable = "avx2")]
+    pub(super) unsafe fn mix_avx2(input: &[f32], output: &mut [f32], gain: f32) -> usize {
+        unsafe {
+            let len = input.len() & !7;
+            let gain = _mm256_set1_ps(gain);
+            for i in (0..len).step_by(8) {
+                let x = _mm256_loadu_ps(input.as_ptr().add(i));
+                let ptr = output.as_mut_ptr().add(i);
+                let y = _mm256_add_ps(_mm256_loadu_ps(ptr), _mm256_mul_ps(x, gain));
+                _mm256_storeu_ps(ptr, y);
+            }
+            len
+        }
+    }
+
+    pub(super) unsafe fn gain_sse2(input: &[f32], output: &mut [f32], gain: f32) -> usize {
+        unsafe {
+            let len = input.len() & !3;
+            let gain = _mm_set1_ps(gain);
+            for i in (0..len).step_by(4) {
+                let x = _mm_loadu_ps(input.as_ptr().add(i));
+                _mm_storeu_ps(output.as_mut_ptr().add(i), _mm_mul_ps(x, gain));
+            }
+            len
+        }
+    }
+
+    pub(super) unsafe fn gain_in_place_sse2(buffer: &mut [f32], gain: f32) -> usize {
+        unsafe {
+            let len = buffer.len() & !3;
+            let gain = _mm_set1_ps(gain);
+            for i in (0..len).step_by(4) {
+                let ptr = buffer.as_mut_ptr().add(i);
+                _mm_storeu_ps(ptr, _mm_mul_ps(_mm_loadu_ps(ptr), gain));
+            }
+            len
+        }
+    }
+
+    pub(super) unsafe fn mix_sse2(input: &[f32], output: &mut [f32], gain: f32) -> usize {
+        unsafe {
+            let len = input.len() & !3;
+            let gain = _mm_set1_ps(gain);
+            for i in (0..len).step_by(4) {
+                let x = _mm_loadu_ps(input.as_ptr().add(i));
+                let ptr = output.as_mut_ptr().add(i);
+                _mm_storeu_ps(ptr, _mm_add_ps(_mm_loadu_ps(ptr), _mm_mul_ps(x, gain)));
+            }
+            len
+        }
+    }
+
+    // the reductions also return the partial result
+
+    #[target_feature(enable = "avx2")]
+    pub(super) unsafe fn peak_avx2(buffer: &[f32]) -> (usize, f32) {
+        unsafe {
+            let len = buffer.len() & !7;
+            let mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fff_ffff));
+            let mut peak = _mm256_setzero_ps();
+            for i in (0..len).step_by(8) {
+                let x = _mm256_and_ps(_mm256_loadu_ps(buffer.as_ptr().add(i)), mask);
+                peak = _mm256_max_ps(peak, x);
+            }
+            let peak = _mm_max_ps(
+                _mm256_castps256_ps128(peak),
+                _mm256_extractf128_ps::<1>(peak),
+            );
+            (len, horizontal_max(peak))
+        }
+    }
+
+    #[target_feature(enable = "avx2")]
+    pub(super) unsafe fn sum_squares_avx2(buffer: &[f32]) -> (usize, f32) {
+        unsafe {
+            let len = buffer.len() & !7;
+            let mut sum = _mm256_setzero_ps();
+            for i in (0..len).step_by(8) {
+                let x = _mm256_loadu_ps(buffer.as_ptr().add(i));
+                sum = _mm256_add_ps(sum, _mm256_mul_ps(x, x));
+            }
+            let sum = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps::<1>(sum));
+            (len, horizontal_sum(sum))
+        }
+    }
+
+    pub(super) unsafe fn peak_sse2(buffer: &[f32]) -> (usize, f32) {
+        unsafe {
+            let len = buffer.len() & !3;
+            let mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fff_ffff));
+            let mut peak = _mm_setzero_ps();
+            for i in (0..len).step_by(4) {
+                let x = _mm_and_ps(_mm_loadu_ps(buffer.as_ptr().add(i)), mask);
+                peak = _mm_max_ps(peak, x);
+            }
+            (len, horizontal_max(peak))
+        }
+    }
+
+    pub(super) unsafe fn sum_squares_sse2(buffer: &[f32]) -> (usize, f32) {
+        unsafe {
+            let len = buffer.len() & !3;
+            let mut sum = _mm_setzero_ps();
+            for i in (0..len).step_by(4) {
+                let x = _mm_loadu_ps(buffer.as_ptr().add(i));
+                sum = _mm_add_ps(sum, _mm_mul_ps(x, x));
+            }
+            (len, horizontal_sum(sum))
+        }
+    }
+
+    unsafe fn horizontal_max(x: __m128) -> f32 {
+        unsafe {
+            let x = _mm_max_ps(x, _mm_movehl_ps(x, x));
+            let x = _mm_max_ss(x, _mm_shuffle_ps::<0b01>(x, x));
+            _mm_cvtss_f32(x)
+        }
+    }
+
+    unsafe fn horizontal_sum(x: __m128) -> f32 {
+        unsafe {
+            let x = _mm_add_ps(x, _mm_movehl_ps(x, x));
+            let x = _mm_add_ss(x, _mm_shuffle_ps::<0b01>(x, x));
+            _mm_cvtss_f32(x)
+        }
+    }
+
+    // returns the number of frames processed
+    pub(super) unsafe fn deinterleave_stereo(
+        input: &[f32],
+        left: &mut [f32],
+        right: &mut [f32],
+    ) -> usize {
+        unsafe {
+            let frames = left.len() & !3;
+            for frame in (0..frames).step_by(4) {
+                let a = _mm_loadu_ps(input.as_ptr().add(frame * 2)); // l0 r0 l1 r1
+                let b = _mm_loadu_ps(input.as_ptr().add(frame * 2 + 4)); // l2 r2 l3 r3
+                let l = _mm_shuffle_ps::<0b10_00_10_00>(a, b);
+                let r = _mm_shuffle_ps::<0b11_01_11_01>(a, b);
+                _mm_storeu_ps(left.as_mut_ptr().add(frame), l);
+                _mm_storeu_ps(right.as_mut_ptr().add(frame), r);
+            }
+            frames
+        }
+    }
+
+    // returns the number of frames processed
+    pub(super) unsafe fn interleave_stereo(
+        left: &[f32],
+        right: &[f32],
+        output: &mut [f32],
+    ) -> usize {
+        unsafe {
+            let frames = left.len() & !3;
+            for frame in (0..frames).step_by(4) {
+                let l = _mm_loadu_ps(left.as_ptr().add(frame));
+                let r = _mm_loadu_ps(right.as_ptr().add(frame));
+                _mm_storeu_ps(output.as_mut_ptr().add(frame * 2), _mm_unpacklo_ps(l, r));
+                _mm_storeu_ps(
+                    output.as_mut_ptr().add(frame * 2 + 4),
+                    _mm_unpackhi_ps(l, r),
+                );
+            }
+            frames
+        }
+    }
+
+    // channels must be a multiple of 4
+    pub(super) unsafe fn biquad_sse2(
+        filter: &mut Biquad,
+        input: &[f32],
+        output: &mut [f32],
+        channels: usize,
+    ) {
+        unsafe {
+            let BiquadCoefficients { b0, b1, b2, a1, a2 } = filter.coefficients;
+            let (b0, b1, b2) = (_mm_set1_ps(b0), _mm_set1_ps(b1), _mm_set1_ps(b2));
+            let (a1, a2) = (_mm_set1_ps(a1), _mm_set1_ps(a2));
+            for group in (0..channels).step_by(4) {
+                let mut z1 = _mm_loadu_ps(filter.z1.as_ptr().add(group));
+                let mut z2 = _mm_loadu_ps(filter.z2.as_ptr().add(group));
+                for frame in (group..input.len()).step_by(channels) {
+                    let x = _mm_loadu_ps(input.as_ptr().add(frame));
+                    let y = _mm_add_ps(_mm_mul_ps(b0, x), z1);
+                    z1 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(b1, x), _mm_mul_ps(a1, y)), z2);
+                    z2 = _mm_sub_ps(_mm_mul_ps(b2, x), _mm_mul_ps(a2, y));
+                    _mm_storeu_ps(output.as_mut_ptr().add(frame), y);
+                }
+                _mm_storeu_ps(filter.z1.as_mut_ptr().add(group), z1);
+                _mm_storeu_ps(filter.z2.as_mut_ptr().add(group), z2);
+            }
+        }
+    }
+}
+
+#[cfg(target_arch = "aarch64")]
+mod neon {
+    use super::{Biquad, BiquadCoefficients};
+    use std::arch::aarch64::*;
+
+    pub(super) unsafe fn gain(input: &[f32], output: &mut [f32], gain: f32) -> usize {
+        unsafe {
+            let len = input.len() & !3;
+            for i in (0..len).step_by(4) {
+                let x = vld1q_f32(input.as_ptr().add(i));
+                vst1q_f32(output.as_mut_ptr().add(i), vmulq_n_f32(x, gain));
+            }
+            len
+        }
+    }
+
+    pub(super) unsafe fn gain_in_place(buffer: &mut [f32], gain: f32) -> usize {
+        unsafe {
+            let len = buffer.len() & !3;
+            for i in (0..len).step_by(4) {
+                let ptr = buffer.as_mut_ptr().add(i);
+                vst1q_f32(ptr, vmulq_n_f32(vld1q_f32(ptr), gain));
+            }
+            len
+        }
+    }
+
+    pub(super) unsafe fn mix(input: &[f32], output: &mut [f32], gain: f32) -> usize {
+        unsafe {
+            let len = input.len() & !3;
+            let gain = vdupq_n_f32(gain);
+            for i in (0..len).step_by(4) {
+                let x = vld1q_f32(input.as_ptr().add(i));
+                let ptr = output.as_mut_ptr().add(i);
+                vst1q_f32(ptr, vfmaq_f32(vld1q_f32(ptr), x, gain));
+            }
+            len
+        }
+    }
+
+    // the reductions also return the partial result
+
+    pub(super) unsafe fn peak(buffer: &[f32]) -> (usize, f32) {
+        unsafe {
+            let len = buffer.len() & !3;
+            let mut peak = vdupq_n_f32(0.0);
+            for i in (0..len).step_by(4) {
+                peak = vmaxq_f32(peak, vabsq_f32(vld1q_f32(buffer.as_ptr().add(i))));
+            }
+            (len, vmaxvq_f32(peak))
+        }
+    }
+
+    pub(super) unsafe fn sum_squares(buffer: &[f32]) -> (usize, f32) {
+        unsafe {
+            let len = buffer.len() & !3;
+            let mut sum = vdupq_n_f32(0.0);
+            for i in (0..len).step_by(4) {
+                let x = vld1q_f32(buffer.as_ptr().add(i));
+                sum = vfmaq_f32(sum, x, x);
+            }
+            (len, vaddvq_f32(sum))
+        }
+    }
+
+    // returns the number of frames processed
+    pub(super) unsafe fn deinterleave_stereo(
+        input: &[f32],
+        left: &mut [f32],
+        right: &mut [f32],
+    ) -> usize {
+        unsafe {
+            let frames = left.len() & !3;
+            for frame in (0..frames).step_by(4) {
+                let lr = vld2q_f32(input.as_ptr().add(frame * 2));
+                vst1q_f32(left.as_mut_ptr().add(frame), lr.0);
+                vst1q_f32(right.as_mut_ptr().add(frame), lr.1);
+            }
+            frames
+        }
+    }
+
+    // returns the number of frames processed
+    pub(super) unsafe fn interleave_stereo(
+        left: &[f32],
+        right: &[f32],
+        output: &mut [f32],
+    ) -> usize {
+        unsafe {
+            let frames = left.len() & !3;
+            for frame in (0..frames).step_by(4) {
+                let lr = float32x4x2_t(
+                    vld1q_f32(left.as_ptr().add(frame)),
+                    vld1q_f32(right.as_ptr().add(frame)),
+                );
+                vst2q_f32(output.as_mut_ptr().add(frame * 2), lr);
+            }
+            frames
+        }
+    }
+
+    // channels must be a multiple of 4
+    pub(super) unsafe fn biquad(
+        filter: &mut Biquad,
+        input: &[f32],
+        output: &mut [f32],
+        channels: usize,
+    ) {
+        unsafe {
+            let BiquadCoefficients { b0, b1, b2, a1, a2 } = filter.coefficients;
+            for group in (0..channels).step_by(4) {
+                let mut z1 = vld1q_f32(filter.z1.as_ptr().add(group));
+                let mut z2 = vld1q_f32(filter.z2.as_ptr().add(group));
+                for frame in (group..input.len()).step_by(channels) {
+                    let x = vld1q_f32(input.as_ptr().add(frame));
+                    let y = vaddq_f32(vmulq_n_f32(x, b0), z1);
+                    z1 = vaddq_f32(vsubq_f32(vmulq_n_f32(x, b1), vmulq_n_f32(y, a1)), z2);
+                    z2 = vsubq_f32(vmulq_n_f32(x, b2), vmulq_n_f32(y, a2));
+                    vst1q_f32(output.as_mut_ptr().add(frame), y);
+                }
+                vst1q_f32(filter.z1.as_mut_ptr().add(group), z1);
+                vst1q_f32(filter.z2.as_mut_ptr().add(group), z2);
+            }
+        }
+    }
+}
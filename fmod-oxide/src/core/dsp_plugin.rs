@@ -0,0 +1,468 @@
+// Copyright (c) 2024 Lily Lyons
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+use fmod_sys::*;
+use std::{
+    any::TypeId,
+    cell::UnsafeCell,
+    ffi::{c_char, c_int, c_uint, c_void},
+    sync::{
+        atomic::{AtomicBool, AtomicU32, Ordering},
+        Mutex,
+    },
+};
+
+use crate::{Dsp, DspParameterDescription, DspParameterType, System};
+
+/// A custom DSP effect or generator, created with [`System::create_dsp_plugin`].
+///
+/// The trampolines this crate generates handle every FMOD callback:
+/// - [`DspPlugin::process`] is called from the mixer thread with FMOD's interleaved buffers, which are 16 byte aligned.
+/// - Parameter changes can come from any thread, so they are recorded and applied with [`DspPlugin::set_parameter`] on the mixer thread right before the next [`DspPlugin::process`].
+///   Several changes to the same parameter in between are coalesced into the last one.
+/// - [`DspPlugin::reset`] is deferred the same way.
+///
+/// See [`crate::dsp_kernels`] for vectorized implementations of common processing steps.
+#[allow(unused_variables)]
+pub trait DspPlugin: Send + Sized + 'static {
+    /// The name of the DSP, at most 31 bytes long. Longer names are truncated.
+    const NAME: &'static str;
+    /// Plugin writer's version number.
+    const VERSION: c_uint = 1;
+    /// Whether to process when every input is idle, for example for generators or effects with a tail.
+    ///
+    /// When this is false, FMOD skips the DSP while its inputs are silent.
+    const PROCESS_WHEN_IDLE: bool = false;
+
+    /// Creates a new instance of the DSP.
+    ///
+    /// Every parameter is set to its default through [`DspPlugin::set_parameter`] before the first [`DspPlugin::process`].
+    fn create() -> Result<Self>;
+
+    /// The parameters of the DSP, in index order.
+    ///
+    /// Only float, int and bool parameters are supported.
+    fn parameters() -> Vec<DspParameterDescription> {
+        Vec::new()
+    }
+
+    /// Applies a parameter change, called from the mixer thread.
+    ///
+    /// `value` always has the type declared in [`DspPlugin::parameters`].
+    fn set_parameter(&mut self, index: c_int, value: DspParameterValue) {}
+
+    /// Clears any internal state, for example filter history, called from the mixer thread.
+    fn reset(&mut self) {}
+
+    /// Processes one block of interleaved audio, called from the mixer thread.
+    ///
+    /// `input` holds `channels` interleaved channels.
+    /// `output` holds the same number of frames, and the same number of channels unless the DSP's output channel format was changed.
+    fn process(&mut self, input: &[f32], output: &mut [f32], channels: usize);
+}
+
+/// The value of a [`DspPlugin`] parameter.
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub enum DspParameterValue {
+    Float(f32),
+    Int(c_int),
+    Bool(bool),
+}
+
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+enum ParameterKind {
+    Float,
+    Int,
+    Bool,
+}
+
+impl ParameterKind {
+    fn decode(self, bits: u32) -> DspParameterValue {
+        match self {
+            ParameterKind::Float => DspParameterValue::Float(f32::from_bits(bits)),
+            ParameterKind::Int => DspParameterValue::Int(bits as c_int),
+            ParameterKind::Bool => DspParameterValue::Bool(bits != 0),
+        }
+    }
+}
+
+// FMOD keeps pointers to the description and its parameters, so each plugin type's description is built once and kept forever.
+struct PluginDescription {
+    description: FMOD_DSP_DESCRIPTION,
+    kinds: Box<[ParameterKind]>,
+    defaults: Box<[u32]>,
+    _parameters: Box<[FMOD_DSP_PARAMETER_DESC]>,
+    _parameter_pointers: Box<[*mut FMOD_DSP_PARAMETER_DESC]>,
+    _strings: Vec<DspParameterDescription>,
+}
+
+// the description is never modified after it is built
+unsafe impl Send for PluginDescription {}
+unsafe impl Sync for PluginDescription {}
+
+static DESCRIPTIONS: Mutex<Vec<(TypeId, &'static PluginDescription)>> = Mutex::new(Vec::new());
+
+fn copy_name<const N: usize>(name: &str) -> [c_char; N] {
+    let mut buffer = [0; N];
+    // leave room for the nul terminator, and don't cut a character in half
+    let mut len = name.len().min(N - 1);
+    while !name.is_char_boundary(len) {
+        len -= 1;
+    }
+    for (dst, src) in buffer.iter_mut().zip(&name.as_bytes()[..len]) {
+        *dst = *src as c_char;
+    }
+    buffer
+}
+
+fn plugin_description<P: DspPlugin>() -> Result<&'static PluginDescription> {
+    let mut descriptions = DESCRIPTIONS.lock().unwrap();
+    if let Some((_, description)) = descriptions.iter().find(|(t, _)| *t == TypeId::of::<P>()) {
+        return Ok(description);
+    }
+
+    let strings = P::parameters();
+    let mut kinds = Vec::with_capacity(strings.len());
+    let mut defaults = Vec::with_capacity(strings.len());
+    let mut parameters = Vec::with_capacity(strings.len());
+    for parameter in &strings {
+        let mut desc: FMOD_DSP_PARAMETER_DESC = unsafe { std::mem::zeroed() };
+        desc.name = copy_name(parameter.name.as_str());
+        desc.label = copy_name(parameter.label.as_str());
+        desc.description = parameter.description.as_ptr();
+        match parameter.kind {
+            DspParameterType::Float {
+                min, max, default, ..
+            } => {
+                desc.type_ = FMOD_DSP_PARAMETER_TYPE_FLOAT;
+                unsafe {
+                    desc.__bindgen_anon_1.floatdesc.min = min;
+                    desc.__bindgen_anon_1.floatdesc.max = max;
+                    desc.__bindgen_anon_1.floatdesc.defaultval = default;
+                    desc.__bindgen_anon_1.floatdesc.mapping.type_ =
+                        FMOD_DSP_PARAMETER_FLOAT_MAPPING_TYPE_AUTO;
+                }
+                kinds.push(ParameterKind::Float);
+                defaults.push(default.to_bits());
+            }
+            DspParameterType::Int {
+                min,
+                max,
+                default,
+                goes_to_infinity,
+            } => {
+                desc.type_ = FMOD_DSP_PARAMETER_TYPE_INT;
+                unsafe {
+                    desc.__bindgen_anon_1.intdesc.min = min;
+                    desc.__bindgen_anon_1.intdesc.max = max;
+                    desc.__bindgen_anon_1.intdesc.defaultval = default;
+                    desc.__bindgen_anon_1.intdesc.goestoinf = goes_to_infinity.into();
+                }
+                kinds.push(ParameterKind::Int);
+                defaults.push(default as u32);
+            }
+            DspParameterType::Bool { default } => {
+                desc.type_ = FMOD_DSP_PARAMETER_TYPE_BOOL;
+                unsafe {
+                    desc.__bindgen_anon_1.booldesc.defaultval = default.into();
+                }
+                kinds.push(ParameterKind::Bool);
+                defaults.push(u32::from(default));
+            }
+            DspParameterType::Data { .. } => {
+                return Err(Error::Fmod(FMOD_RESULT::FMOD_ERR_INVALID_PARAM))
+            }
+        }
+        parameters.push(desc);
+    }
+
+    let mut parameters = parameters.into_boxed_slice();
+    let mut parameter_pointers: Box<[_]> = parameters.iter_mut().map(std::ptr::from_mut).collect();
+
+    let mut description: FMOD_DSP_DESCRIPTION = unsafe { std::mem::zeroed() };
+    description.pluginsdkversion = FMOD_PLUGIN_SDK_VERSION;
+    description.name = copy_name(P::NAME);
+    description.version = P::VERSION;
+    description.numinputbuffers = 1;
+    description.numoutputbuffers = 1;
+    description.create = Some(create_impl::<P>);
+    description.release = Some(release_impl::<P>);
+    description.reset = Some(reset_impl::<P>);
+    description.read = Some(read_impl::<P>);
+    description.numparameters = parameters.len() as c_int;
+    description.paramdesc = parameter_pointers.as_mut_ptr();
+    description.setparameterfloat = Some(set_float_impl::<P>);
+    description.setparameterint = Some(set_int_impl::<P>);
+    description.setparameterbool = Some(set_bool_impl::<P>);
+    description.getparameterfloat = Some(get_float_impl::<P>);
+    description.getparameterint = Some(get_int_impl::<P>);
+    description.getparameterbool = Some(get_bool_impl::<P>);
+    description.shouldiprocess = Some(should_process_impl::<P>);
+
+    let description = Box::leak(Box::new(PluginDescription {
+        description,
+        kinds: kinds.into_boxed_slice(),
+        defaults: defaults.into_boxed_slice(),
+        _parameters: parameters,
+        _parameter_pointers: parameter_pointers,
+        _strings: strings,
+    }));
+    descriptions.push((TypeId::of::<P>(), description));
+    Ok(description)
+}
+
+// Per-instance state, stored in the DSP state's plugin data.
+// The setparameter callbacks only touch the atomics, the plugin itself is only accessed from the read callback.
+struct Instance<P> {
+    plugin: UnsafeCell<P>,
+    description: &'static PluginDescription,
+    values: Box<[AtomicU32]>,
+    dirty: Box<[AtomicBool]>,
+    any_dirty: AtomicBool,
+    reset_pending: AtomicBool,
+}
+
+impl<P> Instance<P> {
+    fn set(&self, index: c_int, kind: ParameterKind, bits: u32) -> FMOD_RESULT {
+        let Ok(index) = usize::try_from(index) else {
+            return FMOD_RESULT::FMOD_ERR_INVALID_PARAM;
+        };
+        if self.description.kinds.get(index) != Some(&kind) {
+            return FMOD_RESULT::FMOD_ERR_INVALID_PARAM;
+        }
+        self.values[index].store(bits, Ordering::Relaxed);
+        self.dirty[index].store(true, Ordering::Release);
+        self.any_dirty.store(true, Ordering::Release);
+        FMOD_RESULT::FMOD_OK
+    }
+
+    fn get(&self, index: c_int, kind: ParameterKind) -> Option<u32> {
+        let index = usize::try_from(index).ok()?;
+        if self.description.kinds.get(index) != Some(&kind) {
+            return None;
+        }
+        Some(self.values[index].load(Ordering::Relaxed))
+    }
+}
+
+unsafe fn instance<'a, P>(dsp_state: *mut FMOD_DSP_STATE) -> &'a Instance<P> {
+    unsafe { &*(*dsp_state).plugindata.cast::<Instance<P>>() }
+}
+
+unsafe extern "C" fn create_impl<P: DspPlugin>(dsp_state: *mut FMOD_DSP_STATE) -> FMOD_RESULT {
+    let description = match plugin_description::<P>() {
+        Ok(description) => description,
+        Err(e) => return e.into(),
+    };
+    let plugin = match P::create() {
+        Ok(plugin) => plugin,
+        Err(e) => return e.into(),
+    };
+    // every parameter starts out dirty, so the plugin receives the defaults before processing
+    let instance = Instance {
+        plugin: UnsafeCell::new(plugin),
+        description,
+        values: description
+            .defaults
+            .iter()
+            .map(|d| AtomicU32::new(*d))
+            .collect(),
+        dirty: description
+            .defaults
+            .iter()
+            .map(|_| AtomicBool::new(true))
+            .collect(),
+        any_dirty: AtomicBool::new(true),
+        reset_pending: AtomicBool::new(false),
+    };
+    unsafe {
+        (*dsp_state).plugindata = Box::into_raw(Box::new(instance)).cast::<c_void>();
+    }
+    FMOD_RESULT::FMOD_OK
+}
+
+unsafe extern "C" fn release_impl<P: DspPlugin>(dsp_state: *mut FMOD_DSP_STATE) -> FMOD_RESULT {
+    let instance = unsafe { (*dsp_state).plugindata.cast::<Instance<P>>() };
+    if !instance.is_null() {
+        drop(unsafe { Box::from_raw(instance) });
+    }
+    FMOD_RESULT::FMOD_OK
+}
+
+unsafe extern "C" fn reset_impl<P: DspPlugin>(dsp_state: *mut FMOD_DSP_STATE) -> FMOD_RESULT {
+    let instance = unsafe { instance::<P>(dsp_state) };
+    instance.reset_pending.store(true, Ordering::Release);
+    FMOD_RESULT::FMOD_OK
+}
+
+unsafe extern "C" fn read_impl<P: DspPlugin>(
+    dsp_state: *mut FMOD_DSP_STATE,
+    inbuffer: *mut f32,
+    outbuffer: *mut f32,
+    length: c_uint,
+    inchannels: c_int,
+    outchannels: *mut c_int,
+) -> FMOD_RESULT {
+    let instance = unsafe { instance::<P>(dsp_state) };
+    // FMOD only calls read from the mixer thread, and nothing else touches the plugin
+    let plugin = unsafe { &mut *instance.plugin.get() };
+
+    if instance.reset_pending.swap(false, Ordering::Acquire) {
+        plugin.reset();
+    }
+    if instance.any_dirty.swap(false, Ordering::Acquire) {
+        for (index, dirty) in instance.dirty.iter().enumerate() {
+            if dirty.swap(false, Ordering::Acquire) {
+                let bits = instance.values[index].load(Ordering::Relaxed);
+                let value = instance.description.kinds[index].decode(bits);
+                plugin.set_parameter(index as c_int, value);
+            }
+        }
+    }
+
+    let length = length as usize;
+    let channels = inchannels.max(0) as usize;
+    let out_channels = unsafe { *outchannels }.max(0) as usize;
+    let input = unsafe { std::slice::from_raw_parts(inbuffer, length * channels) };
+    let output = unsafe { std::slice::from_raw_parts_mut(outbuffer, length * out_channels) };
+    plugin.process(input, output, channels);
+    FMOD_RESULT::FMOD_OK
+}
+
+unsafe extern "C" fn should_process_impl<P: DspPlugin>(
+    _dsp_state: *mut FMOD_DSP_STATE,
+    inputs_idle: FMOD_BOOL,
+    _length: c_uint,
+    _in_mask: FMOD_CHANNELMASK,
+    _in_channels: c_int,
+    _speaker_mode: FMOD_SPEAKERMODE,
+) -> FMOD_RESULT {
+    if bool::from(inputs_idle) && !P::PROCESS_WHEN_IDLE {
+        FMOD_RESULT::FMOD_ERR_DSP_DONTPROCESS
+    } else {
+        FMOD_RESULT::FMOD_OK
+    }
+}
+
+unsafe extern "C" fn set_float_impl<P: DspPlugin>(
+    dsp_state: *mut FMOD_DSP_STATE,
+    index: c_int,
+    value: f32,
+) -> FMOD_RESULT {
+    let instance = unsafe { instance::<P>(dsp_state) };
+    instance.set(index, ParameterKind::Float, value.to_bits())
+}
+
+unsafe extern "C" fn set_int_impl<P: DspPlugin>(
+    dsp_state: *mut FMOD_DSP_STATE,
+    index: c_int,
+    value: c_int,
+) -> FMOD_RESULT {
+    let instance = unsafe { instance::<P>(dsp_state) };
+    instance.set(index, ParameterKind::Int, value as u32)
+}
+
+unsafe extern "C" fn set_bool_impl<P: DspPlugin>(
+    dsp_state: *mut FMOD_DSP_STATE,
+    index: c_int,
+    value: FMOD_BOOL,
+) -> FMOD_RESULT {
+    let instance = unsafe { instance::<P>(dsp_state) };
+    instance.set(index, ParameterKind::Bool, u32::from(bool::from(value)))
+}
+
+// value strings are optional, so they are left empty
+unsafe fn clear_value_string(value_string: *mut c_char) {
+    if !value_string.is_null() {
+        unsafe { *value_string = 0 };
+    }
+}
+
+unsafe extern "C" fn get_float_impl<P: DspPlugin>(
+    dsp_state: *mut FMOD_DSP_STATE,
+    index: c_int,
+    value: *mut f32,
+    value_string: *mut c_char,
+) -> FMOD_RESULT {
+    let instance = unsafe { instance::<P>(dsp_state) };
+    let Some(bits) = instance.get(index, ParameterKind::Float) else {
+        return FMOD_RESULT::FMOD_ERR_INVALID_PARAM;
+    };
+    unsafe {
+        *value = f32::from_bits(bits);
+        clear_value_string(value_string);
+    }
+    FMOD_RESULT::FMOD_OK
+}
+
+unsafe extern "C" fn get_int_impl<P: DspPlugin>(
+    dsp_state: *mut FMOD_DSP_STATE,
+    index: c_int,
+    value: *mut c_int,
+    value_string: *mut c_char,
+) -> FMOD_RESULT {
+    let instance = unsafe { instance::<P>(dsp_state) };
+    let Some(bits) = instance.get(index, ParameterKind::Int) else {
+        return FMOD_RESULT::FMOD_ERR_INVALID_PARAM;
+    };
+    unsafe {
+        *value = bits as c_int;
+        clear_value_string(value_string);
+    }
+    FMOD_RESULT::FMOD_OK
+}
+
+unsafe extern "C" fn get_bool_impl<P: DspPlugin>(
+    dsp_state: *mut FMOD_DSP_STATE,
+    index: c_int,
+    value: *mut FMOD_BOOL,
+    value_string: *mut c_char,
+) -> FMOD_RESULT {
+    let instance = unsafe { instance::<P>(dsp_state) };
+    let Some(bits) = instance.get(index, ParameterKind::Bool) else {
+        return FMOD_RESULT::FMOD_ERR_INVALID_PARAM;
+    };
+    unsafe {
+        *value = (bits != 0).into();
+        clear_value_string(value_string);
+    }
+    FMOD_RESULT::FMOD_OK
+}
+
+impl System {
+    /// Create a DSP object from a [`DspPlugin`].
+    ///
+    /// This is the safe counterpart to [`System::create_dsp`], the FMOD callbacks are generated from the trait.
+    /// The description for each plugin type is built on first use and kept for the rest of the program.
+    ///
+    /// DSPs must be attached to the DSP graph before they become active, either via ChannelControl::addDSP or DSP::addInput.
+    pub fn create_dsp_plugin<P: DspPlugin>(&self) -> Result<Dsp> {
+        let description = plugin_description::<P>()?;
+        let mut dsp = std::ptr::null_mut();
+        unsafe {
+            FMOD_System_CreateDSP(self.inner, &description.description, &mut dsp).to_result()?;
+        }
+        Ok(dsp.into())
+    }
+
+    /// Register a [`DspPlugin`] for later use, returning its plugin handle.
+    ///
+    /// Registered plugins can be created with [`System::create_dsp_by_plugin`], and loaded by FMOD Studio banks.
+    pub fn register_dsp_plugin<P: DspPlugin>(&self) -> Result<c_uint> {
+        let description = plugin_description::<P>()?;
+        let mut handle = 0;
+        unsafe {
+            // FMOD does not modify the description
+            FMOD_System_RegisterDSP(
+                self.inner,
+                std::ptr::from_ref(&description.description).cast_mut(),
+                &mut handle,
+            )
+            .to_result()?;
+        }
+        Ok(handle)
+    }
+}
@@ -192,3 +192,28 @@ impl From<DriverState> for FMOD_DRIVER_STATE {
         value.bits()
     }
 }
+
+bitflags::bitflags! {
+  /// Which nodes of a [`crate::ChannelGroup`] hierarchy [`crate::ChannelGroup::for_each_descendant_batch`] visits.
+  #[derive(Debug, Clone, Copy, PartialEq, Eq, PartialOrd, Ord)]
+  pub struct SubtreeTargets: FMOD_CHANNELGROUP_SUBTREE_FLAGS {
+    /// The group the walk starts from.
+    const ROOT     = FMOD_CHANNELGROUP_SUBTREE_ROOT;
+    /// Every group below the root.
+    const GROUPS   = FMOD_CHANNELGROUP_SUBTREE_GROUPS;
+    /// Every Channel playing on the root or a group below it.
+    const CHANNELS = FMOD_CHANNELGROUP_SUBTREE_CHANNELS;
+  }
+}
+
+impl From<FMOD_CHANNELGROUP_SUBTREE_FLAGS> for SubtreeTargets {
+    fn from(value: FMOD_CHANNELGROUP_SUBTREE_FLAGS) -> Self {
+        SubtreeTargets::from_bits_truncate(value)
+    }
+}
+
+impl From<SubtreeTargets> for FMOD_CHANNELGROUP_SUBTREE_FLAGS {
+    fn from(value: SubtreeTargets) -> Self {
+        value.bits()
+    }
+}
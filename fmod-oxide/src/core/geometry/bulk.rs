@@ -0,0 +1,131 @@
+// Copyright (c) 2024 Lily Lyons
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+use fmod_sys::*;
+use std::{
+    ffi::{c_float, c_int},
+    ops::Range,
+};
+
+use crate::{Geometry, Vector};
+
+/// How one polygon in a [`Geometry::add_polygons_bulk`] call is made, see [`Geometry::add_polygon`].
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub struct PolygonDesc {
+    /// Number of vertices of this polygon in the vertex slice, at least 3.
+    pub vertex_count: c_int,
+    pub direct_occlusion: c_float,
+    pub reverb_occlusion: c_float,
+    pub double_sided: bool,
+}
+
+impl Geometry {
+    /// Adds many polygons at once, returning the range of their indices.
+    ///
+    /// `vertices` holds the vertices of every polygon back to back, `polygons[0].vertex_count` vertices for the first polygon and so on.
+    /// Both slices and the polygon limit from [`Geometry::get_max_polygons`] are checked up front,
+    /// so either every polygon is handed to FMOD or [`FMOD_RESULT::FMOD_ERR_INVALID_PARAM`] is returned and nothing is added.
+    /// The vertex limit is also checked up front when the object has no polygons yet.
+    /// Otherwise counting the vertices already used would take a call per polygon, so running out of vertices is left to FMOD.
+    /// If FMOD itself fails part way through, the polygons before the failing one stay added.
+    ///
+    /// See [`Geometry::add_polygon`] for the requirements on each polygon.
+    pub fn add_polygons_bulk(
+        &self,
+        vertices: &[Vector],
+        polygons: &[PolygonDesc],
+    ) -> Result<Range<c_int>> {
+        let mut total = 0;
+        for polygon in polygons {
+            if polygon.vertex_count < 3 {
+                return Err(Error::Fmod(FMOD_RESULT::FMOD_ERR_INVALID_PARAM));
+            }
+            total += polygon.vertex_count as usize;
+        }
+        let (max_polygons, max_vertices) = self.get_max_polygons()?;
+        let first = self.get_polygon_count()?;
+        if total != vertices.len() || polygons.len() > (max_polygons - first) as usize {
+            return Err(Error::Fmod(FMOD_RESULT::FMOD_ERR_INVALID_PARAM));
+        }
+        if first == 0 && total > max_vertices.max(0) as usize {
+            return Err(Error::Fmod(FMOD_RESULT::FMOD_ERR_INVALID_PARAM));
+        }
+
+        let mut offset = 0;
+        let mut index = first;
+        for polygon in polygons {
+            let polygon_vertices = &vertices[offset..offset + polygon.vertex_count as usize];
+            unsafe {
+                FMOD_Geometry_AddPolygon(
+                    self.inner,
+                    polygon.direct_occlusion,
+                    polygon.reverb_occlusion,
+                    polygon.double_sided.into(),
+                    polygon.vertex_count,
+                    polygon_vertices.as_ptr().cast(),
+                    &mut index,
+                )
+                .to_result()?;
+            }
+            offset += polygon.vertex_count as usize;
+        }
+        Ok(first..first + polygons.len() as c_int)
+    }
+
+    /// Moves every vertex of the polygons in `polygons`.
+    ///
+    /// `vertices` holds the new vertices of every polygon back to back, and must contain exactly as many vertices as the polygons have.
+    /// This is checked before any vertex is moved, failing with [`FMOD_RESULT::FMOD_ERR_INVALID_PARAM`].
+    ///
+    /// See [`Geometry::set_polygon_vertex`] about the cost of moving vertices. Deactivating the object with [`Geometry::set_active`] while moving many vertices avoids reconfiguring it more than needed.
+    pub fn set_vertices_bulk(&self, polygons: Range<c_int>, vertices: &[Vector]) -> Result<()> {
+        let counts = polygons
+            .clone()
+            .map(|index| self.get_polygon_vertex_count(index))
+            .collect::<Result<Vec<_>>>()?;
+        let total: usize = counts.iter().map(|&count| count as usize).sum();
+        if total != vertices.len() {
+            return Err(Error::Fmod(FMOD_RESULT::FMOD_ERR_INVALID_PARAM));
+        }
+
+        let mut vertices = vertices.iter();
+        for (index, count) in polygons.zip(counts) {
+            for (vertex_index, vertex) in (0..count).zip(vertices.by_ref()) {
+                unsafe {
+                    FMOD_Geometry_SetPolygonVertex(
+                        self.inner,
+                        index,
+                        vertex_index,
+                        std::ptr::from_ref(vertex).cast(),
+                    )
+                    .to_result()?;
+                }
+            }
+        }
+        Ok(())
+    }
+
+    /// Appends every vertex of the polygons in `polygons` to `vertices`, back to back.
+    pub fn get_vertices_bulk(
+        &self,
+        polygons: Range<c_int>,
+        vertices: &mut Vec<Vector>,
+    ) -> Result<()> {
+        for index in polygons {
+            let count = self.get_polygon_vertex_count(index)?;
+            vertices.reserve(count as usize);
+            for vertex_index in 0..count {
+                let mut vertex = FMOD_VECTOR::default();
+                unsafe {
+                    FMOD_Geometry_GetPolygonVertex(self.inner, index, vertex_index, &mut vertex)
+                        .to_result()?;
+                }
+                vertices.push(vertex.into());
+            }
+        }
+        Ok(())
+    }
+}
@@ -0,0 +1,273 @@
+// Copyright (c) 2024 Lily Lyons
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+use fmod_sys::*;
+use std::{collections::HashMap, ffi::c_float, ffi::c_int};
+
+use crate::{Geometry, PolygonDesc, System, Vector};
+
+/// Options for [`CookedGeometry::cook`].
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub struct CookOptions {
+    /// Vertices closer than this (per axis) are welded into one. 0 only welds identical vertices.
+    pub weld_distance: c_float,
+    /// Adjacent triangles whose normals are closer than this angle (in radians) are merged into one polygon when the result is convex.
+    /// A negative angle disables merging.
+    pub merge_angle: c_float,
+    pub direct_occlusion: c_float,
+    pub reverb_occlusion: c_float,
+    pub double_sided: bool,
+    /// Number of threads to clean up triangles on. 0 uses [`std::thread::available_parallelism`].
+    pub threads: usize,
+}
+
+impl Default for CookOptions {
+    fn default() -> Self {
+        Self {
+            weld_distance: 0.0,
+            merge_angle: 0.01,
+            direct_occlusion: 1.0,
+            reverb_occlusion: 1.0,
+            double_sided: false,
+            threads: 0,
+        }
+    }
+}
+
+/// An occlusion mesh simplified into FMOD polygons ahead of time, ready for [`Geometry::add_polygons_bulk`].
+///
+/// Cooking welds close vertices, drops degenerate triangles and merges coplanar neighbours into convex quads,
+/// which typically halves the polygon count of a level mesh. The triangle clean up is split across threads.
+///
+/// This is meant to run in an asset pipeline: [`CookedGeometry::save`] produces the same data as [`Geometry::save`],
+/// which [`System::load_geometry`] loads at runtime without building any polygons.
+#[derive(Debug, Clone, Default, PartialEq)]
+pub struct CookedGeometry {
+    /// The vertices of every polygon, back to back.
+    pub vertices: Vec<Vector>,
+    pub polygons: Vec<PolygonDesc>,
+}
+
+#[derive(Clone, Copy)]
+struct Triangle {
+    indices: [u32; 3],
+    normal: [c_float; 3],
+}
+
+fn sub(a: [c_float; 3], b: [c_float; 3]) -> [c_float; 3] {
+    [a[0] - b[0], a[1] - b[1], a[2] - b[2]]
+}
+
+fn cross(a: [c_float; 3], b: [c_float; 3]) -> [c_float; 3] {
+    [
+        a[1] * b[2] - a[2] * b[1],
+        a[2] * b[0] - a[0] * b[2],
+        a[0] * b[1] - a[1] * b[0],
+    ]
+}
+
+fn dot(a: [c_float; 3], b: [c_float; 3]) -> c_float {
+    a[0] * b[0] + a[1] * b[1] + a[2] * b[2]
+}
+
+fn to_array(v: Vector) -> [c_float; 3] {
+    [v.x, v.y, v.z]
+}
+
+impl CookedGeometry {
+    /// Cooks a triangle mesh. Every entry of `triangles` indexes into `vertices`, and out of range triangles are dropped.
+    pub fn cook(vertices: &[Vector], triangles: &[[u32; 3]], options: CookOptions) -> Self {
+        let (welded, remap) = weld(vertices, options.weld_distance);
+        let triangles = clean_triangles(&welded, &remap, triangles, options.threads);
+
+        let mut cooked = Self::default();
+        let polygon = |vertex_count| PolygonDesc {
+            vertex_count,
+            direct_occlusion: options.direct_occlusion,
+            reverb_occlusion: options.reverb_occlusion,
+            double_sided: options.double_sided,
+        };
+
+        // neighbours are found through their shared edge, which has the opposite direction in a consistently wound mesh
+        let mut edges = HashMap::with_capacity(triangles.len() * 3);
+        if options.merge_angle >= 0.0 {
+            for (i, triangle) in triangles.iter().enumerate() {
+                for edge in 0..3 {
+                    let from = triangle.indices[edge];
+                    let to = triangle.indices[(edge + 1) % 3];
+                    edges.insert((from, to), i);
+                }
+            }
+        }
+        let min_cos = options.merge_angle.cos();
+
+        let mut merged = vec![false; triangles.len()];
+        for (i, triangle) in triangles.iter().enumerate() {
+            if merged[i] {
+                continue;
+            }
+            merged[i] = true;
+
+            // merging across the longest edge first turns split quads back into quads,
+            // rather than pairing triangles of neighbouring quads into parallelograms
+            let points = triangle.indices.map(|v| to_array(welded[v as usize]));
+            let mut order = [0, 1, 2];
+            order.sort_by(|a, b| {
+                let length = |edge: usize| {
+                    let d = sub(points[(edge + 1) % 3], points[edge]);
+                    dot(d, d)
+                };
+                length(*b).total_cmp(&length(*a))
+            });
+            let quad = order.into_iter().find_map(|edge| {
+                let p = triangle.indices[edge];
+                let q = triangle.indices[(edge + 1) % 3];
+                let s = triangle.indices[(edge + 2) % 3];
+                let &j = edges.get(&(q, p))?;
+                if merged[j] || dot(triangle.normal, triangles[j].normal) < min_cos {
+                    return None;
+                }
+                let other = triangles[j].indices;
+                let r = other.into_iter().find(|v| *v != p && *v != q)?;
+                let quad = [p, r, q, s];
+                is_convex(&welded, quad, triangle.normal).then_some((j, quad))
+            });
+
+            if let Some((j, quad)) = quad {
+                merged[j] = true;
+                cooked
+                    .vertices
+                    .extend(quad.iter().map(|v| welded[*v as usize]));
+                cooked.polygons.push(polygon(4));
+            } else {
+                cooked
+                    .vertices
+                    .extend(triangle.indices.iter().map(|v| welded[*v as usize]));
+                cooked.polygons.push(polygon(3));
+            }
+        }
+        cooked
+    }
+
+    /// Number of vertices a [`Geometry`] needs to hold this.
+    pub fn vertex_count(&self) -> usize {
+        self.vertices.len()
+    }
+
+    pub fn polygon_count(&self) -> usize {
+        self.polygons.len()
+    }
+
+    /// Creates a [`Geometry`] sized for this and adds every polygon to it.
+    pub fn build(&self, system: &System) -> Result<Geometry> {
+        let geometry =
+            system.create_geometry(self.polygons.len() as c_int, self.vertices.len() as c_int)?;
+        if let Err(e) = geometry.add_polygons_bulk(&self.vertices, &self.polygons) {
+            let _ = geometry.release();
+            return Err(e);
+        }
+        Ok(geometry)
+    }
+
+    /// Serializes this in the [`Geometry::save`] format, for [`System::load_geometry`].
+    ///
+    /// FMOD's format is not documented, so this builds a temporary [`Geometry`] and saves it.
+    pub fn save(&self, system: &System) -> Result<Vec<u8>> {
+        let geometry = self.build(system)?;
+        let data = geometry.save();
+        geometry.release()?;
+        data
+    }
+}
+
+// snaps vertices to a grid of `distance` cells, returning the unique vertices and where every input vertex ended up
+fn weld(vertices: &[Vector], distance: c_float) -> (Vec<Vector>, Vec<u32>) {
+    let mut unique = Vec::with_capacity(vertices.len());
+    let mut remap = Vec::with_capacity(vertices.len());
+    let mut cells = HashMap::with_capacity(vertices.len());
+    for vertex in vertices {
+        let key = if distance > 0.0 {
+            let cell = |v: c_float| (v / distance).round() as i64;
+            [cell(vertex.x), cell(vertex.y), cell(vertex.z)]
+        } else {
+            // -0.0 and 0.0 are the same position
+            let bits = |v: c_float| i64::from((v + 0.0).to_bits());
+            [bits(vertex.x), bits(vertex.y), bits(vertex.z)]
+        };
+        let index = *cells.entry(key).or_insert_with(|| {
+            unique.push(*vertex);
+            unique.len() as u32 - 1
+        });
+        remap.push(index);
+    }
+    (unique, remap)
+}
+
+fn clean_triangles(
+    vertices: &[Vector],
+    remap: &[u32],
+    triangles: &[[u32; 3]],
+    threads: usize,
+) -> Vec<Triangle> {
+    let clean = |triangles: &[[u32; 3]]| {
+        let mut cleaned = Vec::with_capacity(triangles.len());
+        for triangle in triangles {
+            let remapped = triangle.map(|v| remap.get(v as usize).copied());
+            let [Some(a), Some(b), Some(c)] = remapped else {
+                continue;
+            };
+            let indices = [a, b, c];
+            if indices[0] == indices[1] || indices[1] == indices[2] || indices[0] == indices[2] {
+                continue;
+            }
+            let [a, b, c] = indices.map(|v| to_array(vertices[v as usize]));
+            let normal = cross(sub(b, a), sub(c, a));
+            let length = dot(normal, normal).sqrt();
+            // zero area, fmod would ignore it anyway
+            if length <= c_float::EPSILON {
+                continue;
+            }
+            cleaned.push(Triangle {
+                indices,
+                normal: normal.map(|n| n / length),
+            });
+        }
+        cleaned
+    };
+
+    let threads = match threads {
+        0 => std::thread::available_parallelism().map_or(1, std::num::NonZeroUsize::get),
+        threads => threads,
+    };
+    // not worth spawning threads for small meshes
+    if threads == 1 || triangles.len() < 4096 {
+        return clean(triangles);
+    }
+
+    let chunk_size = triangles.len().div_ceil(threads);
+    std::thread::scope(|scope| {
+        let handles: Vec<_> = triangles
+            .chunks(chunk_size)
+            .map(|chunk| scope.spawn(move || clean(chunk)))
+            .collect();
+        // joining in order keeps the output deterministic
+        let mut cleaned = Vec::with_capacity(triangles.len());
+        for handle in handles {
+            cleaned.extend(handle.join().unwrap());
+        }
+        cleaned
+    })
+}
+
+fn is_convex(vertices: &[Vector], polygon: [u32; 4], normal: [c_float; 3]) -> bool {
+    let points = polygon.map(|v| to_array(vertices[v as usize]));
+    (0..4).all(|i| {
+        let a = points[i];
+        let b = points[(i + 1) % 4];
+        let c = points[(i + 2) % 4];
+        dot(cross(sub(b, a), sub(c, b)), normal) > 0.0
+    })
+}
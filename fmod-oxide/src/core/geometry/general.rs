@@ -20,6 +20,8 @@ impl Geometry {
     ///
     /// Vertices of an object are in object space, not world space, and so are relative to the position, or center of the object.
     /// See [`Geometry::setP_psition`].
+    ///
+    /// To add a whole mesh, see [`Geometry::add_polygons_bulk`] and [`crate::CookedGeometry`].
     pub fn add_polygon(
         &self,
         direct_occlusion: c_float,
@@ -152,4 +154,17 @@ impl Geometry {
         let pointer = self.get_raw_userdata()?;
         Ok(get_userdata(pointer.into()))
     }
+
+    /// Runs `f` with a borrow of the userdata, without cloning the [`std::sync::Arc`].
+    ///
+    /// This never blocks, even while another thread is setting or removing userdata.
+    pub fn with_userdata<R>(
+        &self,
+        f: impl FnOnce(&crate::userdata::Userdata) -> R,
+    ) -> Result<Option<R>> {
+        use crate::userdata::with_userdata;
+
+        let pointer = self.get_raw_userdata()?;
+        Ok(with_userdata(pointer.into(), f))
+    }
 }
@@ -6,9 +6,13 @@
 
 use fmod_sys::*;
 
+mod bulk;
+mod cooking;
 mod general;
 mod polygons;
 mod spatialization;
+pub use bulk::PolygonDesc;
+pub use cooking::{CookOptions, CookedGeometry};
 
 #[derive(Debug, Clone, Copy, PartialEq, Eq, Hash)]
 #[repr(transparent)] // so we can transmute between types
@@ -6,12 +6,33 @@
 
 use fmod_sys::*;
 use lanyard::Utf8CString;
+use std::ffi::{c_char, c_int};
+
+// long enough for nearly every name and path, so most calls never need to grow the buffer.
+const STRING_BUFFER_LEN: usize = 256;
+
+fn nul_position(buffer: &[u8]) -> usize {
+    buffer.iter().position(|&b| b == 0).expect(
+        "fmod-oxide expected a null-terminated string but did not get one! THIS IS A VERY BAD BUG!",
+    )
+}
 
 pub(crate) fn get_string(
     mut string_fn: impl FnMut(&mut [u8]) -> FMOD_RESULT,
 ) -> Result<Utf8CString> {
-    let mut buffer = vec![0u8; 256];
-    // Initial call to get the string.
+    // Try a buffer on the stack first, so in the common case the only allocation is the returned string.
+    let mut stack_buffer = [0u8; STRING_BUFFER_LEN];
+    let result = string_fn(&mut stack_buffer);
+    if !matches!(result, FMOD_RESULT::FMOD_ERR_TRUNCATED) {
+        result.to_result()?;
+        // We add 1 to include the null terminator.
+        let len = nul_position(&stack_buffer) + 1;
+        let string =
+            unsafe { Utf8CString::from_utf8_with_nul_unchecked(stack_buffer[..len].to_vec()) };
+        return Ok(string);
+    }
+
+    let mut buffer = vec![0u8; STRING_BUFFER_LEN * 2];
     let mut result = string_fn(&mut buffer);
     // If the buffer is too small, resize it and try again.
     while let FMOD_RESULT::FMOD_ERR_TRUNCATED = result {
@@ -21,9 +42,7 @@ pub(crate) fn get_string(
 
     result.to_result()?;
 
-    let len = buffer.iter().position(|&b| b == 0).expect(
-        "fmod-oxide expected a null-terminated string but did not get one! THIS IS A VERY BAD BUG!",
-    );
+    let len = nul_position(&buffer);
     // Resize to make sure we don't waste memory.
     // We add 1 to include the null terminator.
     buffer.truncate(len + 1);
@@ -32,6 +51,76 @@ pub(crate) fn get_string(
     Ok(string)
 }
 
+// takes the allocation out of `string` to use as a zeroed buffer of at least `STRING_BUFFER_LEN` bytes.
+fn take_buffer(string: &mut String) -> Vec<u8> {
+    let mut buffer = std::mem::take(string).into_bytes();
+    let len = buffer.capacity().max(STRING_BUFFER_LEN);
+    buffer.clear();
+    buffer.resize(len, 0);
+    buffer
+}
+
+// puts the buffer back into `string`, keeping its allocation for the next call.
+fn restore_buffer(string: &mut String, mut buffer: Vec<u8>, result: FMOD_RESULT) -> Result<()> {
+    let len = if matches!(result, FMOD_RESULT::FMOD_OK) {
+        nul_position(&buffer)
+    } else {
+        0
+    };
+    buffer.truncate(len);
+    // all public fmod apis return UTF-8 strings. this should be safe.
+    *string = unsafe { String::from_utf8_unchecked(buffer) };
+    result.to_result()
+}
+
+/// Like [`get_string`], but writes into `string`, reusing its allocation.
+///
+/// Once `string` has grown large enough this does not allocate.
+pub(crate) fn get_string_into(
+    string: &mut String,
+    mut string_fn: impl FnMut(&mut [u8]) -> FMOD_RESULT,
+) -> Result<()> {
+    let mut buffer = take_buffer(string);
+    let mut result = string_fn(&mut buffer);
+    while let FMOD_RESULT::FMOD_ERR_TRUNCATED = result {
+        buffer.resize(buffer.len() * 2, 0);
+        result = string_fn(&mut buffer);
+    }
+    restore_buffer(string, buffer, result)
+}
+
+/// [`get_string_into`] for the studio functions that also return the length they need, via `retrieved`.
+///
+/// Unlike the owned studio getters this does not query the length first,
+/// so when `string` is large enough it only makes a single FFI call.
+pub(crate) fn get_string_retrieved_into(
+    string: &mut String,
+    mut string_fn: impl FnMut(*mut c_char, c_int, &mut c_int) -> FMOD_RESULT,
+) -> Result<()> {
+    let mut buffer = take_buffer(string);
+    let mut retrieved = 0;
+    let mut result = string_fn(
+        buffer.as_mut_ptr().cast(),
+        buffer.len() as c_int,
+        &mut retrieved,
+    );
+    while let FMOD_RESULT::FMOD_ERR_TRUNCATED = result {
+        // retrieved includes the null terminator
+        let len = if retrieved as usize > buffer.len() {
+            retrieved as usize
+        } else {
+            buffer.len() * 2
+        };
+        buffer.resize(len, 0);
+        result = string_fn(
+            buffer.as_mut_ptr().cast(),
+            buffer.len() as c_int,
+            &mut retrieved,
+        );
+    }
+    restore_buffer(string, buffer, result)
+}
+
 pub(crate) fn string_from_utf16_le(utf16: &[u16]) -> String {
     let iter = utf16.iter().copied().map(u16::from_le);
     // we use char::decode_utf16 instead of String::from_utf16 because the latter would require us to collect into a Vec<u16> first
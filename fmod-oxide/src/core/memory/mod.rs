@@ -0,0 +1,336 @@
+// Copyright (c) 2024 Lily Lyons
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+use fmod_sys::*;
+use std::{
+    alloc::{GlobalAlloc, Layout},
+    ffi::{c_char, c_int, c_uint, c_void},
+    sync::atomic::{AtomicPtr, AtomicUsize, Ordering},
+};
+
+mod slab;
+pub use slab::*;
+
+#[derive(PartialEq, Eq, Debug)]
+pub enum MemoryType {
+    Pool(&'static mut [u8]),
+    Callback {
+        alloc: unsafe extern "C" fn(
+            size: c_uint,
+            type_: FMOD_MEMORY_TYPE,
+            sourcestr: *const c_char,
+        ) -> *mut c_void,
+        realloc: FMOD_MEMORY_REALLOC_CALLBACK,
+        free: unsafe extern "C" fn(
+            ptr: *mut c_void,
+            type_: FMOD_MEMORY_TYPE,
+            sourcestr: *const c_char,
+        ),
+    },
+}
+
+bitflags::bitflags! {
+    #[derive(Debug, Clone, Copy, PartialEq, Eq, PartialOrd, Ord)]
+    pub struct MemoryFlags: FMOD_MEMORY_TYPE {
+      const NORMAL         = FMOD_MEMORY_NORMAL;
+      const STREAM_FILE    = FMOD_MEMORY_STREAM_FILE;
+      const STREAM_DECODE  = FMOD_MEMORY_STREAM_DECODE;
+      const SAMPLEDATA     = FMOD_MEMORY_SAMPLEDATA;
+      const DSP_BUFFER     = FMOD_MEMORY_DSP_BUFFER;
+      const PLUGIN         = FMOD_MEMORY_PLUGIN;
+      const PERSISTENT     = FMOD_MEMORY_PERSISTENT;
+      const ALL            = FMOD_MEMORY_ALL;
+    }
+}
+
+impl From<FMOD_MEMORY_TYPE> for MemoryFlags {
+    fn from(value: FMOD_MEMORY_TYPE) -> Self {
+        MemoryFlags::from_bits_truncate(value)
+    }
+}
+
+impl From<MemoryFlags> for FMOD_MEMORY_TYPE {
+    fn from(value: MemoryFlags) -> Self {
+        value.bits()
+    }
+}
+
+/// Specifies a method for FMOD to allocate and free memory, either through user supplied callbacks or through a user supplied memory buffer with a fixed size.
+///
+/// See [`memory_initialize_with`] to use a Rust allocator instead.
+///
+/// # Safety
+///
+/// This function must be called before any FMOD System object is created.
+///
+/// If [`MemoryType::Callback::alloc`] and [`MemoryType::Callback::free`] are provided without [`MemoryType::Callback::realloc`]
+/// the reallocation is implemented via an allocation of the new size, copy from old address to new, then a free of the old address.
+///
+/// Callback implementations must be thread safe.
+///
+/// If you specify a fixed size pool that is too small, FMOD will return [`FMOD_RESULT::FMOD_ERR_MEMORY`] when the limit of the fixed size pool is exceeded.
+/// At this point, it's possible that FMOD may become unstable. To maintain stability, do not allow FMOD to run out of memory.
+/// To find out the required fixed size call [`memory_initialize`] with an overly large pool size (or no pool) and find out the maximum RAM usage at any one time with [`memory_get_stats`].
+/// The size of the pool is limited to [`c_int::MAX`].
+pub unsafe fn memory_initialize(memory_type: MemoryType, flags: MemoryFlags) -> Result<()> {
+    match memory_type {
+        MemoryType::Pool(pool) => unsafe {
+            FMOD_Memory_Initialize(
+                pool.as_mut_ptr().cast(),
+                pool.len() as c_int,
+                None,
+                None,
+                None,
+                flags.into(),
+            )
+            .to_result()
+        },
+        MemoryType::Callback {
+            alloc,
+            realloc,
+            free,
+        } => unsafe {
+            FMOD_Memory_Initialize(
+                std::ptr::null_mut(),
+                0,
+                Some(alloc),
+                realloc,
+                Some(free),
+                flags.into(),
+            )
+            .to_result()
+        },
+    }
+}
+
+/// Returns information on the memory usage of FMOD.
+///
+/// This information is byte accurate and counts all allocs and frees internally.
+/// This is useful for determining a fixed memory size to make FMOD work within for fixed memory machines such as consoles.
+///
+/// Note that if using [`memory_initialize`], the memory usage will be slightly higher than without it, as FMOD has to have a small amount of memory overhead to manage the available memory.
+pub fn memory_get_stats(blocking: bool) -> Result<(c_int, c_int)> {
+    let mut current = 0;
+    let mut max = 0;
+    unsafe {
+        FMOD_Memory_GetStats(&mut current, &mut max, blocking.into()).to_result()?;
+    }
+    Ok((current, max))
+}
+
+/// Routes every FMOD allocation through a Rust [`GlobalAlloc`], and tracks memory usage per [`MemoryFlags`] type.
+///
+/// The usage can be retrieved with [`memory_get_type_stats`].
+/// Each allocation carries a 16 byte header recording its size and type, because FMOD does not pass sizes when freeing memory.
+/// Pair this with a [`SlabAllocator`] for fragmentation free allocation on fixed memory targets.
+///
+/// # Safety
+///
+/// This function must be called before any FMOD System object is created, and only once.
+///
+/// `flags` can be used to only route some memory types through `allocator`.
+pub unsafe fn memory_initialize_with<A: GlobalAlloc + Sync>(
+    allocator: &'static A,
+    flags: MemoryFlags,
+) -> Result<()> {
+    ALLOCATOR.store(
+        std::ptr::from_ref(allocator).cast_mut().cast(),
+        Ordering::Release,
+    );
+    unsafe {
+        FMOD_Memory_Initialize(
+            std::ptr::null_mut(),
+            0,
+            Some(alloc_impl::<A>),
+            Some(realloc_impl::<A>),
+            Some(free_impl::<A>),
+            flags.into(),
+        )
+        .to_result()
+    }
+}
+
+/// Memory usage of a single memory type, see [`MemoryTypeStats`].
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Default)]
+pub struct MemoryUsage {
+    /// Bytes currently allocated.
+    pub current: usize,
+    /// The most bytes that have been allocated at once.
+    pub max: usize,
+    /// Number of live allocations.
+    pub allocations: usize,
+}
+
+/// Memory usage of FMOD broken down by type, returned by [`memory_get_type_stats`].
+///
+/// Sizes do not include the per-allocation header.
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Default)]
+pub struct MemoryTypeStats {
+    /// Allocations that have no more specific type, see [`MemoryFlags::NORMAL`].
+    pub normal: MemoryUsage,
+    /// Stream file buffers, see [`MemoryFlags::STREAM_FILE`].
+    pub stream_file: MemoryUsage,
+    /// Stream decode buffers, see [`MemoryFlags::STREAM_DECODE`].
+    pub stream_decode: MemoryUsage,
+    /// Sample data, see [`MemoryFlags::SAMPLEDATA`].
+    pub sample_data: MemoryUsage,
+    /// DSP buffers, see [`MemoryFlags::DSP_BUFFER`].
+    pub dsp_buffer: MemoryUsage,
+    /// Plugin allocations, see [`MemoryFlags::PLUGIN`].
+    pub plugin: MemoryUsage,
+}
+
+/// Returns the memory usage of FMOD per memory type.
+///
+/// Only allocations made through [`memory_initialize_with`] are counted.
+/// Types are exclusive, an allocation is counted under the first type it matches in the order of [`MemoryTypeStats`]'s fields, excluding [`MemoryFlags::NORMAL`].
+pub fn memory_get_type_stats() -> MemoryTypeStats {
+    let usage = |category: usize| {
+        let counter = &USAGE[category];
+        MemoryUsage {
+            current: counter.current.load(Ordering::Relaxed),
+            max: counter.max.load(Ordering::Relaxed),
+            allocations: counter.allocations.load(Ordering::Relaxed),
+        }
+    };
+    MemoryTypeStats {
+        normal: usage(0),
+        stream_file: usage(1),
+        stream_decode: usage(2),
+        sample_data: usage(3),
+        dsp_buffer: usage(4),
+        plugin: usage(5),
+    }
+}
+
+static ALLOCATOR: AtomicPtr<()> = AtomicPtr::new(std::ptr::null_mut());
+
+struct UsageCounter {
+    current: AtomicUsize,
+    max: AtomicUsize,
+    allocations: AtomicUsize,
+}
+
+static USAGE: [UsageCounter; 6] = {
+    const EMPTY: UsageCounter = UsageCounter {
+        current: AtomicUsize::new(0),
+        max: AtomicUsize::new(0),
+        allocations: AtomicUsize::new(0),
+    };
+    [EMPTY; 6]
+};
+
+fn category(kind: FMOD_MEMORY_TYPE) -> usize {
+    [
+        FMOD_MEMORY_STREAM_FILE,
+        FMOD_MEMORY_STREAM_DECODE,
+        FMOD_MEMORY_SAMPLEDATA,
+        FMOD_MEMORY_DSP_BUFFER,
+        FMOD_MEMORY_PLUGIN,
+    ]
+    .iter()
+    .position(|flag| kind & flag != 0)
+    .map_or(0, |index| index + 1)
+}
+
+fn record_alloc(kind: FMOD_MEMORY_TYPE, size: usize) {
+    let counter = &USAGE[category(kind)];
+    let current = counter.current.fetch_add(size, Ordering::Relaxed) + size;
+    counter.max.fetch_max(current, Ordering::Relaxed);
+    counter.allocations.fetch_add(1, Ordering::Relaxed);
+}
+
+fn record_free(kind: FMOD_MEMORY_TYPE, size: usize) {
+    let counter = &USAGE[category(kind)];
+    counter.current.fetch_sub(size, Ordering::Relaxed);
+    counter.allocations.fetch_sub(1, Ordering::Relaxed);
+}
+
+// sits in front of every allocation, and keeps the allocation aligned to HEADER_SIZE
+#[repr(C)]
+struct AllocationHeader {
+    size: usize,
+    kind: FMOD_MEMORY_TYPE,
+}
+
+// FMOD expects 16 byte aligned memory
+const HEADER_SIZE: usize = 16;
+const _: () = assert!(std::mem::size_of::<AllocationHeader>() <= HEADER_SIZE);
+
+fn allocation_layout(size: usize) -> Option<Layout> {
+    Layout::from_size_align(size.checked_add(HEADER_SIZE)?, HEADER_SIZE).ok()
+}
+
+unsafe fn allocator<'a, A>() -> &'a A {
+    unsafe { &*ALLOCATOR.load(Ordering::Acquire).cast::<A>() }
+}
+
+unsafe extern "C" fn alloc_impl<A: GlobalAlloc>(
+    size: c_uint,
+    kind: FMOD_MEMORY_TYPE,
+    _source: *const c_char,
+) -> *mut c_void {
+    let size = size as usize;
+    let Some(layout) = allocation_layout(size) else {
+        return std::ptr::null_mut();
+    };
+    let ptr = unsafe { allocator::<A>().alloc(layout) };
+    if ptr.is_null() {
+        return std::ptr::null_mut();
+    }
+    unsafe {
+        ptr.cast::<AllocationHeader>()
+            .write(AllocationHeader { size, kind });
+    }
+    record_alloc(kind, size);
+    unsafe { ptr.add(HEADER_SIZE).cast() }
+}
+
+unsafe extern "C" fn realloc_impl<A: GlobalAlloc>(
+    ptr: *mut c_void,
+    size: c_uint,
+    kind: FMOD_MEMORY_TYPE,
+    source: *const c_char,
+) -> *mut c_void {
+    if ptr.is_null() {
+        return unsafe { alloc_impl::<A>(size, kind, source) };
+    }
+    let new_size = size as usize;
+    let Some(new_layout) = allocation_layout(new_size) else {
+        return std::ptr::null_mut();
+    };
+    let base = unsafe { ptr.cast::<u8>().sub(HEADER_SIZE) };
+    let header = unsafe { base.cast::<AllocationHeader>().read() };
+    let layout = allocation_layout(header.size).unwrap();
+
+    let new_base = unsafe { allocator::<A>().realloc(base, layout, new_layout.size()) };
+    if new_base.is_null() {
+        return std::ptr::null_mut();
+    }
+    unsafe {
+        new_base.cast::<AllocationHeader>().write(AllocationHeader {
+            size: new_size,
+            kind,
+        });
+    }
+    record_free(header.kind, header.size);
+    record_alloc(kind, new_size);
+    unsafe { new_base.add(HEADER_SIZE).cast() }
+}
+
+unsafe extern "C" fn free_impl<A: GlobalAlloc>(
+    ptr: *mut c_void,
+    _kind: FMOD_MEMORY_TYPE,
+    _source: *const c_char,
+) {
+    if ptr.is_null() {
+        return;
+    }
+    let base = unsafe { ptr.cast::<u8>().sub(HEADER_SIZE) };
+    let header = unsafe { base.cast::<AllocationHeader>().read() };
+    unsafe { allocator::<A>().dealloc(base, allocation_layout(header.size).unwrap()) };
+    record_free(header.kind, header.size);
+}
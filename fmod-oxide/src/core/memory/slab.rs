@@ -0,0 +1,192 @@
+// Copyright (c) 2024 Lily Lyons
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+use std::{
+    alloc::{GlobalAlloc, Layout},
+    ptr::null_mut,
+    sync::{
+        atomic::{AtomicUsize, Ordering},
+        Mutex, PoisonError,
+    },
+};
+
+// block sizes grow by 1.5x/1.33x, so at most a third of a block is wasted
+const SIZE_CLASSES: [usize; 16] = [
+    16, 32, 48, 64, 96, 128, 192, 256, 384, 512, 768, 1024, 1536, 2048, 3072, 4096,
+];
+/// Every block is aligned to this, which matches what FMOD expects from its allocator.
+pub const SLAB_ALIGNMENT: usize = 16;
+/// Allocations larger than this are passed straight to the backing allocator.
+pub const SLAB_MAX_BLOCK_SIZE: usize = SIZE_CLASSES[SIZE_CLASSES.len() - 1];
+/// Size of the chunks a [`SlabAllocator`] requests from its backing allocator.
+pub const SLAB_CHUNK_SIZE: usize = 64 * 1024;
+
+/// A size class allocator for small allocations, suitable for [`super::memory_initialize_with`].
+///
+/// Allocations up to [`SLAB_MAX_BLOCK_SIZE`] bytes are rounded up to one of 16 size classes.
+/// Each class carves its blocks out of [`SLAB_CHUNK_SIZE`] chunks from the backing allocator, and reuses freed blocks of the same class.
+/// Memory held by a class is never returned to the backing allocator or shared with other classes,
+/// so the high water mark of each class bounds its memory use and the backing allocator is never fragmented by small allocations.
+///
+/// Each class has its own lock, which is only held for a couple of pointer operations.
+///
+/// ```rust,ignore
+/// static FMOD_ALLOCATOR: fmod::memory::SlabAllocator = fmod::memory::SlabAllocator::new(std::alloc::System);
+///
+/// unsafe { fmod::memory::memory_initialize_with(&FMOD_ALLOCATOR, fmod::MemoryFlags::ALL)? };
+/// ```
+pub struct SlabAllocator<A: GlobalAlloc = std::alloc::System> {
+    backing: A,
+    classes: [Mutex<SizeClass>; SIZE_CLASSES.len()],
+    reserved: AtomicUsize,
+    large: AtomicUsize,
+}
+
+struct SizeClass {
+    // freed blocks, each storing the pointer to the next one
+    free: *mut FreeBlock,
+    // the unused end of the chunk this class is carving blocks from
+    bump: *mut u8,
+    remaining: usize,
+}
+
+struct FreeBlock {
+    next: *mut FreeBlock,
+}
+
+// the pointers are only touched while the class is locked
+unsafe impl Send for SizeClass {}
+
+impl<A: GlobalAlloc> SlabAllocator<A> {
+    pub const fn new(backing: A) -> Self {
+        const EMPTY: Mutex<SizeClass> = Mutex::new(SizeClass {
+            free: null_mut(),
+            bump: null_mut(),
+            remaining: 0,
+        });
+        Self {
+            backing,
+            classes: [EMPTY; SIZE_CLASSES.len()],
+            reserved: AtomicUsize::new(0),
+            large: AtomicUsize::new(0),
+        }
+    }
+
+    /// Bytes requested from the backing allocator for size class chunks.
+    pub fn reserved_bytes(&self) -> usize {
+        self.reserved.load(Ordering::Relaxed)
+    }
+
+    /// Bytes currently allocated from the backing allocator for allocations larger than [`SLAB_MAX_BLOCK_SIZE`].
+    pub fn large_bytes(&self) -> usize {
+        self.large.load(Ordering::Relaxed)
+    }
+
+    fn class_index(layout: Layout) -> Option<usize> {
+        if layout.align() > SLAB_ALIGNMENT {
+            return None;
+        }
+        SIZE_CLASSES.iter().position(|&size| layout.size() <= size)
+    }
+
+    unsafe fn alloc_block(&self, index: usize) -> *mut u8 {
+        let size = SIZE_CLASSES[index];
+        let mut class = self.classes[index]
+            .lock()
+            .unwrap_or_else(PoisonError::into_inner);
+
+        if !class.free.is_null() {
+            let block = class.free;
+            class.free = unsafe { (*block).next };
+            return block.cast();
+        }
+
+        if class.remaining < size {
+            let chunk_layout =
+                unsafe { Layout::from_size_align_unchecked(SLAB_CHUNK_SIZE, SLAB_ALIGNMENT) };
+            let chunk = unsafe { self.backing.alloc(chunk_layout) };
+            if chunk.is_null() {
+                return null_mut();
+            }
+            self.reserved.fetch_add(SLAB_CHUNK_SIZE, Ordering::Relaxed);
+            // the tail of the previous chunk is smaller than a block, so it is dropped
+            class.bump = chunk;
+            class.remaining = SLAB_CHUNK_SIZE;
+        }
+
+        let block = class.bump;
+        class.bump = unsafe { class.bump.add(size) };
+        class.remaining -= size;
+        block
+    }
+
+    unsafe fn free_block(&self, index: usize, ptr: *mut u8) {
+        let block = ptr.cast::<FreeBlock>();
+        let mut class = self.classes[index]
+            .lock()
+            .unwrap_or_else(PoisonError::into_inner);
+        unsafe { (*block).next = class.free };
+        class.free = block;
+    }
+}
+
+impl Default for SlabAllocator {
+    fn default() -> Self {
+        Self::new(std::alloc::System)
+    }
+}
+
+unsafe impl<A: GlobalAlloc> GlobalAlloc for SlabAllocator<A> {
+    unsafe fn alloc(&self, layout: Layout) -> *mut u8 {
+        match Self::class_index(layout) {
+            Some(index) => unsafe { self.alloc_block(index) },
+            None => {
+                let ptr = unsafe { self.backing.alloc(layout) };
+                if !ptr.is_null() {
+                    self.large.fetch_add(layout.size(), Ordering::Relaxed);
+                }
+                ptr
+            }
+        }
+    }
+
+    unsafe fn dealloc(&self, ptr: *mut u8, layout: Layout) {
+        match Self::class_index(layout) {
+            Some(index) => unsafe { self.free_block(index, ptr) },
+            None => {
+                unsafe { self.backing.dealloc(ptr, layout) };
+                self.large.fetch_sub(layout.size(), Ordering::Relaxed);
+            }
+        }
+    }
+
+    unsafe fn realloc(&self, ptr: *mut u8, layout: Layout, new_size: usize) -> *mut u8 {
+        let new_layout = unsafe { Layout::from_size_align_unchecked(new_size, layout.align()) };
+        let (old_class, new_class) = (Self::class_index(layout), Self::class_index(new_layout));
+        match (old_class, new_class) {
+            // the block already fits
+            (Some(old), Some(new)) if old == new => ptr,
+            (None, None) => {
+                let new_ptr = unsafe { self.backing.realloc(ptr, layout, new_size) };
+                if !new_ptr.is_null() {
+                    self.large.fetch_add(new_size, Ordering::Relaxed);
+                    self.large.fetch_sub(layout.size(), Ordering::Relaxed);
+                }
+                new_ptr
+            }
+            _ => {
+                let new_ptr = unsafe { self.alloc(new_layout) };
+                if !new_ptr.is_null() {
+                    unsafe {
+                        std::ptr::copy_nonoverlapping(ptr, new_ptr, layout.size().min(new_size));
+                        self.dealloc(ptr, layout);
+                    }
+                }
+                new_ptr
+            }
+        }
+    }
+}
@@ -34,6 +34,9 @@ pub use dsp::*;
 mod dsp_connection;
 pub use dsp_connection::*;
 
+mod dsp_plugin;
+pub use dsp_plugin::*;
+
 mod flags;
 pub use flags::*;
 
@@ -45,6 +48,7 @@ mod structs;
 pub use structs::*;
 
 pub mod debug;
+pub mod dsp_kernels;
 pub mod file;
 pub mod memory;
 pub mod thread;
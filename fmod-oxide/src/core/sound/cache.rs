@@ -0,0 +1,356 @@
+// Copyright (c) 2024 Lily Lyons
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+use fmod_sys::*;
+use lanyard::Utf8CString;
+use std::{
+    collections::{HashMap, HashSet},
+    ffi::c_int,
+    sync::Arc,
+};
+
+use crate::{Mode, OpenState, Sound, SoundBuilder, SoundFormat, System, TimeUnit};
+
+/// What a [`SoundCache`] entry is looked up by: a normalized path, the [`Mode`] and, for raw files, the format.
+///
+/// Two keys that would make FMOD load the same data compare equal:
+/// `\` and `/` are the same separator and `.` and `..` components are resolved,
+/// and the mode defaults FMOD applies ([`Mode::LOOP_OFF`], [`Mode::D2`]) are filled in.
+/// [`Mode::NONBLOCKING`] is ignored, the cache always loads in the background.
+#[derive(Debug, Clone, PartialEq, Eq, Hash)]
+pub struct SoundKey {
+    path: Box<str>,
+    mode: FMOD_MODE,
+    raw_format: Option<(c_int, c_int, FMOD_SOUND_FORMAT)>,
+}
+
+fn normalize_path(path: &str) -> String {
+    let path = path.replace('\\', "/");
+    let absolute = path.starts_with('/');
+    let mut components: Vec<&str> = Vec::new();
+    for component in path.split('/') {
+        match component {
+            "" | "." => {}
+            ".." if components.last().is_some_and(|last| *last != "..") => {
+                components.pop();
+            }
+            // a relative path can go above its start, an absolute one can't
+            ".." if absolute => {}
+            component => components.push(component),
+        }
+    }
+    let joined = components.join("/");
+    if path.starts_with("//") {
+        // a windows network share
+        format!("//{joined}")
+    } else if absolute {
+        format!("/{joined}")
+    } else {
+        joined
+    }
+}
+
+impl SoundKey {
+    pub fn new(path: &str, mode: Mode) -> Self {
+        const IGNORED: Mode = Mode::NONBLOCKING
+            .union(Mode::OPEN_MEMORY)
+            .union(Mode::OPEN_MEMORY_POINT)
+            .union(Mode::OPEN_USER)
+            .union(Mode::OPEN_RAW);
+        let mut mode = mode.difference(IGNORED);
+        if !mode.intersects(Mode::LOOP_OFF | Mode::LOOP_NORMAL | Mode::LOOP_BIDI) {
+            mode |= Mode::LOOP_OFF;
+        }
+        if !mode.intersects(Mode::D2 | Mode::D3) {
+            mode |= Mode::D2;
+        }
+        Self {
+            path: normalize_path(path).into(),
+            mode: mode.bits(),
+            raw_format: None,
+        }
+    }
+
+    /// Opens the file as raw PCM data, see [`SoundBuilder::with_open_raw`].
+    #[must_use]
+    pub fn with_raw_format(
+        mut self,
+        channel_count: c_int,
+        default_frequency: c_int,
+        format: SoundFormat,
+    ) -> Self {
+        self.raw_format = Some((channel_count, default_frequency, format as _));
+        self
+    }
+
+    pub fn path(&self) -> &str {
+        &self.path
+    }
+
+    pub fn mode(&self) -> Mode {
+        self.mode.into()
+    }
+}
+
+#[derive(Debug)]
+struct Slot {
+    sound: Sound,
+    key: SoundKey,
+}
+
+/// A shared handle to a sound in a [`SoundCache`].
+///
+/// The sound is never evicted while a handle to it exists.
+/// The sound may still be loading, check [`CachedSound::is_ready`] before using it.
+#[derive(Debug, Clone)]
+pub struct CachedSound {
+    slot: Arc<Slot>,
+}
+
+impl CachedSound {
+    /// The cached sound. Don't release it, the cache owns it.
+    pub fn sound(&self) -> Sound {
+        self.slot.sound
+    }
+
+    pub fn key(&self) -> &SoundKey {
+        &self.slot.key
+    }
+
+    /// See [`Sound::get_open_state`].
+    pub fn open_state(&self) -> Result<OpenState> {
+        self.slot.sound.get_open_state().map(|(state, ..)| state)
+    }
+
+    /// Whether the sound has finished loading. Failed loads return their error.
+    pub fn is_ready(&self) -> Result<bool> {
+        match self.open_state()? {
+            OpenState::Loading | OpenState::Connecting => Ok(false),
+            OpenState::Error(error) => Err(error),
+            _ => Ok(true),
+        }
+    }
+}
+
+#[derive(Debug)]
+struct Entry {
+    slot: Arc<Slot>,
+    // only known once the sound has loaded
+    bytes: Option<usize>,
+    last_used: u64,
+}
+
+/// Shares sounds between everything that loads the same file, and keeps the memory they use under a budget.
+///
+/// [`SoundCache::load`] only creates a sound the first time a [`SoundKey`] is seen, and returns another handle to it after that.
+/// Sounds are opened with [`Mode::NONBLOCKING`], so loading never stalls the caller.
+/// [`SoundCache::update`] (call it once a frame) notices finished loads and works out how much memory they take,
+/// and when the total is over budget it releases the least recently loaded sounds that have no handles and aren't playing.
+///
+/// The memory of a sound is its decoded size, or its file size for [`Mode::CREATE_COMPRESSED_SAMPLE`].
+/// Streams only hold a small decode buffer and don't count towards the budget.
+/// Keep in mind a stream can only play once at a time, shared or not.
+///
+/// Dropping the cache releases every sound in it, even ones that still have handles or are playing.
+#[derive(Debug)]
+pub struct SoundCache {
+    system: System,
+    budget: usize,
+    used: usize,
+    entries: HashMap<SoundKey, Entry>,
+    tick: u64,
+}
+
+impl SoundCache {
+    /// Creates a cache on `system` that keeps at most `budget` bytes of sounds nothing is using.
+    pub fn new(system: System, budget: usize) -> Self {
+        Self {
+            system,
+            budget,
+            used: 0,
+            entries: HashMap::new(),
+            tick: 0,
+        }
+    }
+
+    pub fn budget(&self) -> usize {
+        self.budget
+    }
+
+    /// Changes the budget. Sounds over the new budget are evicted on the next [`SoundCache::update`].
+    pub fn set_budget(&mut self, budget: usize) {
+        self.budget = budget;
+    }
+
+    /// Bytes used by every loaded sound in the cache, in use or not.
+    pub fn used_bytes(&self) -> usize {
+        self.used
+    }
+
+    pub fn len(&self) -> usize {
+        self.entries.len()
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.entries.is_empty()
+    }
+
+    /// Number of sounds that are still loading.
+    pub fn loading_count(&self) -> usize {
+        self.entries.values().filter(|e| e.bytes.is_none()).count()
+    }
+
+    /// Returns a handle to the sound for `key`, creating it in the background if it isn't cached.
+    pub fn load(&mut self, key: &SoundKey) -> Result<CachedSound> {
+        self.tick += 1;
+        if let Some(entry) = self.entries.get_mut(key) {
+            entry.last_used = self.tick;
+            return Ok(CachedSound {
+                slot: entry.slot.clone(),
+            });
+        }
+
+        let path = Utf8CString::new(key.path.to_string())?;
+        let mut builder = SoundBuilder::open(&path).with_mode(key.mode() | Mode::NONBLOCKING);
+        if let Some((channel_count, default_frequency, format)) = key.raw_format {
+            builder = builder.with_open_raw(channel_count, default_frequency, format.try_into()?);
+        }
+        let sound = self.system.create_sound(&builder)?;
+
+        let slot = Arc::new(Slot {
+            sound,
+            key: key.clone(),
+        });
+        self.entries.insert(
+            key.clone(),
+            Entry {
+                slot: slot.clone(),
+                bytes: None,
+                last_used: self.tick,
+            },
+        );
+        Ok(CachedSound { slot })
+    }
+
+    /// Shorthand for [`SoundCache::load`] with [`SoundKey::new`].
+    pub fn load_path(&mut self, path: &str, mode: Mode) -> Result<CachedSound> {
+        self.load(&SoundKey::new(path, mode))
+    }
+
+    /// Accounts for sounds that finished loading, and evicts sounds if the cache is over budget.
+    ///
+    /// Sounds that failed to load are released and removed, so the next [`SoundCache::load`] tries again.
+    /// Handles to them keep returning errors. Returns the number of sounds evicted.
+    pub fn update(&mut self) -> Result<usize> {
+        let mut failed = Vec::new();
+        for (key, entry) in &mut self.entries {
+            if entry.bytes.is_some() {
+                continue;
+            }
+            let sound = entry.slot.sound;
+            match sound.get_open_state() {
+                Ok((OpenState::Loading | OpenState::Connecting, ..)) => {}
+                Ok((OpenState::Error(_), ..)) | Err(_) => failed.push(key.clone()),
+                Ok(_) => {
+                    let bytes = sound_bytes(sound, key.mode())?;
+                    entry.bytes = Some(bytes);
+                    self.used += bytes;
+                }
+            }
+        }
+        for key in failed {
+            if let Some(entry) = self.entries.remove(&key) {
+                let _ = entry.slot.sound.release();
+            }
+        }
+
+        if self.used > self.budget {
+            self.evict(Some(self.budget))
+        } else {
+            Ok(0)
+        }
+    }
+
+    /// Releases every sound that has no handles and isn't playing, whatever the budget. Returns the number of sounds released.
+    pub fn release_unused(&mut self) -> Result<usize> {
+        self.evict(None)
+    }
+
+    // evicts until the cache is under `budget`, or every unused sound without one
+    fn evict(&mut self, budget: Option<usize>) -> Result<usize> {
+        let playing = self.playing_sounds()?;
+        let mut candidates: Vec<_> = self
+            .entries
+            .iter()
+            .filter(|(_, entry)| {
+                // evicting streams doesn't get the cache under budget
+                entry
+                    .bytes
+                    .is_some_and(|bytes| bytes > 0 || budget.is_none())
+                    && Arc::strong_count(&entry.slot) == 1
+                    && !playing.contains(&entry.slot.sound)
+            })
+            .map(|(key, entry)| (entry.last_used, key.clone()))
+            .collect();
+        candidates.sort_unstable_by_key(|(last_used, _)| *last_used);
+
+        let mut evicted = 0;
+        for (_, key) in candidates {
+            if budget.is_some_and(|budget| self.used <= budget) {
+                break;
+            }
+            let Some(entry) = self.entries.remove(&key) else {
+                continue;
+            };
+            self.used -= entry.bytes.unwrap_or(0);
+            evicted += 1;
+            entry.slot.sound.release()?;
+        }
+        Ok(evicted)
+    }
+
+    // FMOD has no way to ask a sound if it's playing, so this looks at the sound of every playing channel
+    fn playing_sounds(&self) -> Result<HashSet<Sound>> {
+        let mut sounds = HashSet::new();
+        let mut groups = vec![self.system.get_master_channel_group()?];
+        while let Some(group) = groups.pop() {
+            for index in 0..group.get_channel_count()? {
+                // channels can stop while we look through them
+                let sound = group
+                    .get_channel(index)
+                    .and_then(|channel| channel.get_current_sound());
+                if let Ok(Some(sound)) = sound {
+                    sounds.insert(sound);
+                }
+            }
+            for index in 0..group.get_group_count()? {
+                groups.push(group.get_group(index)?);
+            }
+        }
+        Ok(sounds)
+    }
+}
+
+impl Drop for SoundCache {
+    fn drop(&mut self) {
+        // errors are ignored, the system may already have been released along with every sound
+        for (_, entry) in self.entries.drain() {
+            let _ = entry.slot.sound.release();
+        }
+    }
+}
+
+fn sound_bytes(sound: Sound, mode: Mode) -> Result<usize> {
+    if mode.contains(Mode::CREATE_STREAM) {
+        return Ok(0);
+    }
+    if mode.contains(Mode::CREATE_COMPRESSED_SAMPLE) {
+        return Ok(sound.get_length(TimeUnit::RawBytes)? as usize);
+    }
+    let (_, _, channels, bits) = sound.get_format()?;
+    let samples = sound.get_length(TimeUnit::PCM)? as usize;
+    Ok(samples * channels.max(1) as usize * (bits.max(8) as usize / 8))
+}
@@ -4,11 +4,15 @@
 // License, v. 2.0. If a copy of the MPL was not distributed with this
 // file, You can obtain one at https://mozilla.org/MPL/2.0/.
 
-use std::ffi::c_uint;
+use std::{
+    ffi::{c_uint, c_void},
+    io::{Read, Seek, SeekFrom},
+    marker::PhantomData,
+};
 
 use fmod_sys::*;
 
-use crate::{OpenState, Sound};
+use crate::{OpenState, Sound, TimeUnit};
 
 impl Sound {
     /// Retrieves the state a sound is in after being opened with the non blocking flag, or the current state of the streaming buffer.
@@ -44,5 +48,254 @@ impl Sound {
         Ok((open_state, percent_buffered, starving, disk_busy))
     }
 
-    // TODO read, seek, lock, unlock
+    /// Gives access to a portion or all the sample data of a sound for direct manipulation.
+    ///
+    /// With sample based sounds, the data is returned as the raw sample data, in the format reported by [`Sound::get_format`].
+    /// The data is exposed in place, without any copies, as two regions because the locked portion may wrap around the end of the sound's buffer.
+    /// The second region is empty if it does not.
+    ///
+    /// The sound is unlocked when the returned [`SoundLock`] is dropped, or with [`SoundLock::unlock`].
+    ///
+    /// Compressed sample sounds (loaded with [`crate::Mode::CREATE_COMPRESSED_SAMPLE`]) can't be locked.
+    ///
+    /// # Safety
+    ///
+    /// The returned regions are plain memory that nothing else synchronizes:
+    ///
+    /// - Only one lock of an overlapping region of this sound may exist at a time. [`Sound`] is [`Copy`],
+    ///   so another copy of the handle could lock the same data.
+    /// - FMOD must not write to the locked region while the lock is alive. For a stream the data is the stream's decode buffer,
+    ///   which FMOD overwrites as the stream plays, and for a sound being recorded into FMOD writes at the record position.
+    ///   Only lock those regions FMOD is not currently writing to.
+    pub unsafe fn lock(&self, offset: c_uint, length: c_uint) -> Result<SoundLock<'_>> {
+        let mut ptr1 = std::ptr::null_mut();
+        let mut ptr2 = std::ptr::null_mut();
+        let mut len1 = 0;
+        let mut len2 = 0;
+        unsafe {
+            FMOD_Sound_Lock(
+                self.inner, offset, length, &mut ptr1, &mut ptr2, &mut len1, &mut len2,
+            )
+            .to_result()?;
+        }
+        Ok(SoundLock {
+            sound: *self,
+            ptr1,
+            ptr2,
+            len1,
+            len2,
+            marker: PhantomData,
+        })
+    }
+
+    /// Reads data from an opened sound to a specified buffer, using FMOD's internal codecs.
+    ///
+    /// This can be used for decoding data offline in small pieces (or big pieces), rather than playing and capturing it,
+    /// or loading the whole file at once and having to [`Sound::lock`] / [`SoundLock::unlock`] the data.
+    /// The data is decoded in the format reported by [`Sound::get_format`].
+    ///
+    /// Returns the number of bytes read, which is less than `buffer.len()` (possibly 0) once the end of the sound is reached.
+    ///
+    /// If you are calling this function in a loop to decode a whole sound, it's recommended to open the sound with [`crate::Mode::OPEN_ONLY`],
+    /// so FMOD does not decode the start of the sound when it is opened, and to reuse one buffer between calls.
+    pub fn read_data(&self, buffer: &mut [u8]) -> Result<c_uint> {
+        unsafe { self.read_data_raw(buffer.as_mut_ptr(), buffer.len()) }
+    }
+
+    // FMOD only writes to the buffer, so it may be uninitialized
+    unsafe fn read_data_raw(&self, buffer: *mut u8, length: usize) -> Result<c_uint> {
+        let mut read = 0;
+        let length = length.min(c_uint::MAX as usize) as c_uint;
+        let result = unsafe { FMOD_Sound_ReadData(self.inner, buffer.cast(), length, &mut read) };
+        match result {
+            FMOD_RESULT::FMOD_OK | FMOD_RESULT::FMOD_ERR_FILE_EOF => Ok(read),
+            error => Err(error.into()),
+        }
+    }
+
+    /// Decodes the rest of the sound into `buffer`, appending to it, and returns the number of bytes appended.
+    ///
+    /// The buffer is grown to the decoded size of the sound up front, so reusing one buffer between sounds avoids reallocating.
+    pub fn read_data_to_end(&self, buffer: &mut Vec<u8>) -> Result<usize> {
+        let start = buffer.len();
+        let hint = self.get_length(TimeUnit::PCMBytes).unwrap_or(0) as usize;
+        buffer.reserve(hint.max(4096));
+        loop {
+            if buffer.len() == buffer.capacity() {
+                buffer.reserve(4096);
+            }
+            let spare = buffer.spare_capacity_mut();
+            // the spare capacity is uninitialized, so it's only handed to FMOD as a pointer
+            let read =
+                unsafe { self.read_data_raw(spare.as_mut_ptr().cast(), spare.len())? } as usize;
+            if read == 0 {
+                break;
+            }
+            unsafe { buffer.set_len(buffer.len() + read) };
+        }
+        Ok(buffer.len() - start)
+    }
+
+    /// Seeks a sound for use with data reading, using FMOD's internal codecs.
+    ///
+    /// `pcm` is the offset in PCM samples (frames) to seek to.
+    ///
+    /// For use in conjunction with [`Sound::read_data`] and [`crate::Mode::OPEN_ONLY`].
+    ///
+    /// For streaming sounds, if this function is called, it will advance the internal file pointer but not update the streaming engine.
+    /// This can lead to de-synchronization of position information for the stream and audible playback.
+    ///
+    /// A stream can reset its stream buffer and position synchronization by calling [`crate::Channel::set_position`].
+    /// This causes reset and flush of the stream buffer.
+    pub fn seek_data(&self, pcm: c_uint) -> Result<()> {
+        unsafe { FMOD_Sound_SeekData(self.inner, pcm).to_result() }
+    }
+
+    /// Creates an [`std::io::Read`] + [`std::io::Seek`] adapter that decodes this sound with [`Sound::read_data`].
+    pub fn reader(&self) -> Result<SoundReader> {
+        SoundReader::new(*self)
+    }
+}
+
+/// Locked sample data of a [`Sound`], created with [`Sound::lock`].
+///
+/// The sound is unlocked when this is dropped.
+#[derive(Debug)]
+pub struct SoundLock<'a> {
+    sound: Sound,
+    ptr1: *mut c_void,
+    ptr2: *mut c_void,
+    len1: c_uint,
+    len2: c_uint,
+    marker: PhantomData<&'a Sound>,
+}
+
+// the regions stay valid until the sound is unlocked
+unsafe fn region<'a>(ptr: *mut c_void, len: c_uint) -> &'a [u8] {
+    if ptr.is_null() || len == 0 {
+        &[]
+    } else {
+        unsafe { std::slice::from_raw_parts(ptr.cast(), len as usize) }
+    }
+}
+
+unsafe fn region_mut<'a>(ptr: *mut c_void, len: c_uint) -> &'a mut [u8] {
+    if ptr.is_null() || len == 0 {
+        &mut []
+    } else {
+        unsafe { std::slice::from_raw_parts_mut(ptr.cast(), len as usize) }
+    }
+}
+
+impl SoundLock<'_> {
+    /// The two locked regions of sample data.
+    pub fn data(&self) -> (&[u8], &[u8]) {
+        unsafe { (region(self.ptr1, self.len1), region(self.ptr2, self.len2)) }
+    }
+
+    /// The two locked regions of sample data, for writing.
+    pub fn data_mut(&mut self) -> (&mut [u8], &mut [u8]) {
+        unsafe {
+            (
+                region_mut(self.ptr1, self.len1),
+                region_mut(self.ptr2, self.len2),
+            )
+        }
+    }
+
+    /// Releases previous sample data lock from [`Sound::lock`].
+    ///
+    /// Dropping the lock also unlocks the sound, but ignores any error.
+    pub fn unlock(self) -> Result<()> {
+        let this = std::mem::ManuallyDrop::new(self);
+        this.unlock_inner()
+    }
+
+    fn unlock_inner(&self) -> Result<()> {
+        unsafe {
+            FMOD_Sound_Unlock(self.sound.inner, self.ptr1, self.ptr2, self.len1, self.len2)
+                .to_result()
+        }
+    }
+}
+
+impl Drop for SoundLock<'_> {
+    fn drop(&mut self) {
+        let _ = self.unlock_inner();
+    }
+}
+
+/// Decodes a [`Sound`] through [`std::io::Read`] and [`std::io::Seek`], created with [`Sound::reader`].
+///
+/// Reads decode straight into the caller's buffer, so no intermediate buffers are allocated.
+/// Positions are in bytes of decoded data, and seeks must land on a frame boundary (a multiple of [`SoundReader::frame_size`]).
+#[derive(Debug)]
+pub struct SoundReader {
+    sound: Sound,
+    frame_size: u64,
+    position: u64,
+}
+
+impl SoundReader {
+    /// Creates a reader, starting at the current [`Sound::seek_data`] position which is assumed to be the start of the sound.
+    pub fn new(sound: Sound) -> Result<Self> {
+        let (_, _, channels, bits) = sound.get_format()?;
+        Ok(Self {
+            sound,
+            frame_size: (channels.max(0) * bits.max(0) / 8) as u64,
+            position: 0,
+        })
+    }
+
+    pub fn sound(&self) -> Sound {
+        self.sound
+    }
+
+    /// Size of one frame of decoded data in bytes, which is 0 for formats that can't be seeked (like [`crate::SoundFormat::BitStream`]).
+    pub fn frame_size(&self) -> u64 {
+        self.frame_size
+    }
+}
+
+fn io_error(error: Error) -> std::io::Error {
+    std::io::Error::other(error)
+}
+
+impl Read for SoundReader {
+    fn read(&mut self, buf: &mut [u8]) -> std::io::Result<usize> {
+        let read = self.sound.read_data(buf).map_err(io_error)?;
+        self.position += u64::from(read);
+        Ok(read as usize)
+    }
+}
+
+impl Seek for SoundReader {
+    fn seek(&mut self, pos: SeekFrom) -> std::io::Result<u64> {
+        let invalid = |message| std::io::Error::new(std::io::ErrorKind::InvalidInput, message);
+        let target = match pos {
+            SeekFrom::Start(offset) => Some(offset),
+            SeekFrom::Current(offset) => self.position.checked_add_signed(offset),
+            SeekFrom::End(offset) => {
+                let length = self
+                    .sound
+                    .get_length(TimeUnit::PCMBytes)
+                    .map_err(io_error)?;
+                u64::from(length).checked_add_signed(offset)
+            }
+        }
+        .ok_or_else(|| invalid("seek to a negative or overflowing position"))?;
+
+        if self.frame_size == 0 || target % self.frame_size != 0 {
+            return Err(invalid("seek must land on a frame boundary"));
+        }
+        let pcm = c_uint::try_from(target / self.frame_size)
+            .map_err(|_| invalid("seek position is out of range"))?;
+        self.sound.seek_data(pcm).map_err(io_error)?;
+        self.position = target;
+        Ok(target)
+    }
+
+    fn stream_position(&mut self) -> std::io::Result<u64> {
+        Ok(self.position)
+    }
 }
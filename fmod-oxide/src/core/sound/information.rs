@@ -12,7 +12,7 @@ use std::{
 use fmod_sys::*;
 use lanyard::{Utf8CStr, Utf8CString};
 
-use crate::{get_string, Sound, SoundFormat, SoundType, Tag, TimeUnit};
+use crate::{get_string, get_string_into, Sound, SoundFormat, SoundType, Tag, TimeUnit};
 
 impl Sound {
     /// Retrieves the name of a sound.
@@ -24,6 +24,17 @@ impl Sound {
         })
     }
 
+    /// Like [`Sound::get_name`], but writes the name into `name`, reusing its allocation.
+    pub fn get_name_into(&self, name: &mut String) -> Result<()> {
+        get_string_into(name, |buffer| unsafe {
+            FMOD_Sound_GetName(
+                self.inner,
+                buffer.as_mut_ptr().cast(),
+                buffer.len() as c_int,
+            )
+        })
+    }
+
     /// Returns format information about the sound.
     pub fn get_format(&self) -> Result<(SoundType, SoundFormat, c_int, c_int)> {
         let mut kind = 0;
@@ -6,7 +6,10 @@
 
 use fmod_sys::*;
 
+mod cache;
+pub use cache::{CachedSound, SoundCache, SoundKey};
 mod data_reading;
+pub use data_reading::{SoundLock, SoundReader};
 mod defaults;
 mod general;
 mod information;
@@ -8,7 +8,7 @@ use fmod_sys::*;
 use lanyard::Utf8CString;
 use std::ffi::{c_int, c_void};
 
-use crate::{get_string, SoundGroup, System};
+use crate::{get_string, get_string_into, SoundGroup, System};
 
 impl SoundGroup {
     /// Retrieves the name of the sound group.
@@ -18,6 +18,17 @@ impl SoundGroup {
         })
     }
 
+    /// Like [`SoundGroup::get_name`], but writes the name into `name`, reusing its allocation.
+    pub fn get_name_into(&self, name: &mut String) -> Result<()> {
+        get_string_into(name, |buffer| unsafe {
+            FMOD_SoundGroup_GetName(
+                self.inner,
+                buffer.as_mut_ptr().cast(),
+                buffer.len() as c_int,
+            )
+        })
+    }
+
     /// Releases a soundgroup object and returns all sounds back to the master sound group.
     ///
     /// You cannot release the master [`SoundGroup`].
@@ -83,4 +94,17 @@ impl SoundGroup {
         let pointer = self.get_raw_userdata()?;
         Ok(get_userdata(pointer.into()))
     }
+
+    /// Runs `f` with a borrow of the userdata, without cloning the [`std::sync::Arc`].
+    ///
+    /// This never blocks, even while another thread is setting or removing userdata.
+    pub fn with_userdata<R>(
+        &self,
+        f: impl FnOnce(&crate::userdata::Userdata) -> R,
+    ) -> Result<Option<R>> {
+        use crate::userdata::with_userdata;
+
+        let pointer = self.get_raw_userdata()?;
+        Ok(with_userdata(pointer.into(), f))
+    }
 }
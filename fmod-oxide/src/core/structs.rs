@@ -17,7 +17,7 @@ use crate::{
     SoundFormat, SoundGroup, SoundType, TagType, TimeUnit,
 };
 
-#[derive(Clone, Copy, Debug, PartialEq, PartialOrd, Default)]
+#[derive(Clone, Copy, Debug, PartialEq, Eq, Hash, PartialOrd, Default)]
 // force this type to have the exact same layout as FMOD_STUDIO_PARAMETER_ID so we can safely transmute between them.
 #[repr(C)]
 pub struct Guid {
@@ -469,7 +469,28 @@ impl<'a> SoundBuilder<'a> {
         }
     }
 
-    // TODO open_user
+    /// Creates an empty sample sound of `length` bytes, to be filled through [`crate::Sound::lock`] or recorded into with [`crate::System::record_start`].
+    ///
+    /// FMOD's read and seek callbacks for user created sounds are not supported yet.
+    pub const fn open_user(
+        length: c_uint,
+        channel_count: c_int,
+        default_frequency: c_int,
+        format: SoundFormat,
+    ) -> Self {
+        Self {
+            mode: FMOD_OPENUSER,
+            create_sound_ex_info: FMOD_CREATESOUNDEXINFO {
+                length,
+                numchannels: channel_count,
+                defaultfrequency: default_frequency,
+                format: format as _,
+                ..EMPTY_EXINFO
+            },
+            name_or_data: std::ptr::null(),
+            _phantom: PhantomData,
+        }
+    }
 
     /// # Safety
     ///
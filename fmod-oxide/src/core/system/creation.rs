@@ -89,6 +89,7 @@ impl System {
 
     /// WARNING: At the moment this function has no guardrails and WILL cause undefined behaviour if used incorrectly.
     /// The [`FMOD_DSP_DESCRIPTION`] API is *really* complicated and I felt it was better to provide an (unsafe) way to use it until I can figure out a better way to handle it.
+    /// See [`System::create_dsp_plugin`] for a safe way to write custom DSPs.
     ///
     /// Create a DSP object given a plugin description structure.
     ///
@@ -4,4 +4,258 @@
 // License, v. 2.0. If a copy of the MPL was not distributed with this
 // file, You can obtain one at https://mozilla.org/MPL/2.0/.
 
-// TODO filesystem
+use fmod_sys::*;
+use lanyard::Utf8CStr;
+use std::ffi::{c_char, c_int, c_uint, c_void};
+use std::marker::PhantomData;
+
+use crate::System;
+
+/// Callbacks to open and close files, shared by [`FileSystemSync`] and [`FileSystemAsync`].
+#[allow(unused_variables)]
+pub trait FileSystem {
+    /// An open file.
+    ///
+    /// With [`FileSystemAsync`] reads for the same file may be serviced from any thread, which is why it must be [`Sync`].
+    type File: Send + Sync;
+
+    /// Opens `name`, returning the file and its size in bytes.
+    fn open(name: &Utf8CStr) -> Result<(Self::File, c_uint)>;
+
+    /// Closes a file previously returned from [`FileSystem::open`].
+    fn close(file: Self::File) -> Result<()> {
+        Ok(())
+    }
+}
+
+/// Blocking file callbacks, called from FMOD's file thread.
+pub trait FileSystemSync: FileSystem {
+    /// Reads into `buffer` from the current position, returning how many bytes were read.
+    ///
+    /// Reading less than `buffer.len()` bytes signals the end of the file.
+    fn read(file: &mut Self::File, buffer: &mut [u8]) -> Result<c_uint>;
+
+    /// Moves the read position to `position` bytes from the start of the file.
+    fn seek(file: &mut Self::File, position: c_uint) -> Result<()>;
+}
+
+/// Asynchronous file callbacks, letting reads be queued and serviced by your own IO system.
+///
+/// [`FileSystemAsync::read`] should queue the request and return immediately.
+/// The request is then completed from any thread with [`AsyncReadInfo::finish`].
+///
+/// # Safety
+///
+/// After [`FileSystemAsync::cancel`] returns FMOD frees the request, so it must not be used anymore.
+/// `cancel` must either remove the request from your queue, or wait for an in-flight read of it to finish.
+pub unsafe trait FileSystemAsync: FileSystem {
+    /// Queues a read request.
+    fn read(info: AsyncReadInfo<Self::File>) -> Result<()>;
+
+    /// Cancels a read request that was previously passed to [`FileSystemAsync::read`].
+    ///
+    /// FMOD calls this when a file is being closed with reads still pending.
+    /// The request can be found in your queue by comparing [`AsyncReadInfo::as_ptr`].
+    fn cancel(info: AsyncReadInfo<Self::File>) -> Result<()>;
+}
+
+/// A pending asynchronous read, see [`FileSystemAsync`].
+#[derive(Debug)]
+pub struct AsyncReadInfo<F> {
+    inner: *mut FMOD_ASYNCREADINFO,
+    file: PhantomData<*const F>,
+}
+
+// the request is owned by fmod until finish is called, and File is Sync
+unsafe impl<F: Sync> Send for AsyncReadInfo<F> {}
+unsafe impl<F: Sync> Sync for AsyncReadInfo<F> {}
+
+impl<F> AsyncReadInfo<F> {
+    /// The file to read from.
+    pub fn file(&self) -> &F {
+        unsafe { &*(*self.inner).handle.cast::<F>() }
+    }
+
+    /// Offset into the file to read from, in bytes.
+    pub fn offset(&self) -> c_uint {
+        unsafe { (*self.inner).offset }
+    }
+
+    /// Number of bytes to read.
+    pub fn size(&self) -> c_uint {
+        unsafe { (*self.inner).sizebytes }
+    }
+
+    /// Priority hint, 0 is low priority and 100 is high priority.
+    ///
+    /// Streams that are close to starving are given a higher priority.
+    pub fn priority(&self) -> c_int {
+        unsafe { (*self.inner).priority }
+    }
+
+    /// The buffer to read into, which is [`AsyncReadInfo::size`] bytes long.
+    pub fn buffer(&mut self) -> &mut [u8] {
+        unsafe {
+            std::slice::from_raw_parts_mut(
+                (*self.inner).buffer.cast::<u8>(),
+                (*self.inner).sizebytes as usize,
+            )
+        }
+    }
+
+    /// Completes the request, after `bytes_read` bytes have been written to [`AsyncReadInfo::buffer`].
+    ///
+    /// Reading less than [`AsyncReadInfo::size`] bytes signals the end of the file.
+    pub fn finish(self, bytes_read: c_uint, result: Result<()>) {
+        unsafe {
+            let info = &mut *self.inner;
+            info.bytesread = bytes_read.min(info.sizebytes);
+            let result = match result {
+                Ok(()) if info.bytesread < info.sizebytes => FMOD_RESULT::FMOD_ERR_FILE_EOF,
+                result => result.into(),
+            };
+            if let Some(done) = info.done {
+                done(self.inner, result);
+            }
+        }
+    }
+
+    pub fn as_ptr(&self) -> *mut FMOD_ASYNCREADINFO {
+        self.inner
+    }
+}
+
+unsafe extern "C" fn open_impl<F: FileSystem>(
+    name: *const c_char,
+    filesize: *mut c_uint,
+    handle: *mut *mut c_void,
+    _userdata: *mut c_void,
+) -> FMOD_RESULT {
+    let name = unsafe { Utf8CStr::from_ptr_unchecked(name) };
+    match F::open(name) {
+        Ok((file, size)) => {
+            unsafe {
+                *filesize = size;
+                *handle = Box::into_raw(Box::new(file)).cast();
+            }
+            FMOD_RESULT::FMOD_OK
+        }
+        Err(e) => e.into(),
+    }
+}
+
+unsafe extern "C" fn close_impl<F: FileSystem>(
+    handle: *mut c_void,
+    _userdata: *mut c_void,
+) -> FMOD_RESULT {
+    let file = unsafe { Box::from_raw(handle.cast::<F::File>()) };
+    F::close(*file).into()
+}
+
+unsafe extern "C" fn read_impl<F: FileSystemSync>(
+    handle: *mut c_void,
+    buffer: *mut c_void,
+    size_bytes: c_uint,
+    bytes_read: *mut c_uint,
+    _userdata: *mut c_void,
+) -> FMOD_RESULT {
+    let file = unsafe { &mut *handle.cast::<F::File>() };
+    let buffer =
+        unsafe { std::slice::from_raw_parts_mut(buffer.cast::<u8>(), size_bytes as usize) };
+    match F::read(file, buffer) {
+        Ok(read) => {
+            let read = read.min(size_bytes);
+            unsafe { *bytes_read = read };
+            if read < size_bytes {
+                FMOD_RESULT::FMOD_ERR_FILE_EOF
+            } else {
+                FMOD_RESULT::FMOD_OK
+            }
+        }
+        Err(e) => e.into(),
+    }
+}
+
+unsafe extern "C" fn seek_impl<F: FileSystemSync>(
+    handle: *mut c_void,
+    position: c_uint,
+    _userdata: *mut c_void,
+) -> FMOD_RESULT {
+    let file = unsafe { &mut *handle.cast::<F::File>() };
+    F::seek(file, position).into()
+}
+
+unsafe extern "C" fn async_read_impl<F: FileSystemAsync>(
+    info: *mut FMOD_ASYNCREADINFO,
+    _userdata: *mut c_void,
+) -> FMOD_RESULT {
+    let info = AsyncReadInfo {
+        inner: info,
+        file: PhantomData,
+    };
+    F::read(info).into()
+}
+
+unsafe extern "C" fn async_cancel_impl<F: FileSystemAsync>(
+    info: *mut FMOD_ASYNCREADINFO,
+    _userdata: *mut c_void,
+) -> FMOD_RESULT {
+    let info = AsyncReadInfo {
+        inner: info,
+        file: PhantomData,
+    };
+    F::cancel(info).into()
+}
+
+impl System {
+    /// Set callbacks to implement all file I/O instead of using the platform native method.
+    ///
+    /// Setting these callbacks have no effect on sounds loaded with [`crate::Mode::OPEN_MEMORY`] or [`crate::Mode::OPEN_MEMORY_POINT`].
+    ///
+    /// `block_align` is the file buffering chunk size, specify -1 to keep the system default or previously set value.
+    /// 0 = disable buffering.
+    ///
+    /// Only files opened after this call use the callbacks, so this should generally be called right after creating the system.
+    pub fn set_file_system_sync<F: FileSystemSync>(&self, block_align: c_int) -> Result<()> {
+        unsafe {
+            FMOD_System_SetFileSystem(
+                self.inner,
+                Some(open_impl::<F>),
+                Some(close_impl::<F>),
+                Some(read_impl::<F>),
+                Some(seek_impl::<F>),
+                None,
+                None,
+                block_align,
+            )
+            .to_result()
+        }
+    }
+
+    /// Set callbacks to implement all file I/O asynchronously instead of using the platform native method.
+    ///
+    /// FMOD queues every read through [`FileSystemAsync::read`], which lets FMOD's streaming share a scheduler (and bandwidth budget) with the rest of your IO.
+    /// Use [`AsyncReadInfo::priority`] to order requests, streams that are about to starve are given a higher priority.
+    ///
+    /// Setting these callbacks have no effect on sounds loaded with [`crate::Mode::OPEN_MEMORY`] or [`crate::Mode::OPEN_MEMORY_POINT`].
+    ///
+    /// `block_align` is the file buffering chunk size, specify -1 to keep the system default or previously set value.
+    /// 0 = disable buffering.
+    ///
+    /// Only files opened after this call use the callbacks, so this should generally be called right after creating the system.
+    pub fn set_file_system_async<F: FileSystemAsync>(&self, block_align: c_int) -> Result<()> {
+        unsafe {
+            FMOD_System_SetFileSystem(
+                self.inner,
+                Some(open_impl::<F>),
+                Some(close_impl::<F>),
+                None,
+                None,
+                Some(async_read_impl::<F>),
+                Some(async_cancel_impl::<F>),
+                block_align,
+            )
+            .to_result()
+        }
+    }
+}
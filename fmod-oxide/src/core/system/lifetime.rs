@@ -40,7 +40,8 @@ impl System {
     /// [`System::release`] is not thread-safe. Do not call this function simultaneously from multiple threads at once.
     #[cfg_attr(
         feature = "userdata-abstraction",
-        doc = "\n#### Note: This function will drop any associated userdata who's owner is no longer valid."
+        doc = "\n#### Note: This function will drop any associated userdata who's owner is no longer valid.\n\n\
+        How many owners are checked per call can be limited with [`crate::set_userdata_cleanup_budget`]."
     )]
     pub unsafe fn release(&self) -> Result<()> {
         unsafe {
@@ -70,8 +71,14 @@ impl System {
     ///
     /// If [`InitFlags::STREAM_FROM_UPDATE`]. is used, this function will update the stream engine.
     /// Combining this with the non realtime output will mean smoother captured output.
+    ///
+    /// This function also wakes every [`crate::LoadFuture`] whose load has completed.
     pub fn update(&self) -> Result<()> {
-        unsafe { FMOD_System_Update(self.inner).to_result() }
+        unsafe { FMOD_System_Update(self.inner).to_result()? };
+
+        crate::loading::poll_pending_loads();
+
+        Ok(())
     }
 
     /// Suspend mixer thread and relinquish usage of audio hardware while maintaining internal state.
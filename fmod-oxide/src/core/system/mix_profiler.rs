@@ -0,0 +1,410 @@
+// Copyright (c) 2024 Lily Lyons
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+use fmod_sys::*;
+use std::{
+    ffi::c_void,
+    io::Write,
+    sync::{
+        atomic::{AtomicU64, AtomicUsize, Ordering},
+        OnceLock,
+    },
+    time::{Duration, Instant},
+};
+
+use crate::{System, SystemCallback, SystemCallbackMask};
+
+/// Built-in mix thread timing, driven by [`SystemCallback`].
+///
+/// Install it with [`System::enable_mix_profiler`], or forward the callbacks from your own [`SystemCallback`] to the `on_*` functions.
+/// It records, with a monotonic clock:
+/// - how long each mix block takes (premix to postmix), and how long the DSP graph takes (premix to midmix)
+/// - how long [`System::update`] takes (preupdate to postupdate)
+/// - the latency from the end of an update to the start of the next mix, which is when the update's commands reach the mixer
+/// - output underruns, and which blocks went over the budget set with [`MixProfiler::set_budget`]
+///
+/// Recording only touches atomics, and never allocates or locks.
+/// The profiler is global, so it should only be installed on one system at a time.
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Hash, Default)]
+pub struct MixProfiler;
+
+const BUCKETS: usize = 24;
+const OVER_BUDGET_CAPACITY: usize = 64;
+const SPAN_CAPACITY: usize = 1024;
+
+struct Histogram {
+    count: AtomicU64,
+    total_ns: AtomicU64,
+    max_ns: AtomicU64,
+    buckets: [AtomicU64; BUCKETS],
+}
+
+impl Histogram {
+    const fn new() -> Self {
+        const ZERO: AtomicU64 = AtomicU64::new(0);
+        Self {
+            count: AtomicU64::new(0),
+            total_ns: AtomicU64::new(0),
+            max_ns: AtomicU64::new(0),
+            buckets: [ZERO; BUCKETS],
+        }
+    }
+
+    fn record(&self, ns: u64) {
+        self.count.fetch_add(1, Ordering::Relaxed);
+        self.total_ns.fetch_add(ns, Ordering::Relaxed);
+        self.max_ns.fetch_max(ns, Ordering::Relaxed);
+        self.buckets[bucket(ns / 1000)].fetch_add(1, Ordering::Relaxed);
+    }
+
+    fn snapshot(&self) -> MixHistogram {
+        MixHistogram {
+            count: self.count.load(Ordering::Relaxed),
+            total: Duration::from_nanos(self.total_ns.load(Ordering::Relaxed)),
+            max: Duration::from_nanos(self.max_ns.load(Ordering::Relaxed)),
+            buckets: std::array::from_fn(|i| self.buckets[i].load(Ordering::Relaxed)),
+        }
+    }
+
+    fn reset(&self) {
+        self.count.store(0, Ordering::Relaxed);
+        self.total_ns.store(0, Ordering::Relaxed);
+        self.max_ns.store(0, Ordering::Relaxed);
+        for bucket in &self.buckets {
+            bucket.store(0, Ordering::Relaxed);
+        }
+    }
+}
+
+// bucket i holds durations of [2^i, 2^(i+1)) microseconds, bucket 0 also holds durations under 1µs
+fn bucket(us: u64) -> usize {
+    (u64::BITS - us.leading_zeros())
+        .saturating_sub(1)
+        .min(BUCKETS as u32 - 1) as usize
+}
+
+struct ProfilerState {
+    // timestamps are nanoseconds since `epoch`, 0 means unset
+    mix_start: AtomicU64,
+    update_start: AtomicU64,
+    update_end: AtomicU64,
+    budget_ns: AtomicU64,
+    blocks: AtomicU64,
+    underruns: AtomicU64,
+    mix: Histogram,
+    dsp: Histogram,
+    update: Histogram,
+    update_to_mix: Histogram,
+    // block index in the high 32 bits, duration in µs in the low 32 bits
+    over_budget: [AtomicU64; OVER_BUDGET_CAPACITY],
+    over_budget_written: AtomicUsize,
+    // see pack_span
+    spans: [AtomicU64; SPAN_CAPACITY],
+    spans_written: AtomicUsize,
+}
+
+static STATE: ProfilerState = {
+    const ZERO: AtomicU64 = AtomicU64::new(0);
+    ProfilerState {
+        mix_start: AtomicU64::new(0),
+        update_start: AtomicU64::new(0),
+        update_end: AtomicU64::new(0),
+        budget_ns: AtomicU64::new(0),
+        blocks: AtomicU64::new(0),
+        underruns: AtomicU64::new(0),
+        mix: Histogram::new(),
+        dsp: Histogram::new(),
+        update: Histogram::new(),
+        update_to_mix: Histogram::new(),
+        over_budget: [ZERO; OVER_BUDGET_CAPACITY],
+        over_budget_written: AtomicUsize::new(0),
+        spans: [ZERO; SPAN_CAPACITY],
+        spans_written: AtomicUsize::new(0),
+    }
+};
+
+static EPOCH: OnceLock<Instant> = OnceLock::new();
+
+fn now() -> u64 {
+    // never returns 0, which marks unset timestamps
+    EPOCH.get_or_init(Instant::now).elapsed().as_nanos() as u64 + 1
+}
+
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+enum SpanKind {
+    Mix,
+    Update,
+}
+
+// spans are packed into a single atomic so readers never see half written spans:
+// start in µs in the top 39 bits, the kind in 1 bit, and the duration in µs in the low 24 bits
+fn pack_span(kind: SpanKind, start_ns: u64, duration_ns: u64) -> u64 {
+    let start = (start_ns / 1000) & ((1 << 39) - 1);
+    let duration = (duration_ns / 1000).min((1 << 24) - 1);
+    start << 25 | u64::from(kind == SpanKind::Update) << 24 | duration
+}
+
+fn unpack_span(span: u64) -> (SpanKind, u64, u64) {
+    let kind = if span >> 24 & 1 == 1 {
+        SpanKind::Update
+    } else {
+        SpanKind::Mix
+    };
+    (kind, span >> 25, span & ((1 << 24) - 1))
+}
+
+fn push_span(kind: SpanKind, start_ns: u64, duration_ns: u64) {
+    let index = STATE.spans_written.fetch_add(1, Ordering::Relaxed) % SPAN_CAPACITY;
+    STATE.spans[index].store(pack_span(kind, start_ns, duration_ns), Ordering::Relaxed);
+}
+
+/// A histogram of durations, in power of two microsecond buckets.
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Default)]
+pub struct MixHistogram {
+    pub count: u64,
+    pub total: Duration,
+    pub max: Duration,
+    /// Bucket `i` counts durations of `2^i` to `2^(i+1)` microseconds. The first bucket also counts anything shorter, and the last anything longer.
+    pub buckets: [u64; BUCKETS],
+}
+
+impl MixHistogram {
+    pub fn mean(&self) -> Duration {
+        if self.count == 0 {
+            Duration::ZERO
+        } else {
+            Duration::from_nanos((self.total.as_nanos() / u128::from(self.count)) as u64)
+        }
+    }
+
+    /// An upper bound for the duration that `fraction` (from 0.0 to 1.0) of the recorded durations fall under.
+    ///
+    /// The result is accurate to the bucket size, and never more than [`MixHistogram::max`].
+    pub fn percentile(&self, fraction: f64) -> Duration {
+        let target = (self.count as f64 * fraction.clamp(0.0, 1.0)).ceil() as u64;
+        let mut seen = 0;
+        for (i, count) in self.buckets.iter().enumerate() {
+            seen += count;
+            if seen >= target && seen > 0 {
+                return Duration::from_micros(2u64 << i).min(self.max);
+            }
+        }
+        self.max
+    }
+}
+
+/// A mix block that took longer than the budget set with [`MixProfiler::set_budget`].
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct OverBudgetBlock {
+    /// Index of the block, counting from when the profiler was installed or last reset.
+    pub block: u32,
+    pub duration: Duration,
+}
+
+/// A snapshot of [`MixProfiler`]'s counters, retrieved with [`MixProfiler::snapshot`].
+#[derive(Debug, Clone, PartialEq, Eq, Default)]
+pub struct MixProfilerSnapshot {
+    /// Number of mix blocks that completed.
+    pub blocks: u64,
+    pub underruns: u64,
+    /// Premix to postmix.
+    pub mix: MixHistogram,
+    /// Premix to midmix, the time spent executing the DSP graph.
+    pub dsp: MixHistogram,
+    /// Preupdate to postupdate.
+    pub update: MixHistogram,
+    /// End of an update to the start of the next mix block.
+    pub update_to_mix: MixHistogram,
+    /// The most recent blocks that went over budget, oldest first.
+    pub over_budget: Vec<OverBudgetBlock>,
+}
+
+impl MixProfiler {
+    /// The callbacks [`MixProfiler`] needs.
+    pub const CALLBACK_MASK: SystemCallbackMask = SystemCallbackMask::PREMIX
+        .union(SystemCallbackMask::MIDMIX)
+        .union(SystemCallbackMask::POSTMIX)
+        .union(SystemCallbackMask::PREUPDATE)
+        .union(SystemCallbackMask::POSTUPDATE)
+        .union(SystemCallbackMask::OUTPUTUNDERRUN);
+
+    pub fn on_premix() {
+        let now = now();
+        STATE.mix_start.store(now, Ordering::Relaxed);
+        // only the first mix after an update picks up its commands
+        let update_end = STATE.update_end.swap(0, Ordering::Relaxed);
+        if update_end != 0 {
+            STATE.update_to_mix.record(now.saturating_sub(update_end));
+        }
+    }
+
+    pub fn on_mid_mix() {
+        let start = STATE.mix_start.load(Ordering::Relaxed);
+        if start != 0 {
+            STATE.dsp.record(now().saturating_sub(start));
+        }
+    }
+
+    pub fn on_postmix() {
+        let start = STATE.mix_start.swap(0, Ordering::Relaxed);
+        if start == 0 {
+            return;
+        }
+        let duration = now().saturating_sub(start);
+        let block = STATE.blocks.fetch_add(1, Ordering::Relaxed);
+        STATE.mix.record(duration);
+        push_span(SpanKind::Mix, start, duration);
+
+        let budget = STATE.budget_ns.load(Ordering::Relaxed);
+        if budget != 0 && duration > budget {
+            let index =
+                STATE.over_budget_written.fetch_add(1, Ordering::Relaxed) % OVER_BUDGET_CAPACITY;
+            let entry =
+                (block & u64::from(u32::MAX)) << 32 | (duration / 1000).min(u32::MAX.into());
+            STATE.over_budget[index].store(entry, Ordering::Relaxed);
+        }
+    }
+
+    pub fn on_pre_update() {
+        STATE.update_start.store(now(), Ordering::Relaxed);
+    }
+
+    pub fn on_post_update() {
+        let now = now();
+        STATE.update_end.store(now, Ordering::Relaxed);
+        let start = STATE.update_start.swap(0, Ordering::Relaxed);
+        if start != 0 {
+            let duration = now.saturating_sub(start);
+            STATE.update.record(duration);
+            push_span(SpanKind::Update, start, duration);
+        }
+    }
+
+    pub fn on_output_underrun() {
+        STATE.underruns.fetch_add(1, Ordering::Relaxed);
+    }
+
+    /// Sets the time a mix block may take before it is recorded as over budget, or [`None`] to stop recording.
+    ///
+    /// A block's budget is usually its length in time, `dsp_buffer_size / sample_rate`.
+    pub fn set_budget(budget: Option<Duration>) {
+        let ns = budget.map_or(0, |b| b.as_nanos().clamp(1, u64::MAX.into()) as u64);
+        STATE.budget_ns.store(ns, Ordering::Relaxed);
+    }
+
+    /// Reads every counter.
+    ///
+    /// The counters are read one at a time while the mixer keeps running, so they may be off by a block from each other.
+    pub fn snapshot() -> MixProfilerSnapshot {
+        let written = STATE.over_budget_written.load(Ordering::Relaxed);
+        let stored = written.min(OVER_BUDGET_CAPACITY);
+        let over_budget = (written - stored..written)
+            .map(|i| STATE.over_budget[i % OVER_BUDGET_CAPACITY].load(Ordering::Relaxed))
+            .map(|entry| OverBudgetBlock {
+                block: (entry >> 32) as u32,
+                duration: Duration::from_micros(entry & u64::from(u32::MAX)),
+            })
+            .collect();
+
+        MixProfilerSnapshot {
+            blocks: STATE.blocks.load(Ordering::Relaxed),
+            underruns: STATE.underruns.load(Ordering::Relaxed),
+            mix: STATE.mix.snapshot(),
+            dsp: STATE.dsp.snapshot(),
+            update: STATE.update.snapshot(),
+            update_to_mix: STATE.update_to_mix.snapshot(),
+            over_budget,
+        }
+    }
+
+    /// Clears every counter, histogram and recorded span.
+    pub fn reset() {
+        STATE.blocks.store(0, Ordering::Relaxed);
+        STATE.underruns.store(0, Ordering::Relaxed);
+        STATE.mix.reset();
+        STATE.dsp.reset();
+        STATE.update.reset();
+        STATE.update_to_mix.reset();
+        for entry in &STATE.over_budget {
+            entry.store(0, Ordering::Relaxed);
+        }
+        STATE.over_budget_written.store(0, Ordering::Relaxed);
+        for span in &STATE.spans {
+            span.store(0, Ordering::Relaxed);
+        }
+        STATE.spans_written.store(0, Ordering::Relaxed);
+    }
+
+    /// Writes the most recent 1024 mix and update spans in the Chrome trace event format,
+    /// which can be opened in `chrome://tracing`, Perfetto, or converted for Tracy with its `import-chrome` tool.
+    pub fn write_chrome_trace(writer: &mut impl Write) -> std::io::Result<()> {
+        let written = STATE.spans_written.load(Ordering::Relaxed);
+        let stored = written.min(SPAN_CAPACITY);
+        writer.write_all(b"{\"traceEvents\":[")?;
+        let mut first = true;
+        for i in written - stored..written {
+            let span = STATE.spans[i % SPAN_CAPACITY].load(Ordering::Relaxed);
+            if span == 0 {
+                continue;
+            }
+            let (kind, start, duration) = unpack_span(span);
+            let (name, tid) = match kind {
+                SpanKind::Mix => ("mix", 1),
+                SpanKind::Update => ("update", 2),
+            };
+            if !first {
+                writer.write_all(b",")?;
+            }
+            first = false;
+            write!(
+                writer,
+                "{{\"name\":\"{name}\",\"ph\":\"X\",\"ts\":{start},\"dur\":{duration},\"pid\":0,\"tid\":{tid}}}"
+            )?;
+        }
+        writer.write_all(b"]}")
+    }
+}
+
+impl SystemCallback for MixProfiler {
+    fn premix(_: System, _: *mut c_void) -> Result<()> {
+        MixProfiler::on_premix();
+        Ok(())
+    }
+
+    fn mid_mix(_: System, _: *mut c_void) -> Result<()> {
+        MixProfiler::on_mid_mix();
+        Ok(())
+    }
+
+    fn postmix(_: System, _: *mut c_void) -> Result<()> {
+        MixProfiler::on_postmix();
+        Ok(())
+    }
+
+    fn pre_update(_: System, _: *mut c_void) -> Result<()> {
+        MixProfiler::on_pre_update();
+        Ok(())
+    }
+
+    fn post_update(_: System, _: *mut c_void) -> Result<()> {
+        MixProfiler::on_post_update();
+        Ok(())
+    }
+
+    fn output_underrun(_: System, _: *mut c_void) -> Result<()> {
+        MixProfiler::on_output_underrun();
+        Ok(())
+    }
+}
+
+impl System {
+    /// Installs [`MixProfiler`] as this system's callback.
+    ///
+    /// This replaces any callback set with [`System::set_callback`].
+    pub fn enable_mix_profiler(&self) -> Result<()> {
+        self.set_callback::<MixProfiler>(MixProfiler::CALLBACK_MASK)
+    }
+}
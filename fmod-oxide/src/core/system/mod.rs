@@ -15,13 +15,20 @@ mod general;
 mod geometry;
 mod information;
 mod lifetime;
+mod mix_profiler;
 mod network;
 mod plugin;
+mod record_stream;
 mod recording;
 mod runtime_control;
 mod setup;
 pub use builder::SystemBuilder;
 pub use callback::{ErrorCallbackInfo, Instance, SystemCallback, SystemCallbackMask};
+pub use filesystem::{AsyncReadInfo, FileSystem, FileSystemAsync, FileSystemSync};
+pub use mix_profiler::{MixHistogram, MixProfiler, MixProfilerSnapshot, OverBudgetBlock};
+pub use record_stream::{
+    RecordBlock, RecordBlockReceiver, RecordBlockSender, RecordRead, RecordStream,
+};
 pub use setup::RolloffCallback;
 
 #[derive(Debug, Clone, Copy, PartialEq, Eq, Hash)]
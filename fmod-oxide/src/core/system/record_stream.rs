@@ -0,0 +1,419 @@
+// Copyright (c) 2024 Lily Lyons
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+use fmod_sys::*;
+use std::{
+    ffi::{c_float, c_int, c_uint},
+    ops::Deref,
+    sync::{
+        atomic::{AtomicU64, Ordering},
+        Arc,
+    },
+    time::Instant,
+};
+
+use crate::{
+    bounded_queue::BoundedQueue, Mode, Sound, SoundBuilder, SoundFormat, SoundLock, System,
+    TimeUnit,
+};
+
+/// Reads what a recording driver captures into a looping record buffer, as it's captured.
+///
+/// The stream keeps a read cursor into the buffer and compares it against [`System::get_record_position`],
+/// so every call hands out exactly the samples recorded since the last one.
+/// Reads lock the buffer with [`Sound::lock`] and borrow it directly, as one region or two when the new samples wrap around the end of the buffer.
+///
+/// If the stream isn't read for longer than the buffer holds, the driver overwrites samples that were never read.
+/// The stream then skips ahead to the newest samples and counts an overrun (see [`RecordStream::overruns`]), rather than handing out a torn mix of old and new audio.
+///
+/// For voice chat, read blocks of one encoder frame with [`RecordStream::read_block`],
+/// or hand them to an encoder thread with [`RecordStream::send_blocks`].
+/// Latency is then one block plus however long it takes to poll after a block completes.
+///
+/// ```ignore
+/// let mut stream = RecordStream::start(system, 0, 48_000)?;
+/// // 20ms at 48kHz
+/// let (sender, receiver) = stream.block_channel(960, 8);
+/// std::thread::spawn(move || loop {
+///     while let Some(block) = receiver.try_recv() {
+///         encoder.encode(&block);
+///     }
+///     std::thread::sleep(Duration::from_millis(5));
+/// });
+/// // every frame
+/// stream.send_blocks(&sender)?;
+/// ```
+#[derive(Debug)]
+pub struct RecordStream {
+    system: System,
+    driver: c_int,
+    sound: Sound,
+    owned: bool,
+    format: SoundFormat,
+    sample_rate: c_float,
+    frame_size: c_uint,
+    length: c_uint,
+    cursor: c_uint,
+    unread: c_uint,
+    last_position: c_uint,
+    last_poll: Instant,
+    overruns: u64,
+}
+
+impl RecordStream {
+    /// Starts recording from `driver` into a new looping buffer of `buffer_frames` samples.
+    ///
+    /// The buffer uses the driver's native rate and channel count and [`SoundFormat::PCM16`], so FMOD doesn't have to resample.
+    /// It only needs to hold a few blocks, anything longer only matters if the stream is read irregularly.
+    pub fn start(system: System, driver: c_int, buffer_frames: c_uint) -> Result<Self> {
+        let (_, _, sample_rate, _, channels, _) = system.get_record_driver_info(driver)?;
+        let frame_size = channels.max(1) as c_uint * 2;
+        let builder = SoundBuilder::open_user(
+            buffer_frames.saturating_mul(frame_size),
+            channels,
+            sample_rate,
+            SoundFormat::PCM16,
+        )
+        .with_mode(Mode::LOOP_NORMAL);
+        let sound = system.create_sound(&builder)?;
+        if let Err(error) = system.record_start(driver, sound, true) {
+            let _ = sound.release();
+            return Err(error);
+        }
+        let mut stream = Self::from_sound(system, driver, sound)?;
+        stream.owned = true;
+        Ok(stream)
+    }
+
+    /// Reads from a recording that was already started with [`System::record_start`] on `sound`, with looping enabled.
+    ///
+    /// The stream doesn't own `sound`, it is not stopped or released with the stream.
+    pub fn from_sound(system: System, driver: c_int, sound: Sound) -> Result<Self> {
+        let (_, format, channels, bits) = sound.get_format()?;
+        let (sample_rate, _) = sound.get_defaults()?;
+        let length = sound.get_length(TimeUnit::PCM)?;
+        let position = system.get_record_position(driver)?;
+        Ok(Self {
+            system,
+            driver,
+            sound,
+            owned: false,
+            format,
+            sample_rate,
+            frame_size: (channels.max(1) * bits.max(8) / 8) as c_uint,
+            length: length.max(1),
+            cursor: position,
+            unread: 0,
+            last_position: position,
+            last_poll: Instant::now(),
+            overruns: 0,
+        })
+    }
+
+    pub fn sound(&self) -> Sound {
+        self.sound
+    }
+
+    pub fn format(&self) -> SoundFormat {
+        self.format
+    }
+
+    /// Size of one sample frame (one sample for every channel) in bytes.
+    pub fn frame_size(&self) -> c_uint {
+        self.frame_size
+    }
+
+    /// Length of the record buffer in sample frames.
+    pub fn buffer_frames(&self) -> c_uint {
+        self.length
+    }
+
+    /// How many times samples were overwritten before they were read.
+    pub fn overruns(&self) -> u64 {
+        self.overruns
+    }
+
+    /// Catches up with the recording position, returning how many sample frames are ready to be read.
+    ///
+    /// [`RecordStream::read`], [`RecordStream::read_block`] and [`RecordStream::send_blocks`] call this themselves.
+    pub fn poll(&mut self) -> Result<c_uint> {
+        let position = self.system.get_record_position(self.driver)? % self.length;
+        let now = Instant::now();
+        // the position alone can't tell apart 0 and 1 laps of the buffer, the time since the last poll can
+        let recorded =
+            now.duration_since(self.last_poll).as_secs_f64() * f64::from(self.sample_rate);
+        let advanced = (position + self.length - self.last_position) % self.length;
+        self.last_position = position;
+        self.last_poll = now;
+
+        self.unread = self.unread.saturating_add(advanced);
+        if self.unread >= self.length || recorded >= f64::from(self.length) {
+            self.overruns += 1;
+            self.cursor = position;
+            self.unread = 0;
+        }
+        Ok(self.unread)
+    }
+
+    /// Borrows up to `max_frames` of the unread samples. They count as read once the [`RecordRead`] is dropped.
+    ///
+    /// Returns [`None`] if nothing new was recorded.
+    pub fn read(&mut self, max_frames: c_uint) -> Result<Option<RecordRead<'_>>> {
+        let frames = self.poll()?.min(max_frames);
+        self.lock_frames(frames)
+    }
+
+    /// Borrows exactly `frames` of the unread samples, or returns [`None`] if fewer than that have been recorded.
+    pub fn read_block(&mut self, frames: c_uint) -> Result<Option<RecordRead<'_>>> {
+        if self.poll()? < frames {
+            return Ok(None);
+        }
+        self.lock_frames(frames)
+    }
+
+    fn lock_frames(&mut self, frames: c_uint) -> Result<Option<RecordRead<'_>>> {
+        if frames == 0 {
+            return Ok(None);
+        }
+        let Self {
+            sound,
+            frame_size,
+            length,
+            cursor,
+            unread,
+            ..
+        } = self;
+        // SAFETY: the stream owns the sound and hands out one read at a time, and it only locks samples behind the record position.
+        // FMOD doesn't write those again until recording comes back around the buffer, which RecordRead documents.
+        let lock = unsafe { sound.lock(*cursor * *frame_size, frames * *frame_size)? };
+        Ok(Some(RecordRead {
+            lock,
+            frames,
+            length: *length,
+            cursor,
+            unread,
+        }))
+    }
+
+    /// Creates a channel for moving blocks of `block_frames` samples to another thread, with `blocks` preallocated buffers.
+    ///
+    /// The buffers are allocated here and reused, so sending and receiving blocks never allocates.
+    pub fn block_channel(
+        &self,
+        block_frames: c_uint,
+        blocks: usize,
+    ) -> (RecordBlockSender, RecordBlockReceiver) {
+        let block_bytes = (block_frames * self.frame_size) as usize;
+        let pool = Arc::new(BlockPool {
+            free: BoundedQueue::with_capacity(blocks),
+            filled: BoundedQueue::with_capacity(blocks),
+            dropped: AtomicU64::new(0),
+        });
+        for _ in 0..blocks {
+            let _ = pool.free.push(vec![0; block_bytes].into_boxed_slice());
+        }
+        (
+            RecordBlockSender {
+                pool: pool.clone(),
+                block_frames,
+                block_bytes,
+            },
+            RecordBlockReceiver { pool, block_frames },
+        )
+    }
+
+    /// Copies every complete block of unread samples into `sender`'s buffers and sends them, returning how many blocks were sent.
+    ///
+    /// This is the only copy recorded samples go through, since the driver overwrites the record buffer.
+    /// When the receiver falls behind and no buffer is free the block is skipped, which counts towards [`RecordBlockReceiver::dropped_blocks`].
+    ///
+    /// `sender` must come from a stream with the same format, or this returns [`FMOD_RESULT::FMOD_ERR_INVALID_PARAM`].
+    pub fn send_blocks(&mut self, sender: &RecordBlockSender) -> Result<usize> {
+        if sender.block_bytes != (sender.block_frames * self.frame_size) as usize {
+            return Err(FMOD_RESULT::FMOD_ERR_INVALID_PARAM.into());
+        }
+        let mut unread = self.poll()?;
+        let mut sent = 0;
+        while sender.block_frames > 0 && unread >= sender.block_frames {
+            let Some(read) = self.lock_frames(sender.block_frames)? else {
+                break;
+            };
+            match sender.pool.free.pop() {
+                Some(mut buffer) => {
+                    let (first, second) = read.data();
+                    buffer[..first.len()].copy_from_slice(first);
+                    buffer[first.len()..first.len() + second.len()].copy_from_slice(second);
+                    // there are never more buffers than the queue holds
+                    let _ = sender.pool.filled.push(buffer);
+                    sent += 1;
+                }
+                None => {
+                    sender.pool.dropped.fetch_add(1, Ordering::Relaxed);
+                }
+            }
+            drop(read);
+            unread -= sender.block_frames;
+        }
+        Ok(sent)
+    }
+
+    /// Stops recording and releases the record buffer if the stream created it.
+    ///
+    /// Dropping the stream does the same, but ignores errors.
+    pub fn stop(self) -> Result<()> {
+        let this = std::mem::ManuallyDrop::new(self);
+        this.stop_inner()
+    }
+
+    fn stop_inner(&self) -> Result<()> {
+        if !self.owned {
+            return Ok(());
+        }
+        self.system.record_stop(self.driver)?;
+        self.sound.release()
+    }
+}
+
+impl Drop for RecordStream {
+    fn drop(&mut self) {
+        let _ = self.stop_inner();
+    }
+}
+
+/// Samples borrowed from the record buffer of a [`RecordStream`], created with [`RecordStream::read`] and [`RecordStream::read_block`].
+///
+/// The samples count as read, and the buffer is unlocked, when this is dropped.
+/// Drop it well within the length of the record buffer: after that FMOD starts recording over the samples it borrows.
+#[derive(Debug)]
+pub struct RecordRead<'a> {
+    lock: SoundLock<'a>,
+    frames: c_uint,
+    length: c_uint,
+    cursor: &'a mut c_uint,
+    unread: &'a mut c_uint,
+}
+
+impl RecordRead<'_> {
+    /// Number of sample frames in this read.
+    pub fn frames(&self) -> c_uint {
+        self.frames
+    }
+
+    /// The samples in the format of the stream, as one region or two if they wrap around the end of the buffer.
+    /// The second region is empty if they don't.
+    pub fn data(&self) -> (&[u8], &[u8]) {
+        self.lock.data()
+    }
+
+    /// The samples as [`SoundFormat::PCM16`], which is what [`RecordStream::start`] records.
+    ///
+    /// Returns [`None`] for other formats.
+    pub fn pcm16(&self) -> Option<(&[i16], &[i16])> {
+        fn samples(bytes: &[u8]) -> Option<&[i16]> {
+            // SAFETY: any bit pattern is a valid i16
+            let (prefix, samples, suffix) = unsafe { bytes.align_to::<i16>() };
+            (prefix.is_empty() && suffix.is_empty()).then_some(samples)
+        }
+
+        let (first, second) = self.data();
+        Some((samples(first)?, samples(second)?))
+    }
+}
+
+impl Drop for RecordRead<'_> {
+    fn drop(&mut self) {
+        *self.cursor = (*self.cursor + self.frames) % self.length;
+        *self.unread -= self.frames;
+    }
+}
+
+struct BlockPool {
+    free: BoundedQueue<Box<[u8]>>,
+    filled: BoundedQueue<Box<[u8]>>,
+    dropped: AtomicU64,
+}
+
+/// Sends blocks of recorded samples to a [`RecordBlockReceiver`], see [`RecordStream::block_channel`].
+pub struct RecordBlockSender {
+    pool: Arc<BlockPool>,
+    block_frames: c_uint,
+    block_bytes: usize,
+}
+
+impl RecordBlockSender {
+    pub fn block_frames(&self) -> c_uint {
+        self.block_frames
+    }
+}
+
+/// Receives blocks of recorded samples sent by [`RecordStream::send_blocks`], usually on an encoder thread.
+///
+/// Receiving is lock-free and never blocks.
+pub struct RecordBlockReceiver {
+    pool: Arc<BlockPool>,
+    block_frames: c_uint,
+}
+
+impl RecordBlockReceiver {
+    /// Takes the oldest block that was sent, if there is one.
+    pub fn try_recv(&self) -> Option<RecordBlock<'_>> {
+        self.pool.filled.pop().map(|data| RecordBlock {
+            data: Some(data),
+            receiver: self,
+        })
+    }
+
+    pub fn block_frames(&self) -> c_uint {
+        self.block_frames
+    }
+
+    /// Blocks that were skipped because every buffer was still waiting to be received.
+    pub fn dropped_blocks(&self) -> u64 {
+        self.pool.dropped.load(Ordering::Relaxed)
+    }
+}
+
+impl std::fmt::Debug for RecordBlockSender {
+    fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+        f.debug_struct("RecordBlockSender")
+            .field("block_frames", &self.block_frames)
+            .finish_non_exhaustive()
+    }
+}
+
+impl std::fmt::Debug for RecordBlockReceiver {
+    fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+        f.debug_struct("RecordBlockReceiver")
+            .field("block_frames", &self.block_frames)
+            .field("dropped_blocks", &self.dropped_blocks())
+            .finish_non_exhaustive()
+    }
+}
+
+/// A block of recorded samples, in the format of the [`RecordStream`] that sent it.
+///
+/// The buffer goes back to the channel to be reused when this is dropped.
+#[derive(Debug)]
+pub struct RecordBlock<'a> {
+    data: Option<Box<[u8]>>,
+    receiver: &'a RecordBlockReceiver,
+}
+
+impl Deref for RecordBlock<'_> {
+    type Target = [u8];
+
+    fn deref(&self) -> &Self::Target {
+        self.data.as_deref().unwrap_or_default()
+    }
+}
+
+impl Drop for RecordBlock<'_> {
+    fn drop(&mut self) {
+        if let Some(data) = self.data.take() {
+            let _ = self.receiver.pool.free.push(data);
+        }
+    }
+}
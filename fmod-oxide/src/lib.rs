@@ -47,12 +47,16 @@
 //!
 //! # Userdata
 //!
-//! Right now this crate stores userdata in a global slotmap alongside its owner, and every so often will remove userdata with invalid owners.
+//! Right now this crate stores userdata in a global registry alongside its owner, and every so often will remove userdata with invalid owners.
 //! This solution works best with a mark and sweep GC, which Rust does not have. We could somewhat solve this issue by doing this check in `System::update`.
 //! That would make `System::update` expensive- it would have an additional `O(n)` complexity added to it, which goes against the purpose of this crate.
 //!
-//! It's difficult to associate userdata with an individual system in this system though- so we have to clear the slotmap whenever any system is released.
+//! It's difficult to associate userdata with an individual system in this system though- so we have to clear the registry whenever any system is released.
 //! Releasing a system is performed at the end of execution generally so this probably won't be an issue.
+//!
+//! With many objects holding userdata, checking every owner in `System::update` can get expensive.
+//! [`set_userdata_cleanup_budget`] limits how many owners are checked per update, resuming from where the last update stopped.
+//! Userdata owned by event instances and channels is also dropped as soon as their `DESTROYED`/`END` callback fires, when one is set through this crate.
 
 #![warn(rust_2018_idioms, clippy::pedantic)]
 #![allow(
@@ -82,11 +86,29 @@ pub use core::*;
 
 pub mod studio;
 
+mod bounded_queue;
+
+mod audio_thread;
+pub use audio_thread::{
+    AudioCommand, AudioSender, AudioThread, AudioThreadBuilder, AudioThreadStats,
+};
+
+mod callback_queue;
+pub use callback_queue::CallbackEvent;
+
+mod loading;
+pub use loading::LoadFuture;
+
+mod spatial_batch;
+pub use spatial_batch::{
+    DistanceThrottle, SpatialBatch, SpatialFlushStats, SpatialHandle, SpatialThresholds,
+};
+
 #[doc(hidden)]
 #[cfg(feature = "userdata-abstraction")]
 pub mod userdata;
 #[cfg(feature = "userdata-abstraction")]
-pub use userdata::Userdata;
+pub use userdata::{cleanup_userdata_incremental, set_userdata_cleanup_budget, Userdata};
 
 pub const VERSION: u32 = fmod_sys::FMOD_VERSION;
 pub const MAX_CHANNEL_WIDTH: u32 = fmod_sys::FMOD_MAX_CHANNEL_WIDTH;
@@ -0,0 +1,298 @@
+// Copyright (c) 2024 Lily Lyons
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+use fmod_sys::*;
+use std::{
+    future::Future,
+    pin::Pin,
+    sync::{Arc, Mutex, Weak},
+    task::{Context, Poll, Waker},
+    time::{Duration, Instant},
+};
+
+use crate::{
+    studio::{Bank, EventDescription, LoadBankFlags, LoadingState},
+    OpenState, Sound, SoundBuilder, Utf8CStr,
+};
+
+// Futures that are still waiting on FMOD. Every update checks all of them in one pass,
+// so the cost of a pending load is one state query per tick no matter how often its executor polls it.
+static PENDING_LOADS: Mutex<Vec<PendingLoad>> = Mutex::new(Vec::new());
+
+#[derive(Debug, Clone, Copy)]
+enum LoadTarget {
+    Bank(Bank),
+    BankSampleData(Bank),
+    EventSampleData(EventDescription),
+    Sound(Sound),
+}
+
+// how long sample data may read as unloaded after the request was handed to studio, before the load counts as never having started.
+// the update calls of the wrappers only hand the command over, and studio runs it on its own update period (20ms by default),
+// so this is measured in time rather than in calls and leaves plenty of room for a busy studio thread
+const SAMPLE_DATA_START_TIMEOUT: Duration = Duration::from_secs(2);
+
+// what has been seen of a sample data load so far
+#[derive(Debug, Clone, Copy)]
+struct SampleProgress {
+    // when the first update after the request ran, which is when studio got the command
+    submitted: Option<Instant>,
+    // once the sample data was seen loading, reading as unloaded means it was unloaded again
+    seen_loading: bool,
+}
+
+struct PendingLoad {
+    target: LoadTarget,
+    progress: SampleProgress,
+    // the future owns the state, so dropped futures are forgotten on the next pass
+    shared: Weak<Mutex<LoadShared>>,
+}
+
+#[derive(Default)]
+struct LoadShared {
+    result: Option<Result<()>>,
+    waker: Option<Waker>,
+}
+
+impl LoadTarget {
+    // banks and sounds that failed to load still have a handle that has to be released.
+    // the caller never sees the handle, so the future does it
+    fn resolve<T>(self, result: Result<()>, output: T) -> Result<T> {
+        if result.is_err() {
+            match self {
+                LoadTarget::Bank(bank) => {
+                    let _ = bank.unload();
+                }
+                LoadTarget::Sound(sound) => {
+                    let _ = sound.release();
+                }
+                LoadTarget::BankSampleData(_) | LoadTarget::EventSampleData(_) => {}
+            }
+        }
+        result.map(|()| output)
+    }
+
+    // None while still loading
+    fn check(self, progress: &mut SampleProgress) -> Option<Result<()>> {
+        fn sample_loading_state(
+            valid: bool,
+            state: Result<LoadingState>,
+            progress: &mut SampleProgress,
+        ) -> Option<Result<()>> {
+            // the getters zero the state (which reads as unloading) and drop the error for invalid handles
+            if !valid {
+                return Some(Err(FMOD_RESULT::FMOD_ERR_INVALID_HANDLE.into()));
+            }
+            match state {
+                Ok(LoadingState::Loaded) => Some(Ok(())),
+                Ok(LoadingState::Error(e)) | Err(e) => Some(Err(e)),
+                Ok(LoadingState::Loading) => {
+                    progress.seen_loading = true;
+                    None
+                }
+                // sample data reads as unloaded until the studio update thread gets to the load command
+                Ok(LoadingState::Unloaded)
+                    if !progress.seen_loading
+                        && progress.submitted.map_or(true, |submitted| {
+                            submitted.elapsed() < SAMPLE_DATA_START_TIMEOUT
+                        }) =>
+                {
+                    None
+                }
+                Ok(LoadingState::Unloading | LoadingState::Unloaded) => {
+                    Some(Err(FMOD_RESULT::FMOD_ERR_STUDIO_NOT_LOADED.into()))
+                }
+            }
+        }
+
+        match self {
+            LoadTarget::Bank(bank) => match bank.get_loading_state() {
+                // the bank was unloaded before it finished loading
+                Ok(LoadingState::Unloading | LoadingState::Unloaded) => {
+                    Some(Err(FMOD_RESULT::FMOD_ERR_INVALID_HANDLE.into()))
+                }
+                Ok(LoadingState::Loaded) => Some(Ok(())),
+                Ok(LoadingState::Error(e)) | Err(e) => Some(Err(e)),
+                Ok(LoadingState::Loading) => None,
+            },
+            LoadTarget::BankSampleData(bank) => {
+                sample_loading_state(bank.is_valid(), bank.get_sample_loading_state(), progress)
+            }
+            LoadTarget::EventSampleData(event) => {
+                sample_loading_state(event.is_valid(), event.get_sample_loading_state(), progress)
+            }
+            LoadTarget::Sound(sound) => match sound.get_open_state() {
+                Ok((OpenState::Loading | OpenState::Connecting, ..)) => None,
+                Ok((OpenState::Error(e), ..)) | Err(e) => Some(Err(e)),
+                Ok(_) => Some(Ok(())),
+            },
+        }
+    }
+}
+
+/// Checks every pending [`LoadFuture`] once, and wakes the ones that finished.
+pub(crate) fn poll_pending_loads() {
+    let mut wakers = Vec::new();
+    {
+        let mut pending = PENDING_LOADS.lock().unwrap();
+        pending.retain_mut(|load| {
+            let Some(shared) = load.shared.upgrade() else {
+                return false;
+            };
+            load.progress.submitted.get_or_insert_with(Instant::now);
+            let Some(result) = load.target.check(&mut load.progress) else {
+                return true;
+            };
+            let mut shared = shared.lock().unwrap();
+            shared.result = Some(result);
+            wakers.extend(shared.waker.take());
+            false
+        });
+    }
+    // wakers can run arbitrary code (including starting new loads), so they are woken without holding any locks
+    for waker in wakers {
+        waker.wake();
+    }
+}
+
+/// A [`Future`] that resolves once FMOD has finished loading something in the background.
+///
+/// These are created by [`crate::studio::System::load_bank_async`], [`Bank::load_sample_data_async`],
+/// [`EventDescription::load_sample_data_async`] and [`crate::System::create_sound_async`].
+///
+/// They work with any executor: the loading state is only checked when the future is first polled and then once per
+/// [`crate::System::update`] or [`crate::studio::System::update`], which wakes every future whose load completed.
+/// Polling the future in between is cheap and never calls into FMOD, so thousands of loads can be in flight at once.
+/// Loads only progress while the system is updated, so a future never resolves if nothing calls `update`.
+///
+/// Dropping the future does not cancel the load, and a bank or sound whose future was dropped is not released if its load fails.
+#[must_use = "futures do nothing unless polled"]
+pub struct LoadFuture<T> {
+    target: LoadTarget,
+    output: T,
+    progress: SampleProgress,
+    shared: Option<Arc<Mutex<LoadShared>>>,
+}
+
+impl<T> LoadFuture<T> {
+    fn new(target: LoadTarget, output: T) -> Self {
+        Self {
+            target,
+            output,
+            progress: SampleProgress {
+                submitted: None,
+                seen_loading: false,
+            },
+            shared: None,
+        }
+    }
+}
+
+// the future never hands out references to its fields, so it's fine to move it after it was polled
+impl<T> Unpin for LoadFuture<T> {}
+
+impl<T: Copy> Future for LoadFuture<T> {
+    type Output = Result<T>;
+
+    fn poll(self: Pin<&mut Self>, cx: &mut Context<'_>) -> Poll<Self::Output> {
+        let this = self.get_mut();
+
+        let Some(shared) = &this.shared else {
+            // the first poll checks right away, the load may be finished already
+            if let Some(result) = this.target.check(&mut this.progress) {
+                return Poll::Ready(this.target.resolve(result, this.output));
+            }
+            let shared = Arc::new(Mutex::new(LoadShared {
+                result: None,
+                waker: Some(cx.waker().clone()),
+            }));
+            PENDING_LOADS.lock().unwrap().push(PendingLoad {
+                target: this.target,
+                progress: this.progress,
+                shared: Arc::downgrade(&shared),
+            });
+            this.shared = Some(shared);
+            return Poll::Pending;
+        };
+
+        let mut shared = shared.lock().unwrap();
+        match shared.result.take() {
+            Some(result) => Poll::Ready(this.target.resolve(result, this.output)),
+            None => {
+                match &mut shared.waker {
+                    Some(waker) => waker.clone_from(cx.waker()),
+                    None => shared.waker = Some(cx.waker().clone()),
+                }
+                Poll::Pending
+            }
+        }
+    }
+}
+
+impl<T: std::fmt::Debug> std::fmt::Debug for LoadFuture<T> {
+    fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+        f.debug_struct("LoadFuture")
+            .field("target", &self.target)
+            .field("output", &self.output)
+            .field("registered", &self.shared.is_some())
+            .finish()
+    }
+}
+
+impl crate::studio::System {
+    /// Loads a bank file in the background, see [`crate::studio::System::load_bank_file`].
+    ///
+    /// [`LoadBankFlags::NONBLOCKING`] is always added to `load_flags`.
+    /// Errors found right away are returned here, errors found while loading are returned by the future,
+    /// which also unloads the failed bank.
+    pub fn load_bank_async(
+        &self,
+        filename: &Utf8CStr,
+        load_flags: LoadBankFlags,
+    ) -> Result<LoadFuture<Bank>> {
+        let bank = self.load_bank_file(filename, load_flags | LoadBankFlags::NONBLOCKING)?;
+        Ok(LoadFuture::new(LoadTarget::Bank(bank), bank))
+    }
+}
+
+impl Bank {
+    /// Loads the bank's sample data in the background, see [`Bank::load_sample_data`].
+    ///
+    /// The future resolves once [`Bank::get_sample_loading_state`] reports the sample data as loaded.
+    /// If the sample data is unloaded again, or hasn't started loading two seconds after the request was handed to Studio,
+    /// it returns [`FMOD_RESULT::FMOD_ERR_STUDIO_NOT_LOADED`].
+    pub fn load_sample_data_async(&self) -> Result<LoadFuture<()>> {
+        self.load_sample_data()?;
+        Ok(LoadFuture::new(LoadTarget::BankSampleData(*self), ()))
+    }
+}
+
+impl EventDescription {
+    /// Loads the event's sample data in the background, see [`EventDescription::load_sample_data`].
+    ///
+    /// The future resolves once [`EventDescription::get_sample_loading_state`] reports the sample data as loaded.
+    /// If the sample data is unloaded again, or hasn't started loading two seconds after the request was handed to Studio,
+    /// it returns [`FMOD_RESULT::FMOD_ERR_STUDIO_NOT_LOADED`].
+    pub fn load_sample_data_async(&self) -> Result<LoadFuture<()>> {
+        self.load_sample_data()?;
+        Ok(LoadFuture::new(LoadTarget::EventSampleData(*self), ()))
+    }
+}
+
+impl crate::System {
+    /// Creates a sound in the background, see [`crate::System::create_sound`].
+    ///
+    /// [`crate::Mode::NONBLOCKING`] is always added to the builder's mode.
+    /// The future resolves once the sound is ready to play. A sound that failed to open is released, and the future returns why it failed.
+    pub fn create_sound_async(&self, builder: &SoundBuilder<'_>) -> Result<LoadFuture<Sound>> {
+        let builder = SoundBuilder {
+            mode: builder.mode | FMOD_NONBLOCKING,
+            ..*builder
+        };
+        let sound = self.create_sound(&builder)?;
+        Ok(LoadFuture::new(LoadTarget::Sound(sound), sound))
+    }
+}
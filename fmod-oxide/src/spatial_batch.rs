@@ -0,0 +1,302 @@
+// Copyright (c) 2024 Lily Lyons
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+use fmod_sys::*;
+use std::{collections::HashMap, ffi::c_float};
+
+use crate::{studio::EventInstance, Attributes3D, Channel, ChannelControl, ChannelGroup, Vector};
+
+/// Something a [`SpatialBatch`] can move.
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Hash)]
+pub enum SpatialHandle {
+    /// Set with [`EventInstance::set_3d_attributes`].
+    Event(EventInstance),
+    /// Set with [`ChannelControl::set_3d_attributes`]. Only the position and velocity are used.
+    ChannelControl(ChannelControl),
+}
+
+impl From<EventInstance> for SpatialHandle {
+    fn from(value: EventInstance) -> Self {
+        Self::Event(value)
+    }
+}
+
+impl From<ChannelControl> for SpatialHandle {
+    fn from(value: ChannelControl) -> Self {
+        Self::ChannelControl(value)
+    }
+}
+
+impl From<Channel> for SpatialHandle {
+    fn from(value: Channel) -> Self {
+        Self::ChannelControl(*value)
+    }
+}
+
+impl From<ChannelGroup> for SpatialHandle {
+    fn from(value: ChannelGroup) -> Self {
+        Self::ChannelControl(*value)
+    }
+}
+
+/// Sends the attributes of far away handles less often, see [`SpatialBatch::set_distance_throttle`].
+///
+/// Handles closer than `near` to the listener are sent every flush, handles further than `far` every `far_interval` flushes,
+/// and handles in between at an interval that grows linearly with distance.
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub struct DistanceThrottle {
+    pub listener: Vector,
+    pub near: c_float,
+    pub far: c_float,
+    pub far_interval: u32,
+}
+
+/// How much attributes must change before a [`SpatialBatch`] sends them again.
+///
+/// The defaults only skip updates that change nothing.
+#[derive(Debug, Clone, Copy, PartialEq, Default)]
+pub struct SpatialThresholds {
+    /// Distance the position must move.
+    pub position: c_float,
+    /// Change in velocity, in units per second.
+    pub velocity: c_float,
+    /// Distance the tip of the forward or up vector must move. Both are unit length, so this is roughly the angle in radians.
+    pub orientation: c_float,
+}
+
+#[derive(Debug, Clone, Copy)]
+struct Entry {
+    handle: SpatialHandle,
+    pending: Attributes3D,
+    sent: Option<Attributes3D>,
+    dirty: bool,
+    last_flush: u64,
+}
+
+/// Statistics of one [`SpatialBatch::flush`].
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Default)]
+pub struct SpatialFlushStats {
+    /// Attributes sent to FMOD.
+    pub sent: usize,
+    /// Updates dropped because they changed less than the [`SpatialThresholds`].
+    pub below_threshold: usize,
+    /// Updates held back by the [`DistanceThrottle`], to be sent in a later flush.
+    pub throttled: usize,
+    /// Handles removed from the batch because FMOD reported them as invalid (released events, stolen channels).
+    pub removed: usize,
+}
+
+/// Collects a frame's worth of 3D attribute updates, and sends them to FMOD in one pass right before [`crate::studio::System::update`].
+///
+/// Pushing the same handle more than once in a frame only keeps the last attributes.
+/// The batch remembers the attributes last sent to each handle, so updates that move less than the [`SpatialThresholds`] don't cost an FFI call,
+/// and an optional [`DistanceThrottle`] sends far away handles less often.
+/// An update that is held back is not lost: the latest attributes of a handle are kept until they are sent.
+///
+/// Handles are remembered until they are removed with [`SpatialBatch::remove`], or until FMOD reports them as invalid while flushing.
+///
+/// ```rust,ignore
+/// batch.push(footsteps, attributes);
+/// batch.push(channel, attributes);
+/// batch.flush()?;
+/// studio.update()?;
+/// ```
+#[derive(Debug, Clone, Default)]
+pub struct SpatialBatch {
+    entries: Vec<Entry>,
+    indices: HashMap<SpatialHandle, usize>,
+    thresholds: SpatialThresholds,
+    throttle: Option<DistanceThrottle>,
+    flush_count: u64,
+}
+
+fn distance_squared(a: Vector, b: Vector) -> c_float {
+    let (x, y, z) = (a.x - b.x, a.y - b.y, a.z - b.z);
+    x * x + y * y + z * z
+}
+
+impl SpatialBatch {
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    pub fn with_thresholds(thresholds: SpatialThresholds) -> Self {
+        Self {
+            thresholds,
+            ..Self::default()
+        }
+    }
+
+    pub fn set_thresholds(&mut self, thresholds: SpatialThresholds) {
+        self.thresholds = thresholds;
+    }
+
+    pub fn thresholds(&self) -> SpatialThresholds {
+        self.thresholds
+    }
+
+    /// Sets or clears the distance throttle.
+    ///
+    /// The listener position usually changes every frame, so update the throttle before flushing.
+    pub fn set_distance_throttle(&mut self, throttle: Option<DistanceThrottle>) {
+        self.throttle = throttle;
+    }
+
+    pub fn distance_throttle(&self) -> Option<DistanceThrottle> {
+        self.throttle
+    }
+
+    /// Number of handles the batch remembers.
+    pub fn len(&self) -> usize {
+        self.entries.len()
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.entries.is_empty()
+    }
+
+    /// Queues `attributes` to be sent to `handle` on the next flush, replacing any attributes queued for it this frame.
+    pub fn push(&mut self, handle: impl Into<SpatialHandle>, attributes: Attributes3D) {
+        let handle = handle.into();
+        if let Some(&index) = self.indices.get(&handle) {
+            let entry = &mut self.entries[index];
+            entry.pending = attributes;
+            entry.dirty = true;
+            return;
+        }
+        self.indices.insert(handle, self.entries.len());
+        self.entries.push(Entry {
+            handle,
+            pending: attributes,
+            sent: None,
+            dirty: true,
+            last_flush: 0,
+        });
+    }
+
+    /// Forgets `handle`, dropping any update queued for it. Do this before releasing an event or stopping a channel.
+    pub fn remove(&mut self, handle: impl Into<SpatialHandle>) {
+        if let Some(index) = self.indices.remove(&handle.into()) {
+            self.remove_index(index);
+        }
+    }
+
+    pub fn clear(&mut self) {
+        self.entries.clear();
+        self.indices.clear();
+    }
+
+    fn remove_index(&mut self, index: usize) {
+        self.entries.swap_remove(index);
+        if let Some(moved) = self.entries.get(index) {
+            self.indices.insert(moved.handle, index);
+        }
+    }
+
+    fn changed(&self, entry: &Entry) -> bool {
+        let Some(sent) = entry.sent else {
+            return true;
+        };
+        let new = entry.pending;
+        let thresholds = self.thresholds;
+        // distances are compared squared, and strictly so a zero threshold still drops identical updates
+        let moved = |a, b, threshold: c_float| distance_squared(a, b) > threshold * threshold;
+        moved(new.position, sent.position, thresholds.position)
+            || moved(new.velocity, sent.velocity, thresholds.velocity)
+            || moved(new.forward, sent.forward, thresholds.orientation)
+            || moved(new.up, sent.up, thresholds.orientation)
+    }
+
+    fn interval(&self, position: Vector) -> u64 {
+        let Some(throttle) = self.throttle else {
+            return 1;
+        };
+        let distance = distance_squared(position, throttle.listener).sqrt();
+        if distance <= throttle.near {
+            return 1;
+        }
+        let far_interval = throttle.far_interval.max(1) as c_float;
+        let t = if throttle.far > throttle.near {
+            ((distance - throttle.near) / (throttle.far - throttle.near)).min(1.0)
+        } else {
+            1.0
+        };
+        (1.0 + t * (far_interval - 1.0)).round() as u64
+    }
+
+    /// Sends every queued update that passes the thresholds and throttle.
+    ///
+    /// Every update is attempted even if some fail. Handles FMOD reports as invalid are removed, and the first other error is returned.
+    pub fn flush(&mut self) -> Result<SpatialFlushStats> {
+        self.flush_count += 1;
+        let mut stats = SpatialFlushStats::default();
+        let mut first_error = FMOD_RESULT::FMOD_OK;
+
+        let mut index = 0;
+        while index < self.entries.len() {
+            let entry = self.entries[index];
+            if !entry.dirty {
+                index += 1;
+                continue;
+            }
+            if !self.changed(&entry) {
+                self.entries[index].dirty = false;
+                stats.below_threshold += 1;
+                index += 1;
+                continue;
+            }
+            if entry.sent.is_some()
+                && self.flush_count - entry.last_flush < self.interval(entry.pending.position)
+            {
+                stats.throttled += 1;
+                index += 1;
+                continue;
+            }
+
+            let result = match entry.handle {
+                SpatialHandle::Event(event) => {
+                    let mut attributes = entry.pending.into();
+                    unsafe {
+                        FMOD_Studio_EventInstance_Set3DAttributes(event.inner, &mut attributes)
+                    }
+                }
+                SpatialHandle::ChannelControl(control) => unsafe {
+                    FMOD_ChannelControl_Set3DAttributes(
+                        control.inner,
+                        std::ptr::from_ref(&entry.pending.position).cast(),
+                        std::ptr::from_ref(&entry.pending.velocity).cast(),
+                    )
+                },
+            };
+
+            match result {
+                FMOD_RESULT::FMOD_OK => {
+                    let entry = &mut self.entries[index];
+                    entry.sent = Some(entry.pending);
+                    entry.dirty = false;
+                    entry.last_flush = self.flush_count;
+                    stats.sent += 1;
+                    index += 1;
+                }
+                FMOD_RESULT::FMOD_ERR_INVALID_HANDLE | FMOD_RESULT::FMOD_ERR_CHANNEL_STOLEN => {
+                    self.indices.remove(&entry.handle);
+                    // the last entry is moved here, so don't advance
+                    self.remove_index(index);
+                    stats.removed += 1;
+                }
+                error => {
+                    if first_error == FMOD_RESULT::FMOD_OK {
+                        first_error = error;
+                    }
+                    // try again next flush
+                    index += 1;
+                }
+            }
+        }
+
+        first_error.to_result().map(|()| stats)
+    }
+}
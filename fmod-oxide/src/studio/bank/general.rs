@@ -10,7 +10,7 @@ use std::ffi::c_void;
 use std::mem::MaybeUninit;
 
 use crate::studio::Bank;
-use crate::Guid;
+use crate::{get_string_retrieved_into, Guid};
 
 impl Bank {
     /// Retrieves the GUID.
@@ -67,6 +67,15 @@ impl Bank {
         }
     }
 
+    /// Like [`Bank::get_path`], but writes the path into `path`, reusing its allocation.
+    ///
+    /// Once `path` has grown large enough this does not allocate, which makes enumerating paths cheap.
+    pub fn get_path_into(&self, path: &mut String) -> Result<()> {
+        get_string_retrieved_into(path, |buffer, len, retrieved| unsafe {
+            FMOD_Studio_Bank_GetPath(self.inner, buffer, len, retrieved)
+        })
+    }
+
     /// Checks that the Bank reference is valid.
     pub fn is_valid(&self) -> bool {
         unsafe { FMOD_Studio_Bank_IsValid(self.inner).into() }
@@ -108,4 +117,17 @@ impl Bank {
         let pointer = self.get_raw_userdata()?;
         Ok(get_userdata(pointer.into()))
     }
+
+    /// Runs `f` with a borrow of the userdata, without cloning the [`std::sync::Arc`].
+    ///
+    /// This never blocks, even while another thread is setting or removing userdata.
+    pub fn with_userdata<R>(
+        &self,
+        f: impl FnOnce(&crate::userdata::Userdata) -> R,
+    ) -> Result<Option<R>> {
+        use crate::userdata::with_userdata;
+
+        let pointer = self.get_raw_userdata()?;
+        Ok(with_userdata(pointer.into(), f))
+    }
 }
@@ -0,0 +1,231 @@
+// Copyright (c) 2024 Lily Lyons
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+use fmod_sys::*;
+use lanyard::{Utf8CStr, Utf8CString};
+
+use crate::studio::{Bank, LoadBankFlags, LoadingState, System};
+
+/// Loads a set of banks in parallel, created with [`System::bank_load_plan`].
+///
+/// Every bank is submitted with [`LoadBankFlags::NONBLOCKING`] at once, so FMOD can load them back to back on its loading thread
+/// without waiting on the calling thread in between.
+/// [`BankLoadPlan::poll`] then checks on every bank, and starts loading sample data for a bank as soon as its metadata has loaded.
+///
+/// ```rust,ignore
+/// let mut plan = system.bank_load_plan();
+/// plan.add(c!("Master.bank"), true).add(c!("Master.strings.bank"), false);
+/// plan.submit(LoadBankFlags::NORMAL);
+/// loop {
+///     system.update()?;
+///     let progress = plan.poll();
+///     draw_loading_screen(progress.fraction());
+///     if progress.is_finished() {
+///         break;
+///     }
+/// }
+/// ```
+#[derive(Debug)]
+pub struct BankLoadPlan {
+    system: System,
+    entries: Vec<BankLoadEntry>,
+}
+
+#[derive(Debug)]
+struct BankLoadEntry {
+    path: Utf8CString,
+    load_sample_data: bool,
+    bank: Option<Bank>,
+    status: BankLoadStatus,
+}
+
+/// The state of a single bank in a [`BankLoadPlan`].
+#[derive(Debug, Clone, PartialEq)]
+pub enum BankLoadStatus {
+    /// [`BankLoadPlan::submit`] has not been called yet.
+    Pending,
+    /// The bank's metadata is loading.
+    Loading,
+    /// The bank's metadata is loaded, and its sample data is loading.
+    LoadingSampleData,
+    /// The bank (and its sample data if requested) is loaded.
+    Loaded,
+    /// Loading the bank or its sample data failed.
+    Failed(Error),
+}
+
+impl BankLoadStatus {
+    pub fn is_done(&self) -> bool {
+        matches!(self, BankLoadStatus::Loaded | BankLoadStatus::Failed(_))
+    }
+}
+
+/// Aggregate progress of a [`BankLoadPlan`], returned by [`BankLoadPlan::poll`].
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Default)]
+pub struct BankLoadProgress {
+    /// Number of banks in the plan.
+    pub total: usize,
+    /// Number of banks that have fully loaded.
+    pub loaded: usize,
+    /// Number of banks that failed to load.
+    pub failed: usize,
+    /// Loading steps completed, where each bank has one step for its metadata and one for its sample data if requested.
+    pub steps_done: usize,
+    /// Total loading steps.
+    pub steps_total: usize,
+}
+
+impl BankLoadProgress {
+    /// Whether every bank has either loaded or failed.
+    pub fn is_finished(&self) -> bool {
+        self.loaded + self.failed == self.total
+    }
+
+    /// Progress from `0.0` to `1.0`.
+    pub fn fraction(&self) -> f32 {
+        if self.steps_total == 0 {
+            1.0
+        } else {
+            self.steps_done as f32 / self.steps_total as f32
+        }
+    }
+}
+
+impl System {
+    pub fn bank_load_plan(&self) -> BankLoadPlan {
+        BankLoadPlan::new(*self)
+    }
+}
+
+impl BankLoadPlan {
+    pub fn new(system: System) -> Self {
+        Self {
+            system,
+            entries: Vec::new(),
+        }
+    }
+
+    /// Adds a bank file to the plan, optionally loading its sample data once the bank has loaded.
+    pub fn add(&mut self, path: &Utf8CStr, load_sample_data: bool) -> &mut Self {
+        self.entries.push(BankLoadEntry {
+            path: path.to_cstring(),
+            load_sample_data,
+            bank: None,
+            status: BankLoadStatus::Pending,
+        });
+        self
+    }
+
+    pub fn len(&self) -> usize {
+        self.entries.len()
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.entries.is_empty()
+    }
+
+    /// Starts loading every pending bank with `flags` and [`LoadBankFlags::NONBLOCKING`].
+    ///
+    /// Banks that fail to submit are marked as [`BankLoadStatus::Failed`], the rest are still submitted.
+    pub fn submit(&mut self, flags: LoadBankFlags) {
+        let flags = flags | LoadBankFlags::NONBLOCKING;
+        for entry in &mut self.entries {
+            if entry.status != BankLoadStatus::Pending {
+                continue;
+            }
+            match self.system.load_bank_file(&entry.path, flags) {
+                Ok(bank) => {
+                    entry.bank = Some(bank);
+                    entry.status = BankLoadStatus::Loading;
+                }
+                Err(e) => entry.status = BankLoadStatus::Failed(e),
+            }
+        }
+    }
+
+    /// Checks on every bank that is still loading, and starts loading sample data for banks whose metadata has loaded.
+    ///
+    /// Loading progresses in [`System::update`], this function only queries it.
+    pub fn poll(&mut self) -> BankLoadProgress {
+        let mut progress = BankLoadProgress {
+            total: self.entries.len(),
+            ..Default::default()
+        };
+
+        for entry in &mut self.entries {
+            entry.poll();
+
+            progress.steps_total += 1 + usize::from(entry.load_sample_data);
+            match entry.status {
+                BankLoadStatus::Pending | BankLoadStatus::Loading => {}
+                BankLoadStatus::LoadingSampleData => progress.steps_done += 1,
+                BankLoadStatus::Loaded => {
+                    progress.loaded += 1;
+                    progress.steps_done += 1 + usize::from(entry.load_sample_data);
+                }
+                BankLoadStatus::Failed(_) => {
+                    // failed banks won't make any more progress, so count them as done
+                    progress.failed += 1;
+                    progress.steps_done += 1 + usize::from(entry.load_sample_data);
+                }
+            }
+        }
+
+        progress
+    }
+
+    /// Retrieves the status of every bank, in the order they were added.
+    pub fn statuses(&self) -> impl Iterator<Item = (&Utf8CStr, &BankLoadStatus)> {
+        self.entries
+            .iter()
+            .map(|entry| (entry.path.as_utf8_cstr(), &entry.status))
+    }
+
+    /// Retrieves every bank that failed to load, and why.
+    pub fn errors(&self) -> impl Iterator<Item = (&Utf8CStr, &Error)> {
+        self.entries.iter().filter_map(|entry| match &entry.status {
+            BankLoadStatus::Failed(e) => Some((entry.path.as_utf8_cstr(), e)),
+            _ => None,
+        })
+    }
+
+    /// Retrieves the handle of every bank that was submitted, in the order they were added.
+    ///
+    /// Banks that failed to load asynchronously still have a handle, which should be released with [`Bank::unload`].
+    pub fn banks(&self) -> impl Iterator<Item = Bank> + '_ {
+        self.entries.iter().filter_map(|entry| entry.bank)
+    }
+}
+
+impl BankLoadEntry {
+    fn poll(&mut self) {
+        let Some(bank) = self.bank else {
+            return;
+        };
+
+        if self.status == BankLoadStatus::Loading {
+            match bank.get_loading_state() {
+                Ok(LoadingState::Loaded) if self.load_sample_data => {
+                    self.status = match bank.load_sample_data() {
+                        Ok(()) => BankLoadStatus::LoadingSampleData,
+                        Err(e) => BankLoadStatus::Failed(e),
+                    };
+                }
+                Ok(LoadingState::Loaded) => self.status = BankLoadStatus::Loaded,
+                Ok(LoadingState::Error(e)) | Err(e) => self.status = BankLoadStatus::Failed(e),
+                Ok(_) => {}
+            }
+        }
+
+        if self.status == BankLoadStatus::LoadingSampleData {
+            match bank.get_sample_loading_state() {
+                Ok(LoadingState::Loaded) => self.status = BankLoadStatus::Loaded,
+                Ok(LoadingState::Error(e)) | Err(e) => self.status = BankLoadStatus::Failed(e),
+                Ok(_) => {}
+            }
+        }
+    }
+}
@@ -54,8 +54,12 @@ impl Bank {
     ///
     /// If the bank was loaded from user-managed memory, e.g. by [`super::System::load_bank_pointer`], then the memory must not be freed until the unload has completed.
     /// Poll the loading state using [`Bank::get_loading_state`] or use the [`FMOD_STUDIO_SYSTEM_CALLBACK_BANK_UNLOAD`] system callback to determine when it is safe to free the memory.
+    ///
+    /// Banks loaded with [`super::System::load_bank_mmap`] are unmapped automatically once the unload has completed.
     pub fn unload(self) -> Result<()> {
         // we don't deallocate userdata here because the system callback will take care of that for us
-        unsafe { FMOD_Studio_Bank_Unload(self.inner).to_result() }
+        unsafe { FMOD_Studio_Bank_Unload(self.inner).to_result()? };
+        super::mapped::mark_unloading(self);
+        Ok(())
     }
 }
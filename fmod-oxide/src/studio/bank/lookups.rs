@@ -7,7 +7,7 @@
 use std::{ffi::c_int, mem::MaybeUninit};
 
 use crate::studio::{Bank, Bus, EventDescription, Vca};
-use crate::Guid;
+use crate::{get_string_retrieved_into, Guid};
 use fmod_sys::*;
 use lanyard::Utf8CString;
 
@@ -152,6 +152,25 @@ impl Bank {
         }
     }
 
+    /// Like [`Bank::get_string_info`], but writes the path into `path`, reusing its allocation.
+    ///
+    /// Once `path` has grown large enough this does not allocate, which makes enumerating the string table cheap.
+    pub fn get_string_info_into(&self, index: c_int, path: &mut String) -> Result<Guid> {
+        let mut guid = MaybeUninit::zeroed();
+        get_string_retrieved_into(path, |buffer, len, retrieved| unsafe {
+            FMOD_Studio_Bank_GetStringInfo(
+                self.inner,
+                index,
+                guid.as_mut_ptr(),
+                buffer,
+                len,
+                retrieved,
+            )
+        })?;
+        // even if fmod didn't write to guid, guid should be safe to zero initialize.
+        Ok(unsafe { guid.assume_init() }.into())
+    }
+
     /// Retrieves the number of VCAs in the bank.
     pub fn vca_count(&self) -> Result<c_int> {
         let mut count = 0;
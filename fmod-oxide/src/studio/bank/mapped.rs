@@ -0,0 +1,192 @@
+// Copyright (c) 2024 Lily Lyons
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+use fmod_sys::*;
+use std::sync::Mutex;
+
+use crate::studio::{Bank, LoadingState, System};
+
+// Banks loaded with `System::load_bank_mmap` reference their mapping directly, so it has to outlive the bank.
+// FMOD only finishes unloading a bank some time after `Bank::unload`,
+// so unloaded banks keep their mapping here until FMOD reports the unload as complete.
+static MAPPED_BANKS: Mutex<Vec<MappedBank>> = Mutex::new(Vec::new());
+
+struct MappedBank {
+    system: System,
+    bank: Bank,
+    mapping: BankMapping,
+    unloading: bool,
+}
+
+/// A read-only view of a bank file, aligned to [`FMOD_STUDIO_LOAD_MEMORY_ALIGNMENT`].
+///
+/// On unix platforms the file is memory mapped, elsewhere it is read into an aligned allocation.
+pub(crate) struct BankMapping {
+    ptr: *mut u8,
+    len: usize,
+}
+
+// the mapping is read only, and only ever freed once
+unsafe impl Send for BankMapping {}
+unsafe impl Sync for BankMapping {}
+
+fn io_error(error: &std::io::Error) -> Error {
+    match error.kind() {
+        std::io::ErrorKind::NotFound => FMOD_RESULT::FMOD_ERR_FILE_NOTFOUND.into(),
+        _ => FMOD_RESULT::FMOD_ERR_FILE_BAD.into(),
+    }
+}
+
+impl BankMapping {
+    #[cfg(unix)]
+    pub(crate) fn new(path: &std::path::Path) -> Result<Self> {
+        use std::os::fd::AsRawFd;
+
+        let file = std::fs::File::open(path).map_err(|e| io_error(&e))?;
+        let len = file.metadata().map_err(|e| io_error(&e))?.len();
+        let len = usize::try_from(len).map_err(|_| Error::Fmod(FMOD_RESULT::FMOD_ERR_FILE_BAD))?;
+        if len == 0 {
+            return Err(FMOD_RESULT::FMOD_ERR_FILE_BAD.into());
+        }
+
+        // mappings are page aligned, which is always more than FMOD_STUDIO_LOAD_MEMORY_ALIGNMENT.
+        // the mapping stays valid after the file is closed
+        let ptr = unsafe {
+            libc::mmap(
+                std::ptr::null_mut(),
+                len,
+                libc::PROT_READ,
+                libc::MAP_PRIVATE,
+                file.as_raw_fd(),
+                0,
+            )
+        };
+        if ptr == libc::MAP_FAILED {
+            return Err(io_error(&std::io::Error::last_os_error()));
+        }
+        Ok(Self {
+            ptr: ptr.cast(),
+            len,
+        })
+    }
+
+    #[cfg(not(unix))]
+    pub(crate) fn new(path: &std::path::Path) -> Result<Self> {
+        use std::io::Read;
+
+        let mut file = std::fs::File::open(path).map_err(|e| io_error(&e))?;
+        let len = file.metadata().map_err(|e| io_error(&e))?.len();
+        let len = usize::try_from(len).map_err(|_| Error::Fmod(FMOD_RESULT::FMOD_ERR_FILE_BAD))?;
+        if len == 0 {
+            return Err(FMOD_RESULT::FMOD_ERR_FILE_BAD.into());
+        }
+
+        let ptr = unsafe { std::alloc::alloc(Self::layout(len)) };
+        if ptr.is_null() {
+            return Err(FMOD_RESULT::FMOD_ERR_MEMORY.into());
+        }
+        let mapping = Self { ptr, len };
+        let buffer = unsafe { std::slice::from_raw_parts_mut(ptr, len) };
+        file.read_exact(buffer).map_err(|e| io_error(&e))?;
+        Ok(mapping)
+    }
+
+    #[cfg(not(unix))]
+    fn layout(len: usize) -> std::alloc::Layout {
+        std::alloc::Layout::from_size_align(len, FMOD_STUDIO_LOAD_MEMORY_ALIGNMENT as usize)
+            .unwrap()
+    }
+
+    pub(crate) fn as_ptr(&self) -> *const [u8] {
+        std::ptr::slice_from_raw_parts(self.ptr, self.len)
+    }
+}
+
+impl Drop for BankMapping {
+    fn drop(&mut self) {
+        #[cfg(unix)]
+        unsafe {
+            libc::munmap(self.ptr.cast(), self.len);
+        }
+        #[cfg(not(unix))]
+        unsafe {
+            std::alloc::dealloc(self.ptr, Self::layout(self.len));
+        }
+    }
+}
+
+// the helpers below collect mappings to drop while the registry is locked, and drop them after unlocking.
+
+pub(crate) fn register_mapping(system: System, bank: Bank, mapping: BankMapping) {
+    MAPPED_BANKS.lock().unwrap().push(MappedBank {
+        system,
+        bank,
+        mapping,
+        unloading: false,
+    });
+}
+
+pub(crate) fn mark_unloading(bank: Bank) {
+    let mut banks = MAPPED_BANKS.lock().unwrap();
+    if let Some(mapped) = banks.iter_mut().find(|m| m.bank == bank) {
+        mapped.unloading = true;
+    }
+}
+
+pub(crate) fn mark_system_unloading(system: System) {
+    let mut banks = MAPPED_BANKS.lock().unwrap();
+    for mapped in banks.iter_mut().filter(|m| m.system == system) {
+        mapped.unloading = true;
+    }
+}
+
+// called from the bank unload system callback, once FMOD is done with the bank
+pub(crate) fn release_mapping(bank: Bank) {
+    let mapping = {
+        let mut banks = MAPPED_BANKS.lock().unwrap();
+        let index = banks.iter().position(|m| m.bank == bank);
+        index.map(|i| banks.swap_remove(i))
+    };
+    drop(mapping);
+}
+
+// drops the mappings of banks that have finished unloading
+pub(crate) fn reclaim_mappings(system: System) {
+    let finished: Vec<MappedBank> = {
+        let mut banks = MAPPED_BANKS.lock().unwrap();
+        let mut finished = Vec::new();
+        let mut i = 0;
+        while i < banks.len() {
+            let mapped = &banks[i];
+            // an unloaded bank either reports itself as unloaded, or its handle is no longer valid
+            // (get_loading_state reads an invalid handle as unloading, so that has to be checked first)
+            let done = mapped.system == system
+                && mapped.unloading
+                && (!mapped.bank.is_valid()
+                    || matches!(mapped.bank.get_loading_state(), Ok(LoadingState::Unloaded)));
+            if done {
+                finished.push(banks.swap_remove(i));
+            } else {
+                i += 1;
+            }
+        }
+        finished
+    };
+    drop(finished);
+}
+
+// called after the system is released, when every bank it loaded is gone
+pub(crate) fn release_system_mappings(system: System) {
+    let released: Vec<MappedBank> = {
+        let mut banks = MAPPED_BANKS.lock().unwrap();
+        let (released, kept) = std::mem::take(&mut *banks)
+            .into_iter()
+            .partition(|m| m.system == system);
+        *banks = kept;
+        released
+    };
+    drop(released);
+}
@@ -7,8 +7,12 @@
 use fmod_sys::*;
 
 mod general;
+mod load_plan;
 mod loading;
 mod lookups; // general lookups that are too small to be their own module
+pub(crate) mod mapped;
+
+pub use load_plan::{BankLoadPlan, BankLoadProgress, BankLoadStatus};
 
 #[derive(Debug, PartialEq, Eq, Clone, Copy, Hash)]
 #[repr(transparent)] // so we can transmute between types
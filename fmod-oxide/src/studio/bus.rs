@@ -12,7 +12,7 @@ use std::{
 use fmod_sys::*;
 use lanyard::Utf8CString;
 
-use crate::{core::ChannelGroup, Guid};
+use crate::{core::ChannelGroup, get_string_retrieved_into, Guid};
 
 use super::{MemoryUsage, StopMode};
 
@@ -255,6 +255,15 @@ impl Bus {
         }
     }
 
+    /// Like [`Bus::get_path`], but writes the path into `path`, reusing its allocation.
+    ///
+    /// Once `path` has grown large enough this does not allocate, which makes enumerating paths cheap.
+    pub fn get_path_into(&self, path: &mut String) -> Result<()> {
+        get_string_retrieved_into(path, |buffer, len, retrieved| unsafe {
+            FMOD_Studio_Bus_GetPath(self.inner, buffer, len, retrieved)
+        })
+    }
+
     /// Checks that the [`Bus`] reference is valid.
     pub fn is_valid(&self) -> bool {
         unsafe { FMOD_Studio_Bus_IsValid(self.inner).into() }
@@ -14,7 +14,7 @@ use crate::{
 };
 
 #[cfg(feature = "userdata-abstraction")]
-use crate::userdata::{get_userdata, insert_userdata, set_userdata, Userdata};
+use crate::userdata::{get_userdata, insert_userdata, set_userdata, with_userdata, Userdata};
 
 #[cfg(feature = "userdata-abstraction")]
 pub trait CreateInstanceCallback {
@@ -173,6 +173,14 @@ impl CommandReplay {
         let pointer = self.get_raw_userdata()?;
         Ok(get_userdata(pointer.into()))
     }
+
+    /// Runs `f` with a borrow of the userdata, without cloning the [`std::sync::Arc`].
+    ///
+    /// This never blocks, even while another thread is setting or removing userdata.
+    pub fn with_userdata<R>(&self, f: impl FnOnce(&Userdata) -> R) -> Result<Option<R>> {
+        let pointer = self.get_raw_userdata()?;
+        Ok(with_userdata(pointer.into(), f))
+    }
 }
 
 impl CommandReplay {
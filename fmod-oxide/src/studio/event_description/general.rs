@@ -10,7 +10,7 @@ use fmod_sys::*;
 use lanyard::Utf8CString;
 
 use crate::studio::EventDescription;
-use crate::Guid;
+use crate::{get_string_retrieved_into, Guid};
 
 impl EventDescription {
     /// Retrieves the GUID.
@@ -85,6 +85,15 @@ impl EventDescription {
         }
     }
 
+    /// Like [`EventDescription::get_path`], but writes the path into `path`, reusing its allocation.
+    ///
+    /// Once `path` has grown large enough this does not allocate, which makes enumerating paths cheap.
+    pub fn get_path_into(&self, path: &mut String) -> Result<()> {
+        get_string_retrieved_into(path, |buffer, len, retrieved| unsafe {
+            FMOD_Studio_EventDescription_GetPath(self.inner, buffer, len, retrieved)
+        })
+    }
+
     /// Checks that the [`EventDescription`] reference is valid.
     pub fn is_valid(&self) -> bool {
         unsafe { FMOD_Studio_EventDescription_IsValid(self.inner).into() }
@@ -7,7 +7,7 @@
 use fmod_sys::*;
 use std::ffi::c_int;
 
-use crate::studio::{EventDescription, EventInstance};
+use crate::studio::{EventDescription, EventInstance, EventInstancePool};
 
 impl EventDescription {
     /// Creates a playable instance.
@@ -25,6 +25,17 @@ impl EventDescription {
         }
     }
 
+    /// Creates an [`EventInstancePool`] with `prewarm` instances already created, which will never hold more than `capacity` instances.
+    ///
+    /// Use this instead of [`EventDescription::create_instance`] for events that are played many times a frame.
+    pub fn create_instance_pool(
+        &self,
+        prewarm: usize,
+        capacity: usize,
+    ) -> Result<EventInstancePool> {
+        EventInstancePool::new(*self, prewarm, capacity)
+    }
+
     /// Retrieves the number of instances.
     pub fn instance_count(&self) -> Result<c_int> {
         let mut count = 0;
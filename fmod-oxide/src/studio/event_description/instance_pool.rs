@@ -0,0 +1,289 @@
+// Copyright (c) 2024 Lily Lyons
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+use fmod_sys::*;
+use std::{
+    collections::VecDeque,
+    ffi::{c_float, c_void},
+    sync::{Arc, Mutex, PoisonError},
+};
+
+use crate::studio::{
+    EventCallbackMask, EventDescription, EventInstance, ParameterFlags, ParameterID, PlaybackState,
+    StopMode,
+};
+
+// FMOD_Studio_EventInstance_SetParametersByIDs takes at most this many parameters at once
+const MAX_PARAMETERS_PER_CALL: usize = 32;
+
+// instances that fired their stopped callback since the last reclaim.
+// every pooled instance holds a strong reference in its userdata, which is dropped by its destroyed callback,
+// so this outlives the pool until FMOD is done with every instance.
+type StoppedList = Mutex<Vec<EventInstance>>;
+
+/// A pool of pre-created [`EventInstance`]s of one [`EventDescription`], for events that are played often (footsteps, impacts, etc).
+///
+/// [`EventInstancePool::acquire`] hands out an instance that is not playing.
+/// Once an acquired instance stops, FMOD's stopped callback queues it to be recycled:
+/// the next [`EventInstancePool::acquire`] (or [`EventInstancePool::reclaim`]) resets its parameters to their defaults and makes it available again.
+/// Instances are never released while the pool is alive, so playing an event costs no instance creation or FMOD-side allocation.
+///
+/// The pool never holds more than its capacity. When every instance is in use, the instance that was acquired the longest ago is stopped immediately and handed out again.
+///
+/// The pool owns the userdata and callback of its instances.
+/// Do not set either on a pooled instance, and do not [`EventInstance::release`] it, use [`EventInstancePool::release`] instead.
+/// Because the pool sets a callback on its instances, a callback set with [`EventDescription::set_callback`] does not fire for them.
+///
+/// An acquired instance should be started before the next [`crate::studio::System::update`].
+/// If it is not going to be started, give it back with [`EventInstancePool::release`].
+#[derive(Debug)]
+pub struct EventInstancePool {
+    description: EventDescription,
+    capacity: usize,
+    free: Vec<EventInstance>,
+    // in acquire order, the front is the oldest
+    active: VecDeque<EventInstance>,
+    stopped: Arc<StoppedList>,
+    // swapped with the stopped list, so reclaiming does not allocate
+    reclaimed: Vec<EventInstance>,
+    default_ids: Vec<ParameterID>,
+    default_values: Vec<c_float>,
+    steal_count: usize,
+}
+
+impl EventInstancePool {
+    /// Creates a pool with `prewarm` instances already created, which will never hold more than `capacity` instances.
+    ///
+    /// `capacity` is at least 1, and `prewarm` is at most `capacity`.
+    pub fn new(description: EventDescription, prewarm: usize, capacity: usize) -> Result<Self> {
+        let capacity = capacity.max(1);
+        let prewarm = prewarm.min(capacity);
+
+        let mut default_ids = Vec::new();
+        let mut default_values = Vec::new();
+        for index in 0..description.parameter_description_count()? {
+            let parameter = description.get_parameter_description_by_index(index)?;
+            // these can't be set on an instance
+            let fixed =
+                ParameterFlags::READONLY | ParameterFlags::AUTOMATIC | ParameterFlags::GLOBAL;
+            if !parameter.flags.intersects(fixed) {
+                default_ids.push(parameter.id);
+                default_values.push(parameter.default_value);
+            }
+        }
+
+        let mut pool = Self {
+            description,
+            capacity,
+            free: Vec::with_capacity(capacity),
+            active: VecDeque::with_capacity(capacity),
+            stopped: Arc::new(Mutex::new(Vec::with_capacity(capacity))),
+            reclaimed: Vec::with_capacity(capacity),
+            default_ids,
+            default_values,
+            steal_count: 0,
+        };
+        for _ in 0..prewarm {
+            let instance = pool.create_pooled()?;
+            pool.free.push(instance);
+        }
+        Ok(pool)
+    }
+
+    pub fn description(&self) -> EventDescription {
+        self.description
+    }
+
+    pub fn capacity(&self) -> usize {
+        self.capacity
+    }
+
+    /// Number of instances the pool has created.
+    pub fn len(&self) -> usize {
+        self.free.len() + self.active.len()
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.len() == 0
+    }
+
+    /// Number of instances ready to be acquired without creating or stealing one.
+    pub fn free_count(&self) -> usize {
+        self.free.len()
+    }
+
+    /// Number of instances that have been acquired and not recycled yet.
+    pub fn active_count(&self) -> usize {
+        self.active.len()
+    }
+
+    /// Number of times [`EventInstancePool::acquire`] had to steal an instance that was still in use.
+    ///
+    /// If this keeps growing the capacity is too small for how often the event is played.
+    pub fn steal_count(&self) -> usize {
+        self.steal_count
+    }
+
+    /// Hands out an instance that is ready to be started.
+    ///
+    /// Stopped instances are recycled first. If none are free a new instance is created,
+    /// or if the pool is at capacity the oldest acquired instance is stopped immediately and reused.
+    pub fn acquire(&mut self) -> Result<EventInstance> {
+        self.reclaim()?;
+
+        let instance = if let Some(instance) = self.free.pop() {
+            instance
+        } else if self.len() < self.capacity {
+            self.create_pooled()?
+        } else {
+            // capacity is at least 1 and nothing is free, so something is active
+            let instance = self.active.pop_front().unwrap();
+            // on failure it stays the oldest active instance, so it is still released with the pool
+            if let Err(error) = instance
+                .stop(StopMode::Immediate)
+                .and_then(|()| self.reset(instance))
+            {
+                self.active.push_front(instance);
+                return Err(error);
+            }
+            self.steal_count += 1;
+            instance
+        };
+
+        self.active.push_back(instance);
+        Ok(instance)
+    }
+
+    /// Gives an acquired instance back to the pool without waiting for it to stop, stopping it immediately.
+    ///
+    /// Instances that were not acquired from this pool are ignored.
+    pub fn release(&mut self, instance: EventInstance) -> Result<()> {
+        let Some(index) = self.active.iter().position(|i| *i == instance) else {
+            return Ok(());
+        };
+        instance
+            .stop(StopMode::Immediate)
+            .and_then(|()| self.reset(instance))?;
+        self.active.remove(index);
+        self.free.push(instance);
+        Ok(())
+    }
+
+    /// Recycles every acquired instance that has stopped since the last call, returning how many were recycled.
+    ///
+    /// This is called by [`EventInstancePool::acquire`], so it only needs calling to reset instances ahead of time.
+    pub fn reclaim(&mut self) -> Result<usize> {
+        {
+            let mut stopped = self.stopped.lock().unwrap_or_else(PoisonError::into_inner);
+            if stopped.is_empty() {
+                return Ok(0);
+            }
+            std::mem::swap(&mut *stopped, &mut self.reclaimed);
+        }
+
+        let mut count = 0;
+        let mut result = Ok(());
+        while let Some(instance) = self.reclaimed.pop() {
+            let Some(index) = self.active.iter().position(|i| *i == instance) else {
+                continue;
+            };
+            // a stolen instance fires its stopped callback after it has been started again
+            match instance.get_playback_state() {
+                Ok(PlaybackState::Stopped) => {}
+                Ok(_) => continue,
+                Err(e) => {
+                    result = Err(e);
+                    continue;
+                }
+            }
+            self.active.remove(index);
+            if let Err(e) = self.reset(instance) {
+                result = Err(e);
+            }
+            self.free.push(instance);
+            count += 1;
+        }
+        result.map(|()| count)
+    }
+
+    /// Stops every acquired instance. They are recycled once they have stopped.
+    pub fn stop_all(&self, mode: StopMode) -> Result<()> {
+        self.active.iter().try_for_each(|i| i.stop(mode))
+    }
+
+    fn create_pooled(&self) -> Result<EventInstance> {
+        let instance = self.description.create_instance()?;
+        let stopped: *mut c_void = Arc::into_raw(self.stopped.clone()).cast_mut().cast();
+        let mask = EventCallbackMask::STOPPED | EventCallbackMask::DESTROYED;
+        let result = instance.set_raw_userdata(stopped).and_then(|()| unsafe {
+            FMOD_Studio_EventInstance_SetCallback(
+                instance.inner,
+                Some(pooled_callback),
+                mask.into(),
+            )
+            .to_result()
+        });
+        if let Err(e) = result {
+            // the destroyed callback won't fire, so drop the reference here
+            unsafe { drop(Arc::from_raw(stopped.cast_const().cast::<StoppedList>())) };
+            let _ = instance.set_raw_userdata(std::ptr::null_mut());
+            let _ = instance.release();
+            return Err(e);
+        }
+        Ok(instance)
+    }
+
+    fn reset(&mut self, instance: EventInstance) -> Result<()> {
+        instance.set_paused(false)?;
+        for (ids, values) in self
+            .default_ids
+            .chunks(MAX_PARAMETERS_PER_CALL)
+            .zip(self.default_values.chunks_mut(MAX_PARAMETERS_PER_CALL))
+        {
+            instance.set_parameters_by_ids(ids, values, true)?;
+        }
+        Ok(())
+    }
+}
+
+impl Drop for EventInstancePool {
+    fn drop(&mut self) {
+        for instance in self.free.drain(..).chain(self.active.drain(..)) {
+            let _ = instance.release();
+        }
+    }
+}
+
+unsafe extern "C" fn pooled_callback(
+    kind: FMOD_STUDIO_EVENT_CALLBACK_TYPE,
+    event: *mut FMOD_STUDIO_EVENTINSTANCE,
+    _parameters: *mut c_void,
+) -> FMOD_RESULT {
+    let event = EventInstance::from(event);
+    let Ok(pointer) = event.get_raw_userdata() else {
+        return FMOD_RESULT::FMOD_OK;
+    };
+    if pointer.is_null() {
+        return FMOD_RESULT::FMOD_OK;
+    }
+    let pointer = pointer.cast::<StoppedList>().cast_const();
+
+    match kind {
+        FMOD_STUDIO_EVENT_CALLBACK_STOPPED => {
+            let stopped = unsafe { &*pointer };
+            stopped
+                .lock()
+                .unwrap_or_else(PoisonError::into_inner)
+                .push(event);
+        }
+        FMOD_STUDIO_EVENT_CALLBACK_DESTROYED => {
+            let _ = event.set_raw_userdata(std::ptr::null_mut());
+            unsafe { drop(Arc::from_raw(pointer)) };
+        }
+        _ => {}
+    }
+    FMOD_RESULT::FMOD_OK
+}
@@ -10,9 +10,11 @@ mod attributes;
 mod callback;
 mod general;
 mod instance;
+mod instance_pool;
 mod parameter;
 mod sample_data;
 mod user_property;
+pub use instance_pool::EventInstancePool;
 
 #[derive(Debug, PartialEq, Eq, Clone, Copy, Hash)]
 #[repr(transparent)] // so we can transmute between types
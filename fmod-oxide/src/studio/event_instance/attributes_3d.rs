@@ -19,6 +19,8 @@ impl EventInstance {
     ///
     /// An event's 3D attributes specify its position, velocity and orientation.
     /// The 3D attributes are used to calculate 3D panning, doppler and the values of automatic distance and angle parameters.
+    ///
+    /// To move many instances every frame, see [`crate::SpatialBatch`].
     pub fn set_3d_attributes(&self, attributes: Attributes3D) -> Result<()> {
         let mut attributes = attributes.into();
         unsafe {
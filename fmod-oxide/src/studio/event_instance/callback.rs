@@ -17,7 +17,7 @@ use crate::{
 };
 
 #[cfg(feature = "userdata-abstraction")]
-use crate::userdata::{get_userdata, insert_userdata, set_userdata, Userdata};
+use crate::userdata::{get_userdata, insert_userdata, set_userdata, with_userdata, Userdata};
 
 #[allow(unused_variables)]
 pub trait EventInstanceCallback {
@@ -122,7 +122,17 @@ pub(crate) unsafe extern "C" fn event_callback_impl<C: EventInstanceCallback>(
     let event = EventInstance::from(event);
     let result = match kind {
         FMOD_STUDIO_EVENT_CALLBACK_CREATED => C::created(event),
-        FMOD_STUDIO_EVENT_CALLBACK_DESTROYED => C::destroyed(event),
+        FMOD_STUDIO_EVENT_CALLBACK_DESTROYED => {
+            let result = C::destroyed(event);
+            // the event instance is invalid after this callback, so there's no need to wait for a sweep to drop its userdata
+            #[cfg(feature = "userdata-abstraction")]
+            if let Ok(pointer) = event.get_raw_userdata() {
+                if !pointer.is_null() {
+                    crate::userdata::release_userdata(pointer.into(), event);
+                }
+            }
+            result
+        }
         FMOD_STUDIO_EVENT_CALLBACK_STARTING => C::starting(event),
         FMOD_STUDIO_EVENT_CALLBACK_STARTED => C::started(event),
         FMOD_STUDIO_EVENT_CALLBACK_RESTARTED => C::restarted(event),
@@ -222,6 +232,14 @@ impl EventInstance {
         let pointer = self.get_raw_userdata()?;
         Ok(get_userdata(pointer.into()))
     }
+
+    /// Runs `f` with a borrow of the userdata, without cloning the [`std::sync::Arc`].
+    ///
+    /// This never blocks, even while another thread is setting or removing userdata.
+    pub fn with_userdata<R>(&self, f: impl FnOnce(&Userdata) -> R) -> Result<Option<R>> {
+        let pointer = self.get_raw_userdata()?;
+        Ok(with_userdata(pointer.into(), f))
+    }
 }
 
 impl EventInstance {
@@ -19,6 +19,8 @@ impl EventInstance {
     /// If the specified parameter is read only, is an automatic parameter or is not of type [`ParameterKind::GameControlled`] then [`FMOD_RESULT::FMOD_ERR_INVALID_PARAM`] is returned.
     ///
     /// If the event has no parameter matching name then [`FMOD_RESULT::FMOD_ERR_EVENT_NOTFOUND`] is returned.
+    ///
+    /// FMOD looks the name up on every call. For parameters set every frame, resolve a [`crate::studio::ParameterHandle`] once and use [`EventInstance::set_parameter`].
     pub fn set_parameter_by_name(
         &self,
         name: &Utf8CStr,
@@ -31,5 +31,11 @@ pub use event_description::*;
 mod event_instance;
 pub use event_instance::*;
 
+mod parameter_handle;
+pub use parameter_handle::*;
+
+mod path_cache;
+pub use path_cache::*;
+
 mod vca;
 pub use vca::*;
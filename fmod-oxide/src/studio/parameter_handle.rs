@@ -0,0 +1,257 @@
+// Copyright (c) 2024 Lily Lyons
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+use fmod_sys::*;
+use lanyard::Utf8CStr;
+use std::{
+    collections::HashMap,
+    ffi::{c_float, c_int},
+};
+
+use crate::studio::{
+    EventDescription, EventInstance, ParameterDescription, ParameterFlags, ParameterID,
+    ParameterKind,
+};
+
+/// A parameter of an [`EventDescription`], resolved once so it can be set without a name lookup.
+///
+/// Handles are plain data, and stay valid for as long as the bank containing the event is loaded.
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub struct ParameterHandle {
+    pub id: ParameterID,
+    pub minimum: c_float,
+    pub maximum: c_float,
+    pub default_value: c_float,
+    pub kind: ParameterKind,
+    pub flags: ParameterFlags,
+}
+
+impl From<&ParameterDescription> for ParameterHandle {
+    fn from(value: &ParameterDescription) -> Self {
+        Self {
+            id: value.id,
+            minimum: value.minimum,
+            maximum: value.maximum,
+            default_value: value.default_value,
+            kind: value.kind,
+            flags: value.flags,
+        }
+    }
+}
+
+impl ParameterHandle {
+    /// Whether this parameter can be set on an [`EventInstance`].
+    ///
+    /// Read only, automatic and global parameters can't be.
+    pub fn is_settable(&self) -> bool {
+        !self.flags.intersects(
+            ParameterFlags::READONLY | ParameterFlags::AUTOMATIC | ParameterFlags::GLOBAL,
+        )
+    }
+
+    /// Clamps `value` to the range of this parameter, the same way FMOD does when it is set.
+    pub fn clamp(&self, value: c_float) -> c_float {
+        value.clamp(self.minimum, self.maximum)
+    }
+}
+
+impl EventDescription {
+    /// Resolves a parameter by name into a [`ParameterHandle`].
+    ///
+    /// To resolve many names of the same event, build a [`ParameterTable`] once instead.
+    pub fn get_parameter_handle(&self, name: &Utf8CStr) -> Result<ParameterHandle> {
+        self.get_parameter_description_by_name(name)
+            .map(|description| ParameterHandle::from(&description))
+    }
+
+    /// Resolves every parameter of this event into a [`ParameterTable`].
+    pub fn parameter_table(&self) -> Result<ParameterTable> {
+        ParameterTable::new(*self)
+    }
+}
+
+/// Every parameter of an [`EventDescription`], resolved into [`ParameterHandle`]s.
+///
+/// Build this once per event (when its bank is loaded) and look up handles from it, rather than setting parameters by name.
+#[derive(Debug, Clone)]
+pub struct ParameterTable {
+    description: EventDescription,
+    names: HashMap<Box<str>, usize>,
+    handles: Vec<ParameterHandle>,
+}
+
+impl ParameterTable {
+    pub fn new(description: EventDescription) -> Result<Self> {
+        let count = description.parameter_description_count()?;
+        let mut names = HashMap::with_capacity(count as usize);
+        let mut handles = Vec::with_capacity(count as usize);
+        for index in 0..count {
+            let parameter = description.get_parameter_description_by_index(index)?;
+            names.insert(parameter.name.as_str().into(), handles.len());
+            handles.push(ParameterHandle::from(&parameter));
+        }
+        Ok(Self {
+            description,
+            names,
+            handles,
+        })
+    }
+
+    pub fn description(&self) -> EventDescription {
+        self.description
+    }
+
+    /// Looks up a parameter by name. This does not call into FMOD.
+    pub fn get(&self, name: &str) -> Option<ParameterHandle> {
+        self.names.get(name).map(|index| self.handles[*index])
+    }
+
+    /// Looks up a parameter by its index in the [`EventDescription`].
+    pub fn get_by_index(&self, index: c_int) -> Option<ParameterHandle> {
+        usize::try_from(index)
+            .ok()
+            .and_then(|index| self.handles.get(index))
+            .copied()
+    }
+
+    /// Every parameter, in the order of their index in the [`EventDescription`].
+    pub fn handles(&self) -> &[ParameterHandle] {
+        &self.handles
+    }
+
+    /// Resolves every name in `names`, failing with [`FMOD_RESULT::FMOD_ERR_EVENT_NOTFOUND`] if any of them don't exist.
+    pub fn resolve<const N: usize>(&self, names: [&str; N]) -> Result<[ParameterHandle; N]> {
+        let mut handles = [None; N];
+        for (handle, name) in handles.iter_mut().zip(names) {
+            *handle = Some(self.get(name).ok_or(FMOD_RESULT::FMOD_ERR_EVENT_NOTFOUND)?);
+        }
+        Ok(handles.map(Option::unwrap))
+    }
+}
+
+/// A batch of parameter values, set on an [`EventInstance`] with one [`EventInstance::set_parameters_by_ids`] call.
+///
+/// The block stores up to [`ParameterBlock::CAPACITY`] values inline, so building and applying it never allocates.
+/// It can be applied to any number of instances, and kept around and refilled every frame.
+#[derive(Debug, Clone)]
+pub struct ParameterBlock {
+    ids: [ParameterID; ParameterBlock::CAPACITY],
+    values: [c_float; ParameterBlock::CAPACITY],
+    len: usize,
+}
+
+impl Default for ParameterBlock {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+impl ParameterBlock {
+    /// The most parameters FMOD accepts in one [`EventInstance::set_parameters_by_ids`] call.
+    pub const CAPACITY: usize = 32;
+
+    pub const fn new() -> Self {
+        Self {
+            ids: [ParameterID {
+                data_1: 0,
+                data_2: 0,
+            }; Self::CAPACITY],
+            values: [0.0; Self::CAPACITY],
+            len: 0,
+        }
+    }
+
+    pub fn len(&self) -> usize {
+        self.len
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.len == 0
+    }
+
+    pub fn clear(&mut self) {
+        self.len = 0;
+    }
+
+    /// Sets the value of `handle` in this block, replacing its value if it is already in the block.
+    ///
+    /// Fails with [`FMOD_RESULT::FMOD_ERR_INVALID_PARAM`] if the block already holds [`ParameterBlock::CAPACITY`] other parameters.
+    pub fn set(&mut self, handle: ParameterHandle, value: c_float) -> Result<()> {
+        if let Some(index) = self.ids[..self.len].iter().position(|id| *id == handle.id) {
+            self.values[index] = value;
+            return Ok(());
+        }
+        if self.len == Self::CAPACITY {
+            return Err(Error::Fmod(FMOD_RESULT::FMOD_ERR_INVALID_PARAM));
+        }
+        self.ids[self.len] = handle.id;
+        self.values[self.len] = value;
+        self.len += 1;
+        Ok(())
+    }
+
+    /// Sets every parameter in this block on `instance`.
+    pub fn apply(&mut self, instance: EventInstance, ignore_seek_speed: bool) -> Result<()> {
+        if self.len == 0 {
+            return Ok(());
+        }
+        instance.set_parameters_by_ids(
+            &self.ids[..self.len],
+            &mut self.values[..self.len],
+            ignore_seek_speed,
+        )
+    }
+
+    /// Sets every parameter in this block on every instance in `instances`.
+    ///
+    /// Every instance is set even if some fail, and the first error is returned.
+    pub fn apply_to_all(
+        &mut self,
+        instances: &[EventInstance],
+        ignore_seek_speed: bool,
+    ) -> Result<()> {
+        let mut result = Ok(());
+        for instance in instances {
+            if let Err(e) = self.apply(*instance, ignore_seek_speed) {
+                result = result.and(Err(e));
+            }
+        }
+        result
+    }
+}
+
+impl EventInstance {
+    /// Sets a parameter value by [`ParameterHandle`].
+    ///
+    /// See [`EventInstance::set_parameter_by_id`].
+    pub fn set_parameter(
+        &self,
+        handle: ParameterHandle,
+        value: c_float,
+        ignore_seek_speed: bool,
+    ) -> Result<()> {
+        self.set_parameter_by_id(handle.id, value, ignore_seek_speed)
+    }
+
+    /// Sets a parameter value by [`ParameterHandle`], looking up the value label.
+    ///
+    /// See [`EventInstance::set_parameter_by_id_with_label`].
+    pub fn set_parameter_with_label(
+        &self,
+        handle: ParameterHandle,
+        label: &Utf8CStr,
+        ignore_seek_speed: bool,
+    ) -> Result<()> {
+        self.set_parameter_by_id_with_label(handle.id, label, ignore_seek_speed)
+    }
+
+    /// Retrieves a parameter value by [`ParameterHandle`].
+    ///
+    /// See [`EventInstance::get_parameter_by_id`].
+    pub fn get_parameter(&self, handle: ParameterHandle) -> Result<(c_float, c_float)> {
+        self.get_parameter_by_id(handle.id)
+    }
+}
@@ -0,0 +1,223 @@
+// Copyright (c) 2024 Lily Lyons
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+use fmod_sys::*;
+use std::collections::HashMap;
+
+use crate::studio::{Bank, Bus, EventDescription, Vca};
+use crate::Guid;
+
+/// An interned Studio path or GUID in a [`StudioPathCache`].
+///
+/// Ids are never reused, so an id stays valid even after the bank containing its object has been removed from the cache.
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Hash, PartialOrd, Ord)]
+pub struct PathId(u32);
+
+impl PathId {
+    pub fn index(self) -> usize {
+        self.0 as usize
+    }
+}
+
+/// A handle resolved by a [`StudioPathCache`].
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Hash)]
+pub enum CachedObject {
+    Event(EventDescription),
+    Bus(Bus),
+    Vca(Vca),
+}
+
+#[derive(Debug)]
+struct CacheEntry {
+    guid: Guid,
+    path: Option<Box<str>>,
+    object: Option<CachedObject>,
+    // buses and VCAs can be in several banks, the handle stays valid until the last of them is removed
+    owners: u32,
+}
+
+/// An opt-in cache of Studio paths and GUIDs to their handles.
+///
+/// Paths and GUIDs are interned into [`PathId`]s once, when their bank is added.
+/// After that, looking up a handle by [`PathId`] is an index into a `Vec`, with no string hashing and no FFI calls,
+/// which is cheaper than [`super::System::get_event`] for hot gameplay code.
+///
+/// Paths come from the string table of the strings bank, or from each object if the strings bank is loaded.
+/// Handles come from the events, buses and VCAs of each bank added with [`StudioPathCache::add_bank`].
+/// Banks must be removed with [`StudioPathCache::remove_bank`] (or unloaded through [`StudioPathCache::unload_bank`]),
+/// after which their handles are no longer returned.
+#[derive(Debug, Default)]
+pub struct StudioPathCache {
+    entries: Vec<CacheEntry>,
+    by_guid: HashMap<Guid, PathId>,
+    by_path: HashMap<Box<str>, PathId>,
+    banks: HashMap<Bank, Vec<PathId>>,
+    // reused for every string fmod returns
+    buffer: String,
+}
+
+impl StudioPathCache {
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    /// Interns every path in `bank`'s string table, and caches the handle of every event, bus and VCA in `bank`.
+    ///
+    /// Adding a bank that was already added refreshes its handles.
+    /// If this fails partway, the handles cached so far still belong to `bank` and are dropped by [`StudioPathCache::remove_bank`].
+    pub fn add_bank(&mut self, bank: Bank) -> Result<()> {
+        self.remove_bank(bank);
+
+        // only the strings bank has a string table, for every other bank this is 0
+        for index in 0..bank.string_count()? {
+            let guid = bank.get_string_info_into(index, &mut self.buffer)?;
+            let id = self.intern_guid(guid);
+            self.set_path(id);
+        }
+
+        for event in bank.get_event_list()? {
+            let id = self.intern_guid(event.get_id()?);
+            // paths are only available with the strings bank loaded, but it's fine to only know the guid
+            if event.get_path_into(&mut self.buffer).is_ok() {
+                self.set_path(id);
+            }
+            self.cache_object(bank, id, CachedObject::Event(event));
+        }
+        for bus in bank.get_bus_list()? {
+            let id = self.intern_guid(bus.get_id()?);
+            if bus.get_path_into(&mut self.buffer).is_ok() {
+                self.set_path(id);
+            }
+            self.cache_object(bank, id, CachedObject::Bus(bus));
+        }
+        for vca in bank.get_vca_list()? {
+            let id = self.intern_guid(vca.get_id()?);
+            if vca.get_path_into(&mut self.buffer).is_ok() {
+                self.set_path(id);
+            }
+            self.cache_object(bank, id, CachedObject::Vca(vca));
+        }
+        Ok(())
+    }
+
+    // the bank owns the handle as soon as it's cached, so an error later on in add_bank can't leak it
+    fn cache_object(&mut self, bank: Bank, id: PathId, object: CachedObject) {
+        let entry = &mut self.entries[id.index()];
+        entry.object = Some(object);
+        entry.owners += 1;
+        self.banks.entry(bank).or_default().push(id);
+    }
+
+    /// Stops returning handles from `bank`. Interned ids, paths and GUIDs are kept.
+    ///
+    /// Buses and VCAs that are also in another bank in the cache keep their handles.
+    pub fn remove_bank(&mut self, bank: Bank) {
+        let Some(ids) = self.banks.remove(&bank) else {
+            return;
+        };
+        for id in ids {
+            let entry = &mut self.entries[id.index()];
+            entry.owners -= 1;
+            if entry.owners == 0 {
+                entry.object = None;
+            }
+        }
+    }
+
+    /// Removes `bank` from the cache and then unloads it.
+    pub fn unload_bank(&mut self, bank: Bank) -> Result<()> {
+        self.remove_bank(bank);
+        bank.unload()
+    }
+
+    fn intern_guid(&mut self, guid: Guid) -> PathId {
+        *self.by_guid.entry(guid).or_insert_with(|| {
+            let id = PathId(u32::try_from(self.entries.len()).expect("too many cached paths"));
+            self.entries.push(CacheEntry {
+                guid,
+                path: None,
+                object: None,
+                owners: 0,
+            });
+            id
+        })
+    }
+
+    // sets the path of `id` to the contents of the buffer
+    fn set_path(&mut self, id: PathId) {
+        let entry = &mut self.entries[id.index()];
+        if entry.path.as_deref() == Some(self.buffer.as_str()) {
+            return;
+        }
+        // the path changed, e.g. after a bank was rebuilt with a renamed event
+        if let Some(old) = entry.path.take() {
+            self.by_path.remove(&old);
+        }
+        let path: Box<str> = self.buffer.as_str().into();
+        entry.path = Some(path.clone());
+        self.by_path.insert(path, id);
+    }
+
+    /// Looks up the id of a path, such as `event:/Music/Level 01`.
+    ///
+    /// This hashes `path`, so it is best done once at load time, keeping the id for later.
+    pub fn id(&self, path: &str) -> Option<PathId> {
+        self.by_path.get(path).copied()
+    }
+
+    /// Looks up the id of a GUID.
+    pub fn id_by_guid(&self, guid: Guid) -> Option<PathId> {
+        self.by_guid.get(&guid).copied()
+    }
+
+    /// The path of `id`, if it is known.
+    pub fn path(&self, id: PathId) -> Option<&str> {
+        self.entries.get(id.index())?.path.as_deref()
+    }
+
+    pub fn guid(&self, id: PathId) -> Option<Guid> {
+        self.entries.get(id.index()).map(|entry| entry.guid)
+    }
+
+    /// The cached handle of `id`, if its bank is in the cache.
+    pub fn get(&self, id: PathId) -> Option<CachedObject> {
+        self.entries.get(id.index())?.object
+    }
+
+    pub fn event(&self, id: PathId) -> Option<EventDescription> {
+        match self.get(id)? {
+            CachedObject::Event(event) => Some(event),
+            _ => None,
+        }
+    }
+
+    pub fn bus(&self, id: PathId) -> Option<Bus> {
+        match self.get(id)? {
+            CachedObject::Bus(bus) => Some(bus),
+            _ => None,
+        }
+    }
+
+    pub fn vca(&self, id: PathId) -> Option<Vca> {
+        match self.get(id)? {
+            CachedObject::Vca(vca) => Some(vca),
+            _ => None,
+        }
+    }
+
+    pub fn event_by_guid(&self, guid: Guid) -> Option<EventDescription> {
+        self.event(self.id_by_guid(guid)?)
+    }
+
+    /// The number of interned ids.
+    pub fn len(&self) -> usize {
+        self.entries.len()
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.entries.is_empty()
+    }
+}
@@ -6,15 +6,140 @@
 
 use fmod_sys::*;
 use lanyard::Utf8CStr;
-use std::ffi::c_int;
+use std::ffi::{c_char, c_int, c_uint, c_void};
 
-use crate::studio::{Bank, LoadBankFlags, System};
+use crate::studio::{mapped, Bank, LoadBankFlags, System};
 use crate::Guid;
 
+/// File callbacks used to stream a bank's data with [`System::load_bank_custom`].
+///
+/// FMOD calls these from whichever thread is loading the bank, which is usually the Studio asynchronous loading thread.
+/// `read` is given FMOD's own buffer, so data can be copied into it straight from an archive or memory map without an intermediate copy.
+///
+/// Unlike the file callbacks of the core system, bank loading only supports synchronous reads.
+#[allow(unused_variables)]
+pub trait BankFileSystem {
+    /// Identifies the bank to open, such as an offset and length into an archive.
+    ///
+    /// FMOD keeps a copy of this for as long as the bank is loaded, without ever dropping it, which is why it must be [`Copy`].
+    type Info: Copy + Send + Sync + 'static;
+    /// An open bank file.
+    type File: Send;
+
+    /// Opens the bank described by `info`, returning the file and its size in bytes.
+    fn open(info: Self::Info) -> Result<(Self::File, c_uint)>;
+
+    /// Closes a file previously returned from [`BankFileSystem::open`].
+    fn close(file: Self::File) -> Result<()> {
+        Ok(())
+    }
+
+    /// Reads into `buffer` from the current position, returning how many bytes were read.
+    ///
+    /// Reading less than `buffer.len()` bytes signals the end of the file.
+    fn read(file: &mut Self::File, buffer: &mut [u8]) -> Result<c_uint>;
+
+    /// Moves the read position to `position` bytes from the start of the file.
+    fn seek(file: &mut Self::File, position: c_uint) -> Result<()>;
+}
+
+unsafe extern "C" fn bank_open_impl<F: BankFileSystem>(
+    _name: *const c_char,
+    filesize: *mut c_uint,
+    handle: *mut *mut c_void,
+    userdata: *mut c_void,
+) -> FMOD_RESULT {
+    // fmod's copy of the info is not guaranteed to be aligned for F::Info
+    let info = unsafe { userdata.cast::<F::Info>().read_unaligned() };
+    match F::open(info) {
+        Ok((file, size)) => {
+            unsafe {
+                *filesize = size;
+                *handle = Box::into_raw(Box::new(file)).cast();
+            }
+            FMOD_RESULT::FMOD_OK
+        }
+        Err(e) => e.into(),
+    }
+}
+
+unsafe extern "C" fn bank_close_impl<F: BankFileSystem>(
+    handle: *mut c_void,
+    _userdata: *mut c_void,
+) -> FMOD_RESULT {
+    let file = unsafe { Box::from_raw(handle.cast::<F::File>()) };
+    F::close(*file).into()
+}
+
+unsafe extern "C" fn bank_read_impl<F: BankFileSystem>(
+    handle: *mut c_void,
+    buffer: *mut c_void,
+    size_bytes: c_uint,
+    bytes_read: *mut c_uint,
+    _userdata: *mut c_void,
+) -> FMOD_RESULT {
+    let file = unsafe { &mut *handle.cast::<F::File>() };
+    let buffer =
+        unsafe { std::slice::from_raw_parts_mut(buffer.cast::<u8>(), size_bytes as usize) };
+    match F::read(file, buffer) {
+        Ok(read) => {
+            let read = read.min(size_bytes);
+            unsafe { *bytes_read = read };
+            if read < size_bytes {
+                FMOD_RESULT::FMOD_ERR_FILE_EOF
+            } else {
+                FMOD_RESULT::FMOD_OK
+            }
+        }
+        Err(e) => e.into(),
+    }
+}
+
+unsafe extern "C" fn bank_seek_impl<F: BankFileSystem>(
+    handle: *mut c_void,
+    position: c_uint,
+    _userdata: *mut c_void,
+) -> FMOD_RESULT {
+    let file = unsafe { &mut *handle.cast::<F::File>() };
+    F::seek(file, position).into()
+}
+
 impl System {
-    // TODO: load bank with callbacks
-    pub fn load_bank_custom(&self) -> Result<Bank> {
-        todo!()
+    /// Sample data must be loaded separately.
+    ///
+    /// Loads a bank using the file callbacks of `F`, which lets banks be read out of archives or memory maps without copying them into memory first.
+    /// FMOD copies `info` and passes it to [`BankFileSystem::open`] whenever it needs to open the bank, which can happen again after this function returns.
+    ///
+    /// By default this function will block until the file load finishes.
+    ///
+    /// Using the [`LoadBankFlags::NONBLOCKING`] flag will cause the bank to be loaded asynchronously.
+    /// In that case this function will always return [`Ok`] and bank will contain a valid bank handle.
+    /// Load errors for asynchronous banks can be detected by calling [`Bank::get_loading_state`].
+    /// Failed asynchronous banks should be released by calling [`Bank::unload`].
+    ///
+    /// If a bank has been split, separating out assets and optionally streams from the metadata bank, all parts must be loaded before any APIs that use the data are called.
+    /// It is recommended you load each part one after another (order is not important), then proceed with dependent API calls such as [`Bank::load_sample_data`] or [`System::get_event`].
+    pub fn load_bank_custom<F: BankFileSystem>(
+        &self,
+        info: F::Info,
+        load_flags: LoadBankFlags,
+    ) -> Result<Bank> {
+        let bank_info = FMOD_STUDIO_BANK_INFO {
+            size: std::mem::size_of::<FMOD_STUDIO_BANK_INFO>() as c_int,
+            // fmod copies this before returning. zero sized infos are not copied, but reading those back never touches memory
+            userdata: std::ptr::addr_of!(info).cast_mut().cast(),
+            userdatalength: std::mem::size_of::<F::Info>() as c_int,
+            opencallback: Some(bank_open_impl::<F>),
+            closecallback: Some(bank_close_impl::<F>),
+            readcallback: Some(bank_read_impl::<F>),
+            seekcallback: Some(bank_seek_impl::<F>),
+        };
+        let mut bank = std::ptr::null_mut();
+        unsafe {
+            FMOD_Studio_System_LoadBankCustom(self.inner, &bank_info, load_flags.bits(), &mut bank)
+                .to_result()?;
+            Ok(Bank::from(bank))
+        }
     }
 
     /// Sample data must be loaded separately.
@@ -116,9 +241,43 @@ impl System {
         }
     }
 
+    /// Sample data must be loaded separately.
+    ///
+    /// Memory maps the bank file at `path` and loads the bank directly from the mapping, like [`System::load_bank_pointer`].
+    /// This avoids both reading the file into memory and FMOD's own copy of the data,
+    /// and processes loading the same bank share it through the OS page cache.
+    /// On platforms without memory mapping support the file is read into an aligned buffer instead.
+    ///
+    /// The mapping is kept alive until the bank has fully unloaded after [`Bank::unload`] or [`System::unload_all_banks`],
+    /// which is detected in [`System::update`] or the bank unload system callback.
+    ///
+    /// The file must not be modified while the bank is loaded.
+    ///
+    /// By default this function will block until the load finishes.
+    ///
+    /// Using the [`LoadBankFlags::NONBLOCKING`] flag will cause the bank to be loaded asynchronously.
+    /// In that case this function will always return [`Ok`] and bank will contain a valid bank handle.
+    /// Load errors for asynchronous banks can be detected by calling [`Bank::get_loading_state`].
+    /// Failed asynchronous banks should be released by calling [`Bank::unload`].
+    ///
+    /// This function is not compatible with [`AdvancedSettings::encryption_key`], using them together will cause an error to be returned.
+    pub fn load_bank_mmap(
+        &self,
+        path: impl AsRef<std::path::Path>,
+        flags: LoadBankFlags,
+    ) -> Result<Bank> {
+        let mapping = mapped::BankMapping::new(path.as_ref())?;
+        // the mapping is aligned, and is only dropped once fmod is done with the bank
+        let bank = unsafe { self.load_bank_pointer(mapping.as_ptr(), flags)? };
+        mapped::register_mapping(*self, bank, mapping);
+        Ok(bank)
+    }
+
     /// Unloads all currently loaded banks.
     pub fn unload_all_banks(&self) -> Result<()> {
-        unsafe { FMOD_Studio_System_UnloadAll(self.inner).to_result() }
+        unsafe { FMOD_Studio_System_UnloadAll(self.inner).to_result()? };
+        mapped::mark_system_unloading(*self);
+        Ok(())
     }
 
     /// Retrieves a loaded bank
@@ -10,7 +10,7 @@ use std::ffi::c_void;
 use crate::studio::{Bank, System, SystemCallbackMask};
 
 #[cfg(feature = "userdata-abstraction")]
-use crate::userdata::{get_userdata, insert_userdata, set_userdata, Userdata};
+use crate::userdata::{get_userdata, insert_userdata, set_userdata, with_userdata, Userdata};
 
 #[cfg(feature = "userdata-abstraction")]
 #[allow(unused_variables)]
@@ -77,7 +77,10 @@ unsafe extern "C" fn callback_impl<C: SystemCallback>(
         FMOD_STUDIO_SYSTEM_CALLBACK_POSTUPDATE => C::postupdate(system, userdata),
         FMOD_STUDIO_SYSTEM_CALLBACK_BANK_UNLOAD => {
             let bank = Bank::from(command_data.cast());
-            C::bank_unload(system, bank, userdata)
+            let result = C::bank_unload(system, bank, userdata);
+            // fmod is done with the bank, so a mapping from load_bank_mmap can be dropped right away
+            crate::studio::mapped::release_mapping(bank);
+            result
         }
         FMOD_STUDIO_SYSTEM_CALLBACK_LIVEUPDATE_CONNECTED => {
             C::liveupdate_connected(system, userdata)
@@ -111,6 +114,14 @@ impl System {
         let pointer = self.get_raw_userdata()?;
         Ok(get_userdata(pointer.into()))
     }
+
+    /// Runs `f` with a borrow of the userdata, without cloning the [`std::sync::Arc`].
+    ///
+    /// This never blocks, even while another thread is setting or removing userdata.
+    pub fn with_userdata<R>(&self, f: impl FnOnce(&Userdata) -> R) -> Result<Option<R>> {
+        let pointer = self.get_raw_userdata()?;
+        Ok(with_userdata(pointer.into(), f))
+    }
 }
 
 impl System {
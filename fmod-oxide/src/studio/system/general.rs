@@ -9,7 +9,7 @@ use lanyard::{Utf8CStr, Utf8CString};
 use std::mem::MaybeUninit;
 
 use crate::studio::System;
-use crate::Guid;
+use crate::{get_string_retrieved_into, Guid};
 
 impl System {
     /// Retrieves the Core System.
@@ -87,6 +87,14 @@ impl System {
         }
     }
 
+    /// Like [`System::lookup_path`], but writes the path into `path`, reusing its allocation.
+    pub fn lookup_path_into(&self, id: Guid, path: &mut String) -> Result<()> {
+        let id: FMOD_GUID = id.into();
+        get_string_retrieved_into(path, |buffer, len, retrieved| unsafe {
+            FMOD_Studio_System_LookupPath(self.inner, &id, buffer, len, retrieved)
+        })
+    }
+
     /// Checks that the [`System`] reference is valid and has been initialized.
     pub fn is_valid(&self) -> bool {
         unsafe { FMOD_Studio_System_IsValid(self.inner).into() }
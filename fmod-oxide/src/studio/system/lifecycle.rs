@@ -40,6 +40,8 @@ impl System {
     pub unsafe fn release(self) -> Result<()> {
         unsafe { FMOD_Studio_System_Release(self.inner).to_result()? };
 
+        crate::studio::mapped::release_system_mappings(self);
+
         #[cfg(feature = "userdata-abstraction")]
         crate::userdata::clear_userdata();
 
@@ -55,13 +57,20 @@ impl System {
     ///
     /// When Studio is initialized with [`InitFlags::SYNCHRONOUS_UPDATE`] queued commands will be processed immediately when calling this function, the scheduling and update logic for the Studio system are executed and all callbacks are fired.
     /// This may block the calling thread for a substantial amount of time.
+    ///
+    /// This function also wakes every [`crate::LoadFuture`] whose load has completed.
     #[cfg_attr(
         feature = "userdata-abstraction",
-        doc = "\n#### Note: This function will drop any associated userdata who's owner is no longer valid."
+        doc = "\n#### Note: This function will drop any associated userdata who's owner is no longer valid.\n\n\
+        How many owners are checked per call can be limited with [`crate::set_userdata_cleanup_budget`]."
     )]
     pub fn update(&self) -> Result<()> {
         unsafe { FMOD_Studio_System_Update(self.inner) }.to_result()?;
 
+        crate::studio::mapped::reclaim_mappings(*self);
+
+        crate::loading::poll_pending_loads();
+
         #[cfg(feature = "userdata-abstraction")]
         crate::userdata::cleanup_userdata();
 
@@ -18,6 +18,7 @@ mod parameter;
 mod plugins;
 mod profiling; // things too small to really make their own module
 
+pub use bank::BankFileSystem;
 pub use builder::SystemBuilder;
 pub use callback::SystemCallback;
 
@@ -9,7 +9,7 @@ use std::{ffi::c_float, mem::MaybeUninit};
 use fmod_sys::*;
 use lanyard::Utf8CString;
 
-use crate::Guid;
+use crate::{get_string_retrieved_into, Guid};
 
 /// Represents a global mixer VCA.
 #[derive(Debug, Clone, Copy, PartialEq, Eq, Hash)]
@@ -113,6 +113,15 @@ impl Vca {
         }
     }
 
+    /// Like [`Vca::get_path`], but writes the path into `path`, reusing its allocation.
+    ///
+    /// Once `path` has grown large enough this does not allocate, which makes enumerating paths cheap.
+    pub fn get_path_into(&self, path: &mut String) -> Result<()> {
+        get_string_retrieved_into(path, |buffer, len, retrieved| unsafe {
+            FMOD_Studio_VCA_GetPath(self.inner, buffer, len, retrieved)
+        })
+    }
+
     /// Checks that the VCA reference is valid.
     pub fn is_valid(&self) -> bool {
         unsafe { FMOD_Studio_VCA_IsValid(self.inner).into() }
@@ -9,34 +9,79 @@ compile_error!("fmod-oxide's userdata system is currently only supported on 64-b
 
 use std::{
     any::Any,
-    sync::{Arc, RwLock},
+    sync::{
+        atomic::{AtomicPtr, AtomicUsize, Ordering},
+        Arc, Mutex,
+    },
 };
 
 use once_cell::sync::Lazy;
-use slotmap::{HopSlotMap, Key, KeyData};
 
 use crate::{
     studio::{Bank, CommandReplay, EventDescription, EventInstance, System as StudioSystem},
     ChannelControl, Dsp, DspConnection, Geometry, Reverb3D, Sound, SoundGroup, System,
 };
 
-#[derive(Default)]
+// Userdata is looked up from inside FMOD callbacks, which run on the mixer and async threads.
+// Those lookups must never wait on the game thread inserting or removing userdata, so the storage is split in two:
+//
+// - A table of slots that is only ever appended to. Readers find a slot without any locking,
+//   and mark themselves as borrowing it with a per-slot reader count.
+// - Bookkeeping (generations, free slots, values waiting to be dropped) behind a mutex that only writers take.
+//
+// A writer that replaces or removes a value swaps it out of the slot and then checks the reader count.
+// If nobody is borrowing the slot the old value is dropped immediately,
+// otherwise it is retired and dropped by a later writer once the readers are gone.
+// Slots are only reused once they have no readers, so a reader can never observe a value from a different key.
 struct UserdataStorage {
-    // we use hopslotmap as we expect to iterate over all userdata often
-    // denseslotmap might be better? it has vec iter times
-    slotmap: HopSlotMap<UserdataKey, UserdataValue>,
+    // bucket `n` holds `64 << n` slots, so 27 buckets are enough to address every u32 index.
+    // buckets are never moved or freed once allocated.
+    buckets: [AtomicPtr<Slot>; BUCKET_COUNT],
+    writer: Mutex<WriterState>,
+}
+
+const BUCKET_COUNT: usize = 27;
+const FIRST_BUCKET_LEN: usize = 64;
+
+#[derive(Default)]
+struct Slot {
+    readers: AtomicUsize,
+    value: AtomicPtr<UserdataValue>,
+}
+
+#[derive(Default)]
+struct WriterState {
+    // the current generation of every slot that has been handed out
+    generations: Vec<u32>,
+    free: Vec<u32>,
+    retired: Vec<Retired>,
+    // where the next incremental cleanup resumes from
+    cursor: u32,
+    // the entries checked by the last cleanup, kept so cleaning up every update doesn't allocate
+    cleanup_buffer: Vec<(UserdataKey, HasUserdata)>,
 }
 
-slotmap::new_key_type! {
-    pub struct UserdataKey;
+struct Retired {
+    index: u32,
+    value: Box<UserdataValue>,
+    // whether the slot itself was removed, and can be reused once the value is dropped
+    free_slot: bool,
+}
+
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Hash)]
+pub struct UserdataKey {
+    index: u32,
+    // generations start at 1, so a key is never a null pointer
+    generation: u32,
 }
 
 struct UserdataValue {
     userdata: Userdata,
     owner: HasUserdata,
+    generation: u32,
 }
 
-#[derive(PartialEq)]
+#[derive(PartialEq, Clone, Copy)]
 pub(crate) enum HasUserdata {
     StudioSystem(StudioSystem),
     Bank(Bank),
@@ -96,53 +141,335 @@ impl HasUserdata {
 
 pub type Userdata = Arc<dyn Any + Send + Sync + 'static>;
 
-static STORAGE: Lazy<RwLock<UserdataStorage>> = Lazy::new(Default::default);
+static STORAGE: Lazy<UserdataStorage> = Lazy::new(UserdataStorage::new);
+// how many entries `System::update` checks per call, `usize::MAX` checks all of them
+static CLEANUP_BUDGET: AtomicUsize = AtomicUsize::new(usize::MAX);
+
+// returns the bucket and offset into that bucket of a slot index
+fn locate(index: u32) -> (usize, usize) {
+    let index = index as usize;
+    let bucket = (index / FIRST_BUCKET_LEN + 1).ilog2() as usize;
+    let bucket_start = FIRST_BUCKET_LEN * ((1 << bucket) - 1);
+    (bucket, index - bucket_start)
+}
+
+impl UserdataStorage {
+    fn new() -> Self {
+        Self {
+            buckets: std::array::from_fn(|_| AtomicPtr::default()),
+            writer: Mutex::default(),
+        }
+    }
+
+    fn slot(&self, index: u32) -> Option<&Slot> {
+        let (bucket, offset) = locate(index);
+        let slots = self.buckets[bucket].load(Ordering::Acquire);
+        if slots.is_null() {
+            return None;
+        }
+        // buckets are never freed, and offset is always within the bucket
+        Some(unsafe { &*slots.add(offset) })
+    }
+
+    // only called by writers, with the writer lock held
+    fn slot_or_alloc(&self, index: u32) -> &Slot {
+        let (bucket, _) = locate(index);
+        if self.buckets[bucket].load(Ordering::Acquire).is_null() {
+            let slots: Box<[Slot]> = (0..FIRST_BUCKET_LEN << bucket)
+                .map(|_| Slot::default())
+                .collect();
+            let slots = Box::into_raw(slots).cast::<Slot>();
+            self.buckets[bucket].store(slots, Ordering::Release);
+        }
+        self.slot(index).unwrap()
+    }
+}
+
+impl WriterState {
+    fn is_live(&self, key: UserdataKey) -> bool {
+        self.generations.get(key.index as usize) == Some(&key.generation)
+    }
+
+    // swaps the value out of a slot, dropping it now if nobody is reading it and retiring it otherwise
+    fn replace(
+        &mut self,
+        index: u32,
+        new: *mut UserdataValue,
+        garbage: &mut Vec<Box<UserdataValue>>,
+    ) {
+        let slot = STORAGE.slot(index).unwrap();
+        let old = slot.value.swap(new, Ordering::SeqCst);
+        let free_slot = new.is_null();
+        if free_slot {
+            let generation = &mut self.generations[index as usize];
+            *generation = generation.wrapping_add(1).max(1);
+        }
+        if old.is_null() {
+            return;
+        }
+
+        // only writers ever free values, and we hold the writer lock, so this is safe
+        let old = unsafe { Box::from_raw(old) };
+        if slot.readers.load(Ordering::SeqCst) == 0 {
+            garbage.push(old);
+            if free_slot {
+                self.free.push(index);
+            }
+        } else {
+            self.retired.push(Retired {
+                index,
+                value: old,
+                free_slot,
+            });
+        }
+    }
+
+    // collects up to `max_entries` live entries into `live`, starting from the cursor and wrapping around at most once
+    fn collect_live(&mut self, max_entries: usize, live: &mut Vec<(UserdataKey, HasUserdata)>) {
+        let len = self.generations.len() as u32;
+        live.clear();
+        if len == 0 {
+            return;
+        }
+
+        let start = self.cursor % len;
+        let mut index = start;
+        while live.len() < max_entries {
+            let value = STORAGE.slot(index).unwrap().value.load(Ordering::SeqCst);
+            if !value.is_null() {
+                let key = UserdataKey {
+                    index,
+                    generation: self.generations[index as usize],
+                };
+                live.push((key, unsafe { (*value).owner }));
+            }
+            index = (index + 1) % len;
+            if index == start {
+                break;
+            }
+        }
+        self.cursor = index;
+    }
+
+    // removes a value only if it still belongs to `owner`
+    fn remove_owned(
+        &mut self,
+        key: UserdataKey,
+        owner: HasUserdata,
+        garbage: &mut Vec<Box<UserdataValue>>,
+    ) -> bool {
+        if !self.is_live(key) {
+            return false;
+        }
+        let value = STORAGE
+            .slot(key.index)
+            .unwrap()
+            .value
+            .load(Ordering::SeqCst);
+        if value.is_null() || unsafe { (*value).owner } != owner {
+            return false;
+        }
+        self.replace(key.index, std::ptr::null_mut(), garbage);
+        true
+    }
+
+    // drops retired values that are no longer being read
+    fn reclaim(&mut self, garbage: &mut Vec<Box<UserdataValue>>) {
+        let mut i = 0;
+        while i < self.retired.len() {
+            let index = self.retired[i].index;
+            if STORAGE.slot(index).unwrap().readers.load(Ordering::SeqCst) == 0 {
+                let retired = self.retired.swap_remove(i);
+                if retired.free_slot {
+                    self.free.push(index);
+                }
+                garbage.push(retired.value);
+            } else {
+                i += 1;
+            }
+        }
+    }
+}
+
+// runs a writer operation, dropping any userdata it removed after the writer lock is released.
+// userdata drop code may call back into this module, so it must not be dropped with the lock held.
+fn with_writer<R>(f: impl FnOnce(&mut WriterState, &mut Vec<Box<UserdataValue>>) -> R) -> R {
+    let mut garbage = Vec::new();
+    let result = {
+        let mut state = STORAGE.writer.lock().unwrap();
+        state.reclaim(&mut garbage);
+        f(&mut state, &mut garbage)
+    };
+    drop(garbage);
+    result
+}
+
+struct ReadGuard<'a>(&'a Slot);
+
+impl Drop for ReadGuard<'_> {
+    fn drop(&mut self) {
+        self.0.readers.fetch_sub(1, Ordering::SeqCst);
+    }
+}
 
 pub(crate) fn insert_userdata(userdata: Userdata, owner: impl Into<HasUserdata>) -> UserdataKey {
-    let mut storage = STORAGE.write().unwrap();
-    storage.slotmap.insert(UserdataValue {
-        userdata,
-        owner: owner.into(),
+    let owner = owner.into();
+    with_writer(|state, _| {
+        let index = state.free.pop().unwrap_or_else(|| {
+            let index = u32::try_from(state.generations.len()).expect("too many userdata entries");
+            state.generations.push(1);
+            index
+        });
+        let generation = state.generations[index as usize];
+
+        let value = Box::into_raw(Box::new(UserdataValue {
+            userdata,
+            owner,
+            generation,
+        }));
+        STORAGE
+            .slot_or_alloc(index)
+            .value
+            .store(value, Ordering::SeqCst);
+
+        UserdataKey { index, generation }
     })
 }
 
 pub(crate) fn remove_userdata(key: UserdataKey) -> Option<Userdata> {
-    let mut storage = STORAGE.write().unwrap();
-    storage.slotmap.remove(key).map(|v| v.userdata)
+    with_writer(|state, garbage| {
+        if !state.is_live(key) {
+            return None;
+        }
+        let slot = STORAGE.slot(key.index)?;
+        let value = slot.value.load(Ordering::SeqCst);
+        if value.is_null() {
+            return None;
+        }
+        let userdata = unsafe { (*value).userdata.clone() };
+        state.replace(key.index, std::ptr::null_mut(), garbage);
+        Some(userdata)
+    })
+}
+
+/// Calls `f` with a reference to the userdata associated with `key`.
+///
+/// This never blocks: it is safe to call from FMOD callbacks while another thread is inserting or removing userdata.
+/// Replacing or removing the userdata while `f` runs is allowed, the old value is kept alive until `f` returns.
+pub(crate) fn with_userdata<R>(key: UserdataKey, f: impl FnOnce(&Userdata) -> R) -> Option<R> {
+    let slot = STORAGE.slot(key.index)?;
+    slot.readers.fetch_add(1, Ordering::SeqCst);
+    let _guard = ReadGuard(slot);
+
+    let value = slot.value.load(Ordering::SeqCst);
+    if value.is_null() {
+        return None;
+    }
+    // writers will not free this value until our reader count is released
+    let value = unsafe { &*value };
+    if value.generation != key.generation {
+        return None;
+    }
+    Some(f(&value.userdata))
 }
 
 pub(crate) fn get_userdata(key: UserdataKey) -> Option<Userdata> {
-    let storage = STORAGE.read().unwrap();
-    storage.slotmap.get(key).map(|v| v.userdata.clone())
+    with_userdata(key, Arc::clone)
 }
 
 pub(crate) fn set_userdata(key: UserdataKey, userdata: Userdata) {
-    let mut storage = STORAGE.write().unwrap();
-    match storage.slotmap.get_mut(key) {
-        Some(v) => v.userdata = userdata,
-        None => eprintln!("Warning: userdata key does not exist!"),
-    }
+    with_writer(|state, garbage| {
+        let value = STORAGE
+            .slot(key.index)
+            .map_or(std::ptr::null_mut(), |slot| {
+                slot.value.load(Ordering::SeqCst)
+            });
+        if !state.is_live(key) || value.is_null() {
+            eprintln!("Warning: userdata key does not exist!");
+            return;
+        }
+
+        let owner = unsafe { (*value).owner };
+        let new = Box::into_raw(Box::new(UserdataValue {
+            userdata,
+            owner,
+            generation: key.generation,
+        }));
+        state.replace(key.index, new, garbage);
+    });
+}
+
+/// Checks whether the owners of up to `max_entries` userdata entries are still valid, and drops the userdata of those that are not.
+///
+/// Each call resumes where the previous one left off, so calling this with a small budget every frame eventually visits every entry
+/// without the cost of checking all of them at once.
+/// Owners are checked without holding any lock, so other threads can keep setting and getting userdata in the meantime.
+///
+/// Returns how many entries were removed.
+pub fn cleanup_userdata_incremental(max_entries: usize) -> usize {
+    let mut entries = with_writer(|state, _| {
+        let mut entries = std::mem::take(&mut state.cleanup_buffer);
+        state.collect_live(max_entries, &mut entries);
+        entries
+    });
+    // validity checks are FFI calls, so they are made outside the writer lock
+    entries.retain(|(key, owner)| !owner.is_valid(*key));
+
+    with_writer(|state, garbage| {
+        let removed = entries
+            .drain(..)
+            .filter(|&(key, owner)| state.remove_owned(key, owner, garbage))
+            .count();
+        // cleanups running at the same time each took a buffer, keep the biggest
+        if entries.capacity() > state.cleanup_buffer.capacity() {
+            state.cleanup_buffer = entries;
+        }
+        removed
+    })
+}
+
+/// Sets how many userdata entries `System::update` and `System::release` check for invalid owners per call.
+///
+/// `None` (the default) checks every entry.
+/// With a budget the check is spread across multiple calls, see [`cleanup_userdata_incremental`].
+pub fn set_userdata_cleanup_budget(max_entries: Option<usize>) {
+    CLEANUP_BUDGET.store(max_entries.unwrap_or(usize::MAX), Ordering::Relaxed);
 }
 
 pub(crate) fn cleanup_userdata() {
-    let mut storage = STORAGE.write().unwrap();
-    storage.slotmap.retain(|k, v| v.owner.is_valid(k));
+    cleanup_userdata_incremental(CLEANUP_BUDGET.load(Ordering::Relaxed));
+}
+
+// drops the userdata of an owner that is about to become invalid, used by the destroyed/end callbacks.
+// does nothing if `key` is not userdata that belongs to `owner`, e.g. when raw userdata was set instead.
+pub(crate) fn release_userdata(key: UserdataKey, owner: impl Into<HasUserdata>) {
+    let owner = owner.into();
+    with_writer(|state, garbage| {
+        state.remove_owned(key, owner, garbage);
+    });
 }
 
 pub(crate) fn clear_userdata() {
-    let mut storage = STORAGE.write().unwrap();
-    storage.slotmap.clear();
+    with_writer(|state, garbage| {
+        for index in 0..state.generations.len() as u32 {
+            state.replace(index, std::ptr::null_mut(), garbage);
+        }
+    });
 }
 
 impl From<UserdataKey> for *mut std::ffi::c_void {
     fn from(key: UserdataKey) -> Self {
-        key.data().as_ffi() as *mut std::ffi::c_void
+        ((u64::from(key.generation) << 32) | u64::from(key.index)) as *mut std::ffi::c_void
     }
 }
 
 impl From<*mut std::ffi::c_void> for UserdataKey {
     fn from(ptr: *mut std::ffi::c_void) -> Self {
-        UserdataKey::from(KeyData::from_ffi(ptr as u64))
+        let ptr = ptr as u64;
+        UserdataKey {
+            index: ptr as u32,
+            generation: (ptr >> 32) as u32,
+        }
     }
 }
 
@@ -400,4 +400,294 @@ FMOD_RESULT FMOD_ChannelControl_GetUserData(FMOD_CHANNELCONTROL *channelcontrol,
   ChannelControl *c = (ChannelControl *)channelcontrol;
   return c->getUserData(userdata);
 }
+
+// Batched command submission.
+static FMOD_RESULT applyCommand(const FMOD_CHANNELCONTROL_CMD *cmd) {
+  ChannelControl *c = (ChannelControl *)cmd->channelcontrol;
+  const FMOD_CHANNELCONTROL_CMD_DATA *data = &cmd->data;
+  switch (cmd->type) {
+  case FMOD_CHANNELCONTROL_CMD_STOP:
+    return c->stop();
+  case FMOD_CHANNELCONTROL_CMD_SETPAUSED:
+    return c->setPaused(data->boolean);
+  case FMOD_CHANNELCONTROL_CMD_SETVOLUME:
+    return c->setVolume(data->value);
+  case FMOD_CHANNELCONTROL_CMD_SETVOLUMERAMP:
+    return c->setVolumeRamp(data->boolean);
+  case FMOD_CHANNELCONTROL_CMD_SETPITCH:
+    return c->setPitch(data->value);
+  case FMOD_CHANNELCONTROL_CMD_SETMUTE:
+    return c->setMute(data->boolean);
+  case FMOD_CHANNELCONTROL_CMD_SETREVERBPROPERTIES:
+    return c->setReverbProperties(data->reverb.instance, data->reverb.wet);
+  case FMOD_CHANNELCONTROL_CMD_SETLOWPASSGAIN:
+    return c->setLowPassGain(data->value);
+  case FMOD_CHANNELCONTROL_CMD_SETMODE:
+    return c->setMode(data->mode);
+  case FMOD_CHANNELCONTROL_CMD_SETPAN:
+    return c->setPan(data->value);
+  case FMOD_CHANNELCONTROL_CMD_SETDELAY:
+    return c->setDelay(data->delay.dspclock_start, data->delay.dspclock_end,
+                       data->delay.stopchannels);
+  case FMOD_CHANNELCONTROL_CMD_ADDFADEPOINT:
+    return c->addFadePoint(data->fadepoint.dspclock, data->fadepoint.volume);
+  case FMOD_CHANNELCONTROL_CMD_SETFADEPOINTRAMP:
+    return c->setFadePointRamp(data->fadepoint.dspclock,
+                               data->fadepoint.volume);
+  case FMOD_CHANNELCONTROL_CMD_REMOVEFADEPOINTS:
+    return c->removeFadePoints(data->delay.dspclock_start,
+                               data->delay.dspclock_end);
+  case FMOD_CHANNELCONTROL_CMD_SET3DATTRIBUTES:
+    return c->set3DAttributes(
+        data->attributes.setpos ? &data->attributes.pos : nullptr,
+        data->attributes.setvel ? &data->attributes.vel : nullptr);
+  case FMOD_CHANNELCONTROL_CMD_SET3DMINMAXDISTANCE:
+    return c->set3DMinMaxDistance(data->values[0], data->values[1]);
+  case FMOD_CHANNELCONTROL_CMD_SET3DCONESETTINGS:
+    return c->set3DConeSettings(data->values[0], data->values[1],
+                                data->values[2]);
+  case FMOD_CHANNELCONTROL_CMD_SET3DOCCLUSION:
+    return c->set3DOcclusion(data->values[0], data->values[1]);
+  case FMOD_CHANNELCONTROL_CMD_SET3DSPREAD:
+    return c->set3DSpread(data->value);
+  case FMOD_CHANNELCONTROL_CMD_SET3DLEVEL:
+    return c->set3DLevel(data->value);
+  case FMOD_CHANNELCONTROL_CMD_SET3DDOPPLERLEVEL:
+    return c->set3DDopplerLevel(data->value);
+  case FMOD_CHANNELCONTROL_CMD_SCALEVOLUME: {
+    float volume;
+    FMOD_RESULT result = c->getVolume(&volume);
+    if (result != FMOD_OK) {
+      return result;
+    }
+    return c->setVolume(volume * data->value);
+  }
+  default:
+    return FMOD_ERR_INVALID_PARAM;
+  }
+}
+
+FMOD_RESULT
+FMOD_ChannelControl_ApplyBatch(const FMOD_CHANNELCONTROL_CMD *cmds, int count,
+                               FMOD_RESULT *results) {
+  if (count < 0 || (count > 0 && !cmds)) {
+    return FMOD_ERR_INVALID_PARAM;
+  }
+
+  FMOD_RESULT first_error = FMOD_OK;
+  for (int i = 0; i < count; i++) {
+    FMOD_RESULT result = applyCommand(&cmds[i]);
+    if (results) {
+      results[i] = result;
+    }
+    if (first_error == FMOD_OK) {
+      first_error = result;
+    }
+  }
+  return first_error;
+}
+
+// Bulk state queries.
+static void setBit(unsigned long long *bitset, int index, bool value) {
+  if (!bitset) {
+    return;
+  }
+  unsigned long long mask = 1ULL << (index % 64);
+  if (value) {
+    bitset[index / 64] |= mask;
+  } else {
+    bitset[index / 64] &= ~mask;
+  }
+}
+
+FMOD_RESULT
+FMOD_ChannelControl_SnapshotMany(FMOD_CHANNELCONTROL *const *channelcontrols,
+                                 int count,
+                                 const FMOD_CHANNELCONTROL_SNAPSHOT *snapshot) {
+  if (count < 0 || !snapshot || (count > 0 && !channelcontrols)) {
+    return FMOD_ERR_INVALID_PARAM;
+  }
+
+  FMOD_RESULT first_error = FMOD_OK;
+  for (int i = 0; i < count; i++) {
+    ChannelControl *c = (ChannelControl *)channelcontrols[i];
+
+    float volume = 0.0f, pitch = 0.0f, audibility = 0.0f;
+    unsigned long long dspclock = 0, parentclock = 0;
+    bool playing = false, paused = false, muted = false;
+
+    // stop at the first failing query, a stolen or stopped channel will fail
+    // every query anyway
+    FMOD_RESULT result = FMOD_OK;
+    if (result == FMOD_OK && snapshot->volume) {
+      result = c->getVolume(&volume);
+    }
+    if (result == FMOD_OK && snapshot->pitch) {
+      result = c->getPitch(&pitch);
+    }
+    if (result == FMOD_OK && snapshot->audibility) {
+      result = c->getAudibility(&audibility);
+    }
+    if (result == FMOD_OK && (snapshot->dspclock || snapshot->parentclock)) {
+      result = c->getDSPClock(&dspclock, &parentclock);
+    }
+    if (result == FMOD_OK && snapshot->playing) {
+      result = c->isPlaying(&playing);
+    }
+    if (result == FMOD_OK && snapshot->paused) {
+      result = c->getPaused(&paused);
+    }
+    if (result == FMOD_OK && snapshot->muted) {
+      result = c->getMute(&muted);
+    }
+
+    if (result != FMOD_OK) {
+      volume = pitch = audibility = 0.0f;
+      dspclock = parentclock = 0;
+      playing = paused = muted = false;
+      if (first_error == FMOD_OK) {
+        first_error = result;
+      }
+    }
+
+    if (snapshot->volume) {
+      snapshot->volume[i] = volume;
+    }
+    if (snapshot->pitch) {
+      snapshot->pitch[i] = pitch;
+    }
+    if (snapshot->audibility) {
+      snapshot->audibility[i] = audibility;
+    }
+    if (snapshot->dspclock) {
+      snapshot->dspclock[i] = dspclock;
+    }
+    if (snapshot->parentclock) {
+      snapshot->parentclock[i] = parentclock;
+    }
+    setBit(snapshot->playing, i, playing);
+    setBit(snapshot->paused, i, paused);
+    setBit(snapshot->muted, i, muted);
+    if (snapshot->results) {
+      snapshot->results[i] = result;
+    }
+  }
+  return first_error;
+}
+
+// Subtree operations.
+//
+// the wrapper does not link the c++ stdlib, so the walk recurses instead of
+// keeping its own stack. fmod hierarchies are only ever a few groups deep
+typedef struct SubtreeWalk {
+  FMOD_CHANNELGROUP_SUBTREE_FLAGS flags;
+  FMOD_CHANNELCONTROL_CMD cmd;
+  bool apply;
+  FMOD_CHANNELCONTROL **handles;
+  FMOD_CHANNELCONTROL_TYPE *types;
+  int capacity;
+  int count;
+  int failed;
+  FMOD_RESULT first_error;
+} SubtreeWalk;
+
+static void visitNode(SubtreeWalk *walk, ChannelControl *c,
+                      FMOD_CHANNELCONTROL_TYPE type) {
+  if (walk->count < walk->capacity) {
+    if (walk->handles) {
+      walk->handles[walk->count] = (FMOD_CHANNELCONTROL *)c;
+    }
+    if (walk->types) {
+      walk->types[walk->count] = type;
+    }
+  }
+  walk->count++;
+
+  if (walk->apply) {
+    walk->cmd.channelcontrol = (FMOD_CHANNELCONTROL *)c;
+    FMOD_RESULT result = applyCommand(&walk->cmd);
+    if (result != FMOD_OK) {
+      walk->failed++;
+      if (walk->first_error == FMOD_OK) {
+        walk->first_error = result;
+      }
+    }
+  }
+}
+
+static FMOD_RESULT walkGroup(SubtreeWalk *walk, ChannelGroup *group,
+                             bool root) {
+  FMOD_CHANNELGROUP_SUBTREE_FLAGS self_flag =
+      root ? FMOD_CHANNELGROUP_SUBTREE_ROOT : FMOD_CHANNELGROUP_SUBTREE_GROUPS;
+  if (walk->flags & self_flag) {
+    visitNode(walk, static_cast<ChannelControl *>(group),
+              FMOD_CHANNELCONTROL_CHANNELGROUP);
+  }
+
+  int num_groups;
+  FMOD_RESULT result = group->getNumGroups(&num_groups);
+  if (result != FMOD_OK) {
+    return result;
+  }
+  for (int i = 0; i < num_groups; i++) {
+    ChannelGroup *child;
+    result = group->getGroup(i, &child);
+    if (result != FMOD_OK) {
+      return result;
+    }
+    result = walkGroup(walk, child, false);
+    if (result != FMOD_OK) {
+      return result;
+    }
+  }
+
+  if (!(walk->flags & FMOD_CHANNELGROUP_SUBTREE_CHANNELS)) {
+    return FMOD_OK;
+  }
+  int num_channels;
+  result = group->getNumChannels(&num_channels);
+  if (result != FMOD_OK) {
+    return result;
+  }
+  // a stopped channel leaves the group, which only moves the channels after it
+  for (int i = num_channels - 1; i >= 0; i--) {
+    Channel *channel;
+    result = group->getChannel(i, &channel);
+    if (result != FMOD_OK) {
+      return result;
+    }
+    visitNode(walk, static_cast<ChannelControl *>(channel),
+              FMOD_CHANNELCONTROL_CHANNEL);
+  }
+  return FMOD_OK;
+}
+
+FMOD_RESULT FMOD_ChannelGroup_ApplySubtree(
+    FMOD_CHANNELGROUP *group, FMOD_CHANNELGROUP_SUBTREE_FLAGS flags,
+    const FMOD_CHANNELCONTROL_CMD *cmd, FMOD_CHANNELCONTROL **handles,
+    FMOD_CHANNELCONTROL_TYPE *types, int capacity, int *count, int *failed) {
+  if (!group || capacity < 0 || (capacity > 0 && !handles && !types)) {
+    return FMOD_ERR_INVALID_PARAM;
+  }
+
+  SubtreeWalk walk = {};
+  walk.flags = flags;
+  if (cmd) {
+    walk.cmd = *cmd;
+    walk.apply = true;
+  }
+  walk.handles = handles;
+  walk.types = types;
+  walk.capacity = capacity;
+  walk.first_error = FMOD_OK;
+
+  FMOD_RESULT result = walkGroup(&walk, (ChannelGroup *)group, true);
+  if (count) {
+    *count = walk.count;
+  }
+  if (failed) {
+    *failed = walk.failed;
+  }
+  return result != FMOD_OK ? result : walk.first_error;
+}
 }
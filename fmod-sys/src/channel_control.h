@@ -22,6 +22,109 @@ typedef _Bool bool;
 // header. the C++ api uses bool, and casting between FMOD_BOOL and bool is not
 // possible. so we just use bool.
 
+// Batched command submission.
+//
+// Each command targets a single ChannelControl and stores its arguments inline,
+// so an entire array of commands can be applied with one call.
+typedef enum FMOD_CHANNELCONTROL_CMD_TYPE {
+  FMOD_CHANNELCONTROL_CMD_STOP,
+  FMOD_CHANNELCONTROL_CMD_SETPAUSED,
+  FMOD_CHANNELCONTROL_CMD_SETVOLUME,
+  FMOD_CHANNELCONTROL_CMD_SETVOLUMERAMP,
+  FMOD_CHANNELCONTROL_CMD_SETPITCH,
+  FMOD_CHANNELCONTROL_CMD_SETMUTE,
+  FMOD_CHANNELCONTROL_CMD_SETREVERBPROPERTIES,
+  FMOD_CHANNELCONTROL_CMD_SETLOWPASSGAIN,
+  FMOD_CHANNELCONTROL_CMD_SETMODE,
+  FMOD_CHANNELCONTROL_CMD_SETPAN,
+  FMOD_CHANNELCONTROL_CMD_SETDELAY,
+  FMOD_CHANNELCONTROL_CMD_ADDFADEPOINT,
+  FMOD_CHANNELCONTROL_CMD_SETFADEPOINTRAMP,
+  FMOD_CHANNELCONTROL_CMD_REMOVEFADEPOINTS,
+  FMOD_CHANNELCONTROL_CMD_SET3DATTRIBUTES,
+  FMOD_CHANNELCONTROL_CMD_SET3DMINMAXDISTANCE,
+  FMOD_CHANNELCONTROL_CMD_SET3DCONESETTINGS,
+  FMOD_CHANNELCONTROL_CMD_SET3DOCCLUSION,
+  FMOD_CHANNELCONTROL_CMD_SET3DSPREAD,
+  FMOD_CHANNELCONTROL_CMD_SET3DLEVEL,
+  FMOD_CHANNELCONTROL_CMD_SET3DDOPPLERLEVEL,
+  // multiplies the current volume by data.value
+  FMOD_CHANNELCONTROL_CMD_SCALEVOLUME,
+
+  FMOD_CHANNELCONTROL_CMD_MAX,
+  FMOD_CHANNELCONTROL_CMD_FORCEINT = 65536
+} FMOD_CHANNELCONTROL_CMD_TYPE;
+
+typedef struct FMOD_CHANNELCONTROL_CMD_REVERB {
+  int instance;
+  float wet;
+} FMOD_CHANNELCONTROL_CMD_REVERB;
+
+typedef struct FMOD_CHANNELCONTROL_CMD_DELAY {
+  unsigned long long dspclock_start;
+  unsigned long long dspclock_end;
+  bool stopchannels;
+} FMOD_CHANNELCONTROL_CMD_DELAY;
+
+typedef struct FMOD_CHANNELCONTROL_CMD_FADEPOINT {
+  unsigned long long dspclock;
+  float volume;
+} FMOD_CHANNELCONTROL_CMD_FADEPOINT;
+
+typedef struct FMOD_CHANNELCONTROL_CMD_3DATTRIBUTES {
+  FMOD_VECTOR pos;
+  FMOD_VECTOR vel;
+  // Set3DAttributes accepts null for either vector, these flag which ones
+  // should be passed through
+  bool setpos;
+  bool setvel;
+} FMOD_CHANNELCONTROL_CMD_3DATTRIBUTES;
+
+typedef union FMOD_CHANNELCONTROL_CMD_DATA {
+  bool boolean;
+  float value;
+  float values[3];
+  FMOD_MODE mode;
+  FMOD_CHANNELCONTROL_CMD_REVERB reverb;
+  FMOD_CHANNELCONTROL_CMD_DELAY delay;
+  FMOD_CHANNELCONTROL_CMD_FADEPOINT fadepoint;
+  FMOD_CHANNELCONTROL_CMD_3DATTRIBUTES attributes;
+} FMOD_CHANNELCONTROL_CMD_DATA;
+
+typedef struct FMOD_CHANNELCONTROL_CMD {
+  FMOD_CHANNELCONTROL *channelcontrol;
+  FMOD_CHANNELCONTROL_CMD_TYPE type;
+  FMOD_CHANNELCONTROL_CMD_DATA data;
+} FMOD_CHANNELCONTROL_CMD;
+
+// Bulk state queries.
+//
+// Struct-of-arrays output buffers for FMOD_ChannelControl_SnapshotMany. Any
+// pointer may be null to skip that query. Value arrays must have room for
+// count entries, bitsets for (count + 63) / 64 words where bit (i % 64) of word
+// (i / 64) corresponds to channelcontrols[i].
+typedef struct FMOD_CHANNELCONTROL_SNAPSHOT {
+  float *volume;
+  float *pitch;
+  float *audibility;
+  unsigned long long *dspclock;
+  unsigned long long *parentclock;
+  unsigned long long *playing;
+  unsigned long long *paused;
+  unsigned long long *muted;
+  FMOD_RESULT *results;
+} FMOD_CHANNELCONTROL_SNAPSHOT;
+
+// Subtree operations.
+//
+// Flags selecting which nodes of a ChannelGroup hierarchy
+// FMOD_ChannelGroup_ApplySubtree visits.
+typedef unsigned int FMOD_CHANNELGROUP_SUBTREE_FLAGS;
+
+#define FMOD_CHANNELGROUP_SUBTREE_ROOT 0x00000001
+#define FMOD_CHANNELGROUP_SUBTREE_GROUPS 0x00000002
+#define FMOD_CHANNELGROUP_SUBTREE_CHANNELS 0x00000004
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -218,6 +321,51 @@ FMOD_RESULT FMOD_ChannelControl_SetUserData(FMOD_CHANNELCONTROL *channelcontrol,
 FMOD_RESULT FMOD_ChannelControl_GetUserData(FMOD_CHANNELCONTROL *channelcontrol,
                                             void **userdata);
 
+// Batched command submission.
+//
+// Applies every command in order, regardless of whether earlier commands
+// failed. If results is not null it must have room for count entries, and
+// receives the result of each command. Returns the first error encountered, or
+// FMOD_OK.
+FMOD_RESULT
+FMOD_ChannelControl_ApplyBatch(const FMOD_CHANNELCONTROL_CMD *cmds, int count,
+                               FMOD_RESULT *results);
+
+// Bulk state queries.
+//
+// Queries every requested value of each ChannelControl. If any query fails for
+// an entry, that entry's values are zeroed and the error is written to
+// results (if provided). Returns the first error encountered, or FMOD_OK.
+FMOD_RESULT
+FMOD_ChannelControl_SnapshotMany(FMOD_CHANNELCONTROL *const *channelcontrols,
+                                 int count,
+                                 const FMOD_CHANNELCONTROL_SNAPSHOT *snapshot);
+
+// Subtree operations.
+//
+// Walks group and every ChannelGroup below it depth first, visiting the nodes
+// selected by flags: group itself (ROOT), the groups below it (GROUPS) and the
+// Channels playing on any of them (CHANNELS). A group is visited before the
+// groups and Channels below it.
+//
+// If cmd is not null it is applied to every visited node, with
+// cmd->channelcontrol ignored. Like FMOD_ChannelControl_ApplyBatch every node
+// gets the command even if an earlier one failed. Channels are visited last to
+// first, so stopping them does not skip any. Channels stopped by stopping their
+// group are gone by the time the walk reaches them, and are not visited.
+//
+// If handles or types are not null they must have room for capacity entries,
+// and receive the first capacity nodes visited. count (if not null) receives
+// the number of nodes visited, which may be larger than capacity, and failed
+// (if not null) the number of nodes cmd failed on.
+//
+// Returns the first error from walking the hierarchy, otherwise the first
+// error from cmd, or FMOD_OK.
+FMOD_RESULT FMOD_ChannelGroup_ApplySubtree(
+    FMOD_CHANNELGROUP *group, FMOD_CHANNELGROUP_SUBTREE_FLAGS flags,
+    const FMOD_CHANNELCONTROL_CMD *cmd, FMOD_CHANNELCONTROL **handles,
+    FMOD_CHANNELCONTROL_TYPE *types, int capacity, int *count, int *failed);
+
 #ifdef __cplusplus
 }
 #endif
@@ -80,10 +80,18 @@ impl Utf8CStr {
     ///
     /// If the nul byte may not be at the end,
     /// [`Utf8CStr::from_utf8_until_nul`] can be used instead.
-    pub fn from_utf8_with_nul(slice: &[u8]) -> Result<&Self, FromUtf8WithNul> {
-        let cstr = CStr::from_bytes_with_nul(slice)?;
-        let _ = cstr.to_str()?;
-        Ok(unsafe { Self::from_cstr_unchecked(cstr) })
+    ///
+    /// This is a `const fn`, so byte strings can be checked at compile time.
+    pub const fn from_utf8_with_nul(slice: &[u8]) -> Result<&Self, FromUtf8WithNul> {
+        // ? isn't usable in const fns
+        let cstr = match CStr::from_bytes_with_nul(slice) {
+            Ok(cstr) => cstr,
+            Err(e) => return Err(FromUtf8WithNul::CStr(e)),
+        };
+        match Self::from_cstr(cstr) {
+            Ok(cstr) => Ok(cstr),
+            Err(e) => Err(FromUtf8WithNul::Utf8(e)),
+        }
     }
 
     /// Creates a C string wrapper from a byte slice with any number of nuls.
@@ -99,10 +107,15 @@ impl Utf8CStr {
     ///
     /// If the slice only has a single nul byte at the end, this method is
     /// equivalent to [`Utf8CStr::from_utf8_with_nul`].
-    pub fn from_utf8_until_nul(slice: &[u8]) -> Result<&Self, FromUtf8UntilNul> {
-        let cstr = CStr::from_bytes_until_nul(slice)?;
-        let _ = cstr.to_str()?;
-        Ok(unsafe { Self::from_cstr_unchecked(cstr) })
+    pub const fn from_utf8_until_nul(slice: &[u8]) -> Result<&Self, FromUtf8UntilNul> {
+        let cstr = match CStr::from_bytes_until_nul(slice) {
+            Ok(cstr) => cstr,
+            Err(e) => return Err(FromUtf8UntilNul::CStr(e)),
+        };
+        match Self::from_cstr(cstr) {
+            Ok(cstr) => Ok(cstr),
+            Err(e) => Err(FromUtf8UntilNul::Utf8(e)),
+        }
     }
 
     /// Creates a C string wrapper from a string slice with exactly one nul
@@ -114,9 +127,23 @@ impl Utf8CStr {
     ///
     /// If the nul byte may not be at the end,
     /// [`Utf8CStr::from_str_until_nul`] can be used instead.
-    pub fn from_str_with_nul(str: &str) -> Result<&Self, FromBytesWithNulError> {
-        let cstr = CStr::from_bytes_with_nul(str.as_bytes())?;
-        Ok(unsafe { Self::from_cstr_unchecked(cstr) })
+    ///
+    /// This is a `const fn`, so string constants can be checked at compile time:
+    ///
+    /// ```rust
+    /// use lanyard::Utf8CStr;
+    ///
+    /// const PATH: &Utf8CStr = match Utf8CStr::from_str_with_nul("event:/UI/Cancel\0") {
+    ///     Ok(path) => path,
+    ///     Err(_) => panic!("not a C string"),
+    /// };
+    /// assert_eq!(PATH, "event:/UI/Cancel");
+    /// ```
+    pub const fn from_str_with_nul(str: &str) -> Result<&Self, FromBytesWithNulError> {
+        match CStr::from_bytes_with_nul(str.as_bytes()) {
+            Ok(cstr) => Ok(unsafe { Self::from_cstr_unchecked(cstr) }),
+            Err(e) => Err(e),
+        }
     }
 
     /// Creates a C string wrapper from a string slice with any number of nuls.
@@ -131,9 +158,11 @@ impl Utf8CStr {
     ///
     /// If the slice only has a single nul byte at the end, this method is
     /// equivalent to [`Utf8CStr::from_str_with_nul`].
-    pub fn from_str_until_nul(str: &str) -> Result<&Self, FromBytesUntilNulError> {
-        let cstr = CStr::from_bytes_until_nul(str.as_bytes())?;
-        Ok(unsafe { Self::from_cstr_unchecked(cstr) })
+    pub const fn from_str_until_nul(str: &str) -> Result<&Self, FromBytesUntilNulError> {
+        match CStr::from_bytes_until_nul(str.as_bytes()) {
+            Ok(cstr) => Ok(unsafe { Self::from_cstr_unchecked(cstr) }),
+            Err(e) => Err(e),
+        }
     }
 
     /// Unsafely creates a UTF-8 C string wrapper from a byte slice.
@@ -219,9 +248,13 @@ impl Utf8CStr {
     /// If the contents of the `CStr` are valid UTF-8 data, this
     /// function will return the corresponding <code>&[`Utf8CStr`]</code> slice. Otherwise,
     /// it will return an error with details of where UTF-8 validation failed.
-    pub fn from_cstr(cstr: &CStr) -> Result<&Self, Utf8Error> {
-        let _ = cstr.to_str()?;
-        Ok(unsafe { Self::from_cstr_unchecked(cstr) })
+    ///
+    /// This is a `const fn`, so C string literals (`c"..."`) can be checked at compile time.
+    pub const fn from_cstr(cstr: &CStr) -> Result<&Self, Utf8Error> {
+        match core::str::from_utf8(cstr.to_bytes()) {
+            Ok(_) => Ok(unsafe { Self::from_cstr_unchecked(cstr) }),
+            Err(e) => Err(e),
+        }
     }
 
     /// Converts a borrowed C string into an owned C string.
@@ -21,10 +21,14 @@ extern crate alloc;
 mod cstr;
 #[cfg(feature = "alloc")]
 mod cstring;
+#[cfg(feature = "alloc")]
+mod small;
 
 pub use cstr::*;
 #[cfg(feature = "alloc")]
 pub use cstring::*;
+#[cfg(feature = "alloc")]
+pub use small::*;
 
 /// Create a const <code>&'static [`Utf8CStr`]</code> from a string literal.
 ///
@@ -42,22 +46,42 @@ pub use cstring::*;
 ///
 /// ```rust,compile_fail
 /// # use lanyard::{Utf8CStr, c};
-/// const ERROR: &CStr8 = c!("Hello\0, world!");
+/// const ERROR: &Utf8CStr = c!("Hello\0, world!");
 /// ```
 #[macro_export]
 macro_rules! c {
     ($s:literal) => {{
-        const __CSTR: &'static $crate::Utf8CStr = {
-            let nul_terminated = concat!($s, "\0").as_bytes();
-            let Ok(cstr) = core::ffi::CStr::from_bytes_with_nul(nul_terminated) else {
-                panic!("string contains nul byte")
+        const __CSTR: &'static $crate::Utf8CStr =
+            match $crate::Utf8CStr::from_str_with_nul(concat!($s, "\0")) {
+                Ok(cstr) => cstr,
+                Err(_) => panic!("string contains nul byte"),
             };
-            unsafe { $crate::Utf8CStr::from_cstr_unchecked(cstr) } // SAFETY: nul_terminated came from a rust string literal which is utf-8.
-        };
         __CSTR
     }};
 }
 
+/// Create a [`SmallUtf8CString`] from a format string, like `format!`.
+///
+/// Returns an [`InteriorNulError`] if the formatted string contains a nul byte.
+///
+/// # Example
+///
+/// ```rust
+/// use lanyard::c_format;
+///
+/// let bus = c_format!("bus:/Music/{}", 2).unwrap();
+/// assert_eq!(bus.as_str_with_nul(), "bus:/Music/2\0");
+///
+/// c_format!("{}", "nul\0").expect_err("string had interior nul");
+/// ```
+#[cfg(feature = "alloc")]
+#[macro_export]
+macro_rules! c_format {
+    ($($arg:tt)*) => {
+        $crate::SmallUtf8CString::from_fmt(format_args!($($arg)*))
+    };
+}
+
 macro_rules! cmp_impls {
     (impl $impl_for:ty {
       $(
@@ -100,7 +124,7 @@ pub(crate) use cmp_impls;
 
 #[cfg(test)]
 mod tests {
-    use crate::{Utf8CStr, Utf8CString};
+    use crate::{SmallUtf8CString, Utf8CStr, Utf8CString};
 
     const TEST_STR: &str = "Hello, world!";
     const INTERIOR_NUL: &str = "Hello\0, world!";
@@ -134,4 +158,52 @@ mod tests {
         let str = Utf8CString::new(TEST_STR).unwrap();
         assert_eq!(str, TEST_STR);
     }
+
+    #[test]
+    fn small_inline() {
+        let mut str = SmallUtf8CString::new();
+        str.push_str("Hello, ").unwrap();
+        str.push_str("world!").unwrap();
+        assert!(str.is_inline());
+        assert_eq!(str, TEST_STR);
+        assert_eq!(str.as_str_with_nul(), TRAILING_NUL);
+    }
+
+    #[test]
+    fn small_spills_to_heap() {
+        let long = "a".repeat(SmallUtf8CString::INLINE_CAPACITY);
+        let mut str: SmallUtf8CString = long.parse().unwrap();
+        assert!(str.is_inline());
+        str.push('b').unwrap();
+        assert!(!str.is_inline());
+        assert_eq!(str.len(), SmallUtf8CString::INLINE_CAPACITY + 1);
+        assert_eq!(str.as_bytes_with_nul().last(), Some(&0));
+
+        str.clear();
+        assert!(str.is_empty());
+        assert!(!str.is_inline());
+        assert_eq!(Utf8CString::from(str), "");
+    }
+
+    #[test]
+    fn small_interior() {
+        let mut str = SmallUtf8CString::try_from("Hello").unwrap();
+        let error = str
+            .push_str("\0, world!")
+            .expect_err("string had interior nul");
+        assert_eq!(error.nul_position(), 5);
+        assert_eq!(str, "Hello");
+    }
+
+    #[test]
+    fn small_size() {
+        assert!(core::mem::size_of::<SmallUtf8CString>() <= 32);
+    }
+
+    #[test]
+    fn small_format() {
+        let str = c_format!("{}, {}!", "Hello", "world").unwrap();
+        assert_eq!(str, TEST_STR);
+        c_format!("{INTERIOR_NUL}").expect_err("string had interior nul");
+    }
 }
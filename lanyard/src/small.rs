@@ -0,0 +1,360 @@
+// Copyright (c) 2024 Lily Lyons
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+use core::{
+    borrow::Borrow,
+    ffi::CStr,
+    fmt::Write,
+    hash::{Hash, Hasher},
+    ops::{Deref, Index},
+    slice::SliceIndex,
+};
+
+use crate::{cstr::Utf8CStr, cstring::Utf8CString};
+
+use alloc::{borrow::ToOwned, ffi::CString, string::String, vec::Vec};
+
+// bytes stored inline, including the nul terminator. with the length and the enum tag this keeps the type 32 bytes
+const INLINE_BYTES: usize = 30;
+
+#[derive(Clone)]
+enum Repr {
+    // bytes[len] is the nul terminator
+    Inline { len: u8, bytes: [u8; INLINE_BYTES] },
+    // always ends with the nul terminator
+    Heap(Vec<u8>),
+}
+
+/// An owned UTF-8 C string that stores short strings inline instead of allocating.
+///
+/// Strings of up to [`SmallUtf8CString::INLINE_CAPACITY`] bytes live on the stack, and longer strings move to the heap.
+/// This fits the paths and names that are built every frame, which are usually short:
+///
+/// ```rust
+/// use lanyard::{c_format, SmallUtf8CString};
+///
+/// let name = "shotgun";
+/// let path = c_format!("event:/Weapons/{name}").unwrap();
+/// assert_eq!(path, "event:/Weapons/shotgun");
+/// assert!(path.is_inline());
+/// ```
+///
+/// Once it has moved to the heap it stays there, so clearing and refilling it doesn't allocate again.
+///
+/// Like [`Utf8CString`], it dereferences to a [`Utf8CStr`] and can't contain interior nul bytes.
+/// Unlike [`Utf8CString`] it can be appended to, see [`SmallUtf8CString::push_str`] and [`core::fmt::Write`].
+#[derive(Clone)]
+pub struct SmallUtf8CString {
+    repr: Repr,
+}
+
+/// An error indicating that a string had a nul byte in it, which can't be part of a C string.
+///
+/// This error is created by [`SmallUtf8CString::push_str`] and the functions built on it.
+#[derive(Debug, PartialEq, Eq, Clone, Copy)]
+pub struct InteriorNulError {
+    position: usize,
+}
+
+impl InteriorNulError {
+    /// Returns the position of the nul byte in the string it would have been part of.
+    #[must_use]
+    pub fn nul_position(&self) -> usize {
+        self.position
+    }
+}
+
+impl SmallUtf8CString {
+    /// The longest string (in bytes, not counting the nul terminator) that is stored inline.
+    pub const INLINE_CAPACITY: usize = INLINE_BYTES - 1;
+
+    /// Creates an empty string. This does not allocate.
+    #[must_use]
+    pub const fn new() -> Self {
+        Self {
+            repr: Repr::Inline {
+                len: 0,
+                bytes: [0; INLINE_BYTES],
+            },
+        }
+    }
+
+    /// Creates a string from formatting arguments, without allocating if the result is short enough.
+    ///
+    /// [`c_format!`](crate::c_format) is the easier way to call this.
+    ///
+    /// # Panics
+    ///
+    /// Panics if a formatting trait implementation returns an error, like `format!` does.
+    pub fn from_fmt(args: core::fmt::Arguments<'_>) -> Result<Self, InteriorNulError> {
+        let mut string = Self::new();
+        if let Some(str) = args.as_str() {
+            string.push_str(str)?;
+            return Ok(string);
+        }
+
+        let mut writer = NulCapturingWriter {
+            string: &mut string,
+            error: None,
+        };
+        if core::fmt::write(&mut writer, args).is_err() {
+            return Err(writer
+                .error
+                .expect("a formatting trait implementation returned an error"));
+        }
+        Ok(string)
+    }
+
+    /// Appends `str` to the end of this string.
+    ///
+    /// If `str` contains a nul byte nothing is appended, and an error is returned.
+    pub fn push_str(&mut self, str: &str) -> Result<(), InteriorNulError> {
+        if let Some(index) = str.bytes().position(|b| b == 0) {
+            return Err(InteriorNulError {
+                position: self.len() + index,
+            });
+        }
+
+        match &mut self.repr {
+            Repr::Inline { len, bytes } => {
+                let start = *len as usize;
+                let end = start + str.len();
+                if end < INLINE_BYTES {
+                    bytes[start..end].copy_from_slice(str.as_bytes());
+                    bytes[end] = 0;
+                    #[allow(clippy::cast_possible_truncation)] // end < INLINE_BYTES
+                    let end_u8 = end as u8;
+                    *len = end_u8;
+                    return Ok(());
+                }
+                let mut heap = Vec::with_capacity((end + 1).next_power_of_two());
+                heap.extend_from_slice(&bytes[..start]);
+                heap.extend_from_slice(str.as_bytes());
+                heap.push(0);
+                self.repr = Repr::Heap(heap);
+            }
+            Repr::Heap(heap) => {
+                heap.pop();
+                heap.extend_from_slice(str.as_bytes());
+                heap.push(0);
+            }
+        }
+        Ok(())
+    }
+
+    /// Appends `char` to the end of this string.
+    ///
+    /// `'\0'` is not appended, and returns an error.
+    pub fn push(&mut self, char: char) -> Result<(), InteriorNulError> {
+        self.push_str(char.encode_utf8(&mut [0; 4]))
+    }
+
+    /// Truncates this string to be empty, keeping any heap allocation.
+    pub fn clear(&mut self) {
+        match &mut self.repr {
+            Repr::Inline { len, bytes } => {
+                *len = 0;
+                bytes[0] = 0;
+            }
+            Repr::Heap(heap) => {
+                heap.clear();
+                heap.push(0);
+            }
+        }
+    }
+
+    /// Returns `true` if the string is stored inline, and `false` if it has moved to the heap.
+    #[must_use]
+    pub fn is_inline(&self) -> bool {
+        matches!(self.repr, Repr::Inline { .. })
+    }
+
+    /// Converts a `SmallUtf8CString` into a <code>&[`Utf8CStr`]</code>.
+    #[must_use]
+    pub fn as_utf8_cstr(&self) -> &Utf8CStr {
+        let bytes = match &self.repr {
+            Repr::Inline { len, bytes } => &bytes[..=*len as usize],
+            Repr::Heap(heap) => heap.as_slice(),
+        };
+        // SAFETY: bytes only ever contains utf-8 strings without nul bytes, followed by the nul terminator.
+        unsafe { Utf8CStr::from_utf8_with_nul_unchecked(bytes) }
+    }
+
+    /// Converts this into a [`Utf8CString`], reusing the heap allocation if there is one.
+    #[must_use]
+    pub fn into_cstring(self) -> Utf8CString {
+        match self.repr {
+            // SAFETY: heap is utf-8, nul terminated and has no interior nul bytes.
+            Repr::Heap(heap) => unsafe { Utf8CString::from_utf8_with_nul_unchecked(heap) },
+            Repr::Inline { .. } => self.as_utf8_cstr().to_owned(),
+        }
+    }
+}
+
+// keeps the error from push_str, which fmt::Error can't carry
+struct NulCapturingWriter<'a> {
+    string: &'a mut SmallUtf8CString,
+    error: Option<InteriorNulError>,
+}
+
+impl Write for NulCapturingWriter<'_> {
+    fn write_str(&mut self, s: &str) -> core::fmt::Result {
+        self.string.push_str(s).map_err(|e| {
+            self.error = Some(e);
+            core::fmt::Error
+        })
+    }
+}
+
+impl Write for SmallUtf8CString {
+    fn write_str(&mut self, s: &str) -> core::fmt::Result {
+        self.push_str(s).map_err(|_| core::fmt::Error)
+    }
+}
+
+impl core::str::FromStr for SmallUtf8CString {
+    type Err = InteriorNulError;
+
+    fn from_str(s: &str) -> Result<Self, Self::Err> {
+        let mut string = Self::new();
+        string.push_str(s)?;
+        Ok(string)
+    }
+}
+
+impl TryFrom<&str> for SmallUtf8CString {
+    type Error = InteriorNulError;
+
+    fn try_from(value: &str) -> Result<Self, Self::Error> {
+        value.parse()
+    }
+}
+
+impl From<&Utf8CStr> for SmallUtf8CString {
+    fn from(value: &Utf8CStr) -> Self {
+        let mut string = Self::new();
+        // a Utf8CStr can't contain nul bytes, so this never fails
+        let _ = string.push_str(value.as_str());
+        string
+    }
+}
+
+impl From<SmallUtf8CString> for Utf8CString {
+    fn from(value: SmallUtf8CString) -> Self {
+        value.into_cstring()
+    }
+}
+
+impl Deref for SmallUtf8CString {
+    type Target = Utf8CStr;
+
+    fn deref(&self) -> &Self::Target {
+        self.as_utf8_cstr()
+    }
+}
+
+impl AsRef<Utf8CStr> for SmallUtf8CString {
+    fn as_ref(&self) -> &Utf8CStr {
+        self.as_utf8_cstr()
+    }
+}
+
+impl AsRef<str> for SmallUtf8CString {
+    fn as_ref(&self) -> &str {
+        self.as_str()
+    }
+}
+
+impl AsRef<CStr> for SmallUtf8CString {
+    fn as_ref(&self) -> &CStr {
+        self.as_c_str()
+    }
+}
+
+impl Borrow<Utf8CStr> for SmallUtf8CString {
+    fn borrow(&self) -> &Utf8CStr {
+        self.as_utf8_cstr()
+    }
+}
+
+// compared and hashed through Utf8CStr, so Borrow<Utf8CStr> holds up
+impl PartialEq for SmallUtf8CString {
+    fn eq(&self, other: &Self) -> bool {
+        self.as_utf8_cstr() == other.as_utf8_cstr()
+    }
+}
+
+impl Eq for SmallUtf8CString {}
+
+impl PartialOrd for SmallUtf8CString {
+    fn partial_cmp(&self, other: &Self) -> Option<core::cmp::Ordering> {
+        Some(self.cmp(other))
+    }
+}
+
+impl Ord for SmallUtf8CString {
+    fn cmp(&self, other: &Self) -> core::cmp::Ordering {
+        self.as_utf8_cstr().cmp(other.as_utf8_cstr())
+    }
+}
+
+impl Hash for SmallUtf8CString {
+    fn hash<H: Hasher>(&self, state: &mut H) {
+        self.as_utf8_cstr().hash(state);
+    }
+}
+
+super::cmp_impls! {
+  impl SmallUtf8CString {
+    Utf8CStr: Utf8CStr::as_str => Utf8CStr::as_str,
+    Utf8CString: Utf8CStr::as_str => Utf8CStr::as_str,
+    CStr: Utf8CStr::as_c_str => core::convert::identity,
+    str: Utf8CStr::as_str => core::convert::identity,
+    &str: Utf8CStr::as_str => Deref::deref,
+    CString: Utf8CStr::as_c_str => CString::as_c_str,
+    String: Utf8CStr::as_str => String::as_str
+  }
+}
+
+impl<I> Index<I> for SmallUtf8CString
+where
+    I: SliceIndex<str>,
+{
+    type Output = I::Output;
+
+    fn index(&self, index: I) -> &Self::Output {
+        self.as_str().index(index)
+    }
+}
+
+impl core::fmt::Debug for SmallUtf8CString {
+    fn fmt(&self, f: &mut core::fmt::Formatter<'_>) -> core::fmt::Result {
+        self.as_str_with_nul().fmt(f)
+    }
+}
+
+impl core::fmt::Display for SmallUtf8CString {
+    fn fmt(&self, f: &mut core::fmt::Formatter<'_>) -> core::fmt::Result {
+        self.as_str().fmt(f)
+    }
+}
+
+impl Default for SmallUtf8CString {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+impl core::fmt::Display for InteriorNulError {
+    fn fmt(&self, f: &mut core::fmt::Formatter<'_>) -> core::fmt::Result {
+        write!(
+            f,
+            "nul byte found in provided data at position: {}",
+            self.position
+        )
+    }
+}
+#[cfg(feature = "std")]
+impl std::error::Error for InteriorNulError {}